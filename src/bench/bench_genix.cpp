@@ -5,6 +5,7 @@
 #include "bench.h"
 
 #include "crypto/sha256.h"
+#include "hash.h"
 #include "key.h"
 #include "stacktraces.h"
 #include "validation.h"
@@ -21,6 +22,7 @@ int
 main(int argc, char** argv)
 {
     SHA256AutoDetect();
+    X16RAutoDetect();
 
     RegisterPrettySignalHandlers();
     RegisterPrettyTerminateHander();
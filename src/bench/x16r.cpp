@@ -0,0 +1,231 @@
+// Copyright (c) 2018-2021 The Genix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include "config/genix-config.h"
+#endif
+
+#include "bench.h"
+#include "arith_uint256.h"
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "hash.h"
+#include "llmq/quorums_chainlocks.h"
+#include "pow.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "scheduler.h"
+#include "streams.h"
+#include "uint256.h"
+#include "utiltime.h"
+#include "validation.h"
+#include "validationinterface.h"
+#include "versionbits.h"
+
+#include <cassert>
+#include <cstring>
+
+#include <boost/thread.hpp>
+
+/* Runs a single X16R algorithm over LEN byte inputs, chaining the output into the next input */
+template <int ALGO, size_t LEN>
+static void X16RStageBench(benchmark::State& state)
+{
+    std::vector<unsigned char> in(LEN, 0);
+    uint512 hash;
+    while (state.KeepRunning()) {
+        HashX16RStage(ALGO, in.data(), in.size(), hash);
+        memcpy(in.data(), hash.begin(), std::min(in.size(), sizeof(hash)));
+    }
+}
+
+#define X16R_STAGE_BENCHMARK(name, algo) \
+    static void X16R_##name##_0064b(benchmark::State& state) { X16RStageBench<algo, 64>(state); } \
+    static void X16R_##name##_0080b(benchmark::State& state) { X16RStageBench<algo, 80>(state); } \
+    BENCHMARK(X16R_##name##_0064b); \
+    BENCHMARK(X16R_##name##_0080b);
+
+X16R_STAGE_BENCHMARK(blake, 0);
+X16R_STAGE_BENCHMARK(bmw, 1);
+X16R_STAGE_BENCHMARK(groestl, 2);
+X16R_STAGE_BENCHMARK(jh, 3);
+X16R_STAGE_BENCHMARK(keccak, 4);
+X16R_STAGE_BENCHMARK(skein, 5);
+X16R_STAGE_BENCHMARK(luffa, 6);
+X16R_STAGE_BENCHMARK(cubehash, 7);
+X16R_STAGE_BENCHMARK(shavite, 8);
+X16R_STAGE_BENCHMARK(simd, 9);
+X16R_STAGE_BENCHMARK(echo, 10);
+X16R_STAGE_BENCHMARK(hamsi, 11);
+X16R_STAGE_BENCHMARK(fugue, 12);
+X16R_STAGE_BENCHMARK(shabal, 13);
+X16R_STAGE_BENCHMARK(whirlpool, 14);
+X16R_STAGE_BENCHMARK(sha512, 15);
+
+/* Full X16R of 80 byte headers, with a different random algorithm order on every call */
+static void X16R_0080b_RandomOrder(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    std::vector<uint256> vPrevBlockHashes(1024);
+    for (auto& hash : vPrevBlockHashes) {
+        hash = rng.rand256();
+    }
+    std::vector<unsigned char> header(80, 0);
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        uint256 hash = HashX16R(header.begin(), header.end(), vPrevBlockHashes[i++ % vPrevBlockHashes.size()]);
+        memcpy(header.data(), hash.begin(), 32);
+    }
+}
+
+/*
+ * Deserialize a full headers message of 2000 regtest headers, hash them through
+ * CacheBlockHeaderHashes and check their PoW. This covers only the hashing part of
+ * ProcessNewBlockHeaders, see X16R_ProcessHeaders for the whole of it.
+ */
+static void X16R_HeadersHashAndPoW(benchmark::State& state)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::REGTEST);
+    const Consensus::Params& params = chainParams->GetConsensus();
+
+    std::vector<CBlockHeader> vHeaders(2000);
+    uint256 hashPrev = chainParams->GenesisBlock().GetHash();
+    for (size_t i = 0; i < vHeaders.size(); i++) {
+        CBlockHeader& header = vHeaders[i];
+        header.nVersion = 4;
+        header.hashPrevBlock = hashPrev;
+        header.hashMerkleRoot = ArithToUint256(arith_uint256(i));
+        header.nTime = chainParams->GenesisBlock().nTime + i * 150;
+        header.nBits = chainParams->GenesisBlock().nBits;
+        while (!CheckProofOfWork(header.GetHash(), header.nBits, params)) {
+            header.nNonce++;
+        }
+        hashPrev = header.GetHash();
+    }
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << vHeaders;
+    char a = '\0';
+    stream.write(&a, 1); // Prevent compaction
+    size_t nSize = stream.size() - 1;
+
+    while (state.KeepRunning()) {
+        std::vector<CBlockHeader> headers;
+        stream >> headers;
+        assert(stream.Rewind(nSize));
+
+        CacheBlockHeaderHashes(headers);
+        for (const CBlockHeader& header : headers) {
+            assert(CheckProofOfWork(header.GetHash(), header.nBits, params));
+        }
+    }
+}
+
+/*
+ * Feed a full headers message of 2000 regtest headers, starting with the genesis, through
+ * ProcessNewBlockHeaders with nWorkers threads helping with the PoW checks. This covers the
+ * deserialization, the header check queue and adding the headers to the block index, which
+ * is unloaded again after every run.
+ */
+static void ProcessHeadersBench(benchmark::State& state, int nWorkers)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    const CChainParams& chainparams = Params();
+    const Consensus::Params& params = chainparams.GetConsensus();
+
+    std::vector<CBlockHeader> vHeaders(2000);
+    vHeaders[0] = chainparams.GenesisBlock().GetBlockHeader();
+    for (size_t i = 1; i < vHeaders.size(); i++) {
+        CBlockHeader& header = vHeaders[i];
+        header.nVersion = VERSIONBITS_TOP_BITS;
+        header.hashPrevBlock = vHeaders[i - 1].GetHash();
+        header.hashMerkleRoot = ArithToUint256(arith_uint256(i));
+        // more than 2 hours apart, so regtest allows the minimum difficulty for all of them
+        header.nTime = vHeaders[i - 1].nTime + 2 * 60 * 60 + 1;
+        header.nBits = UintToArith256(params.powLimit).GetCompact();
+        while (!CheckProofOfWork(header.GetHash(), header.nBits, params)) {
+            header.nNonce++;
+        }
+    }
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << vHeaders;
+    char a = '\0';
+    stream.write(&a, 1); // Prevent compaction
+    size_t nSize = stream.size() - 1;
+    SetMockTime(vHeaders.back().nTime);
+
+    CScheduler scheduler;
+    GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+    llmq::chainLocksHandler = new llmq::CChainLocksHandler(nullptr);
+    boost::thread_group threadGroup;
+    for (int i = 0; i < nWorkers; i++) {
+        threadGroup.create_thread(&ThreadScriptCheck);
+    }
+    nScriptCheckThreads = nWorkers ? nWorkers + 1 : 0;
+
+    while (state.KeepRunning()) {
+        std::vector<CBlockHeader> headers;
+        stream >> headers;
+        assert(stream.Rewind(nSize));
+
+        CValidationState validationState;
+        bool fAccepted = ProcessNewBlockHeaders(headers, validationState, chainparams);
+        assert(fAccepted);
+        UnloadBlockIndex();
+    }
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+    nScriptCheckThreads = 0;
+    delete llmq::chainLocksHandler;
+    llmq::chainLocksHandler = nullptr;
+    GetMainSignals().UnregisterBackgroundSignalScheduler();
+    SetMockTime(0);
+}
+
+static void X16R_ProcessHeaders(benchmark::State& state)
+{
+    ProcessHeadersBench(state, 0);
+}
+
+static void X16R_ProcessHeadersParallel(benchmark::State& state)
+{
+    ProcessHeadersBench(state, std::max(2, GetNumCores()) - 1);
+}
+
+#if ENABLE_X16R_STATS
+/*
+ * The same as X16R_0080b_RandomOrder, to compare against for the cost of collecting the
+ * statistics, which are checked to cover every hash
+ */
+static void X16R_PowStats(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    std::vector<uint256> vPrevBlockHashes(1024);
+    for (auto& hash : vPrevBlockHashes) {
+        hash = rng.rand256();
+    }
+    std::vector<unsigned char> header(80, 0);
+
+    ResetX16RStats();
+    uint64_t nHashes = 0;
+    while (state.KeepRunning()) {
+        uint256 hash = HashX16R(header.begin(), header.end(), vPrevBlockHashes[nHashes++ % vPrevBlockHashes.size()]);
+        memcpy(header.data(), hash.begin(), 32);
+    }
+
+    uint64_t nHits = 0;
+    for (const auto& s : GetX16RStats()) {
+        nHits += s.nHits;
+    }
+    assert(nHits == nHashes * 16);
+}
+#endif // ENABLE_X16R_STATS
+
+BENCHMARK(X16R_0080b_RandomOrder);
+BENCHMARK(X16R_HeadersHashAndPoW);
+BENCHMARK(X16R_ProcessHeaders);
+BENCHMARK(X16R_ProcessHeadersParallel);
+#if ENABLE_X16R_STATS
+BENCHMARK(X16R_PowStats);
+#endif // ENABLE_X16R_STATS
@@ -9,12 +9,133 @@
 #include "tinyformat.h"
 
 #ifndef BUILD_BITCOIN_INTERNAL
+#include "crypto/sha256.h"
+#include "cuckoocache.h"
+#include "script/sigcache.h"
 #include "support/allocators/mt_pooled_secure.h"
+
+#include <atomic>
+#include <boost/thread.hpp>
 #endif
 
 #include <assert.h>
 #include <string.h>
 
+enum BLSSigCacheType : uint8_t {
+    BLS_SIG_CACHE_INSECURE = 0,
+    BLS_SIG_CACHE_SECURE_AGGREGATED = 1,
+};
+
+#ifndef BUILD_BITCOIN_INTERNAL
+namespace {
+/**
+ * Valid BLS signature cache, analogous to the script signature cache. Pairings are far more expensive than
+ * ECDSA verification and the same sigs (ProTx payloads, final commitments, recovered sigs of chainlocks and
+ * islocks, ...) are usually verified more than once, e.g. when relayed and again when mined.
+ */
+class CBLSSigCache
+{
+private:
+    //! Entries are SHA256(nonce || type || signature || public keys || message hash)
+    uint256 nonce;
+    CuckooCache::cache<uint256, SignatureCacheHasher> setValid;
+    boost::shared_mutex cs;
+    std::atomic<bool> fEnabled{false};
+    std::atomic<uint64_t> nHits{0};
+
+public:
+    CBLSSigCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+    }
+
+    bool IsEnabled() const
+    {
+        return fEnabled;
+    }
+
+    uint256 ComputeEntry(BLSSigCacheType type, const CBLSSignature& sig, const CBLSPublicKey* pks, size_t nPks, const uint256& hash) const
+    {
+        uint8_t t = type;
+        CSHA256 hasher;
+        hasher.Write(nonce.begin(), 32).Write(&t, 1).Write(sig.GetHash().begin(), 32);
+        for (size_t i = 0; i < nPks; i++) {
+            hasher.Write(pks[i].GetHash().begin(), 32);
+        }
+        uint256 entry;
+        hasher.Write(hash.begin(), 32).Finalize(entry.begin());
+        return entry;
+    }
+
+    bool Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs);
+        if (!setValid.contains(entry, false)) {
+            return false;
+        }
+        nHits++;
+        return true;
+    }
+
+    uint64_t GetHits() const
+    {
+        return nHits;
+    }
+
+    void Set(uint256 entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs);
+        setValid.insert(entry);
+    }
+
+    size_t Setup(size_t nBytes)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs);
+        size_t nElems = setValid.setup_bytes(nBytes);
+        fEnabled = true;
+        return nElems;
+    }
+};
+
+static CBLSSigCache blsSigCache;
+} // namespace
+
+size_t InitBLSSigCache(size_t nBytes)
+{
+    return blsSigCache.Setup(nBytes);
+}
+
+uint64_t GetBLSSigCacheHits()
+{
+    return blsSigCache.GetHits();
+}
+
+static bool GetBLSSigCacheEntry(BLSSigCacheType type, const CBLSSignature& sig, const CBLSPublicKey* pks, size_t nPks, const uint256& hash, uint256& entryRet)
+{
+    if (!blsSigCache.IsEnabled()) {
+        return false;
+    }
+    entryRet = blsSigCache.ComputeEntry(type, sig, pks, nPks, hash);
+    return blsSigCache.Get(entryRet);
+}
+
+static void AddBLSSigCacheEntry(const uint256& entry)
+{
+    if (!entry.IsNull()) {
+        blsSigCache.Set(entry);
+    }
+}
+#else
+static bool GetBLSSigCacheEntry(BLSSigCacheType type, const CBLSSignature& sig, const CBLSPublicKey* pks, size_t nPks, const uint256& hash, uint256& entryRet)
+{
+    return false;
+}
+
+static void AddBLSSigCacheEntry(const uint256& entry)
+{
+}
+#endif
+
 bool CBLSId::InternalSetBuf(const void* buf)
 {
     memcpy(impl.begin(), buf, sizeof(uint256));
@@ -338,11 +459,20 @@ bool CBLSSignature::VerifyInsecure(const CBLSPublicKey& pubKey, const uint256& h
         return false;
     }
 
+    uint256 cacheEntry;
+    if (GetBLSSigCacheEntry(BLS_SIG_CACHE_INSECURE, *this, &pubKey, 1, hash, cacheEntry)) {
+        return true;
+    }
+
     try {
-        return impl.Verify({(const uint8_t*)hash.begin()}, {pubKey.impl});
+        if (!impl.Verify({(const uint8_t*)hash.begin()}, {pubKey.impl})) {
+            return false;
+        }
     } catch (...) {
         return false;
     }
+    AddBLSSigCacheEntry(cacheEntry);
+    return true;
 }
 
 bool CBLSSignature::VerifyInsecureAggregated(const std::vector<CBLSPublicKey>& pubKeys, const std::vector<uint256>& hashes) const
@@ -365,6 +495,8 @@ bool CBLSSignature::VerifyInsecureAggregated(const std::vector<CBLSPublicKey>& p
         hashes2.push_back((uint8_t*)hashes[i].begin());
     }
 
+    // not cached, these are batches of otherwise unrelated sigs which are never verified twice in the same
+    // composition and would only evict useful entries
     try {
         return impl.Verify(hashes2, pubKeyVec);
     } catch (...) {
@@ -378,6 +510,11 @@ bool CBLSSignature::VerifySecureAggregated(const std::vector<CBLSPublicKey>& pks
         return false;
     }
 
+    uint256 cacheEntry;
+    if (GetBLSSigCacheEntry(BLS_SIG_CACHE_SECURE_AGGREGATED, *this, pks.data(), pks.size(), hash, cacheEntry)) {
+        return true;
+    }
+
     std::vector<bls::AggregationInfo> v;
     v.reserve(pks.size());
     for (auto& pk : pks) {
@@ -387,7 +524,11 @@ bool CBLSSignature::VerifySecureAggregated(const std::vector<CBLSPublicKey>& pks
 
     bls::AggregationInfo aggInfo = bls::AggregationInfo::MergeInfos(v);
     bls::Signature aggSig = bls::Signature::FromInsecureSig(impl, aggInfo);
-    return aggSig.Verify();
+    if (!aggSig.Verify()) {
+        return false;
+    }
+    AddBLSSigCacheEntry(cacheEntry);
+    return true;
 }
 
 bool CBLSSignature::Recover(const std::vector<CBLSSignature>& sigs, const std::vector<CBLSId>& ids)
@@ -475,4 +475,18 @@ typedef std::shared_ptr<BLSSignatureVector> BLSSignatureVectorPtr;
 
 bool BLSInit();
 
+#ifndef BUILD_BITCOIN_INTERNAL
+/** Default for -blssigcachesize, in MiB */
+static const unsigned int DEFAULT_BLS_SIG_CACHE_SIZE = 8;
+
+/**
+ * Sets up the cache of valid BLS signatures to use up to nBytes and returns the number of entries it can hold.
+ * Nothing is cached before this is called.
+ */
+size_t InitBLSSigCache(size_t nBytes);
+
+/** Number of verifications which were answered by the cache instead of a pairing, for tests and stats */
+uint64_t GetBLSSigCacheHits();
+#endif
+
 #endif // genix_CRYPTO_BLS_H
@@ -7,6 +7,9 @@
 
 #include "bls.h"
 
+#include "ctpl.h"
+
+#include <future>
 #include <map>
 #include <vector>
 
@@ -92,29 +95,60 @@ public:
                 badSources.emplace(p.first);
 
                 if (perMessageFallback) {
-                    // revert to per-message verification
-                    if (p.second.size() == 1) {
-                        // no need to re-verify a single message
-                        badMessages.emplace(p.second[0]->second.msgId);
-                    } else {
-                        for (const auto& msgIt : p.second) {
-                            if (badMessages.count(msgIt->first)) {
-                                // same message might be invalid from different source, so no need to re-verify it
-                                continue;
-                            }
-
-                            const auto& msg = msgIt->second;
-                            if (!msg.sig.VerifyInsecure(msg.pubKey, msg.msgHash)) {
-                                badMessages.emplace(msg.msgId);
-                            }
+                    // same message might be invalid from different source, so no need to re-verify it
+                    std::vector<MessageMapIterator> msgIts;
+                    msgIts.reserve(p.second.size());
+                    for (const auto& msgIt : p.second) {
+                        if (!badMessages.count(msgIt->first)) {
+                            msgIts.emplace_back(msgIt);
                         }
                     }
+                    if (msgIts.empty()) {
+                        continue;
+                    }
+                    // the failed batch might have only failed due to the already known bad messages
+                    if (msgIts.size() != p.second.size() && VerifyRange(msgIts, 0, msgIts.size())) {
+                        continue;
+                    }
+                    FindBadMessages(msgIts, 0, msgIts.size());
                 }
             }
         }
     }
 
 private:
+    // Bisects a range of messages which is known to contain at least one invalid message. This needs much less
+    // pairings than verifying each message on its own when only a few of the messages are invalid
+    void FindBadMessages(const std::vector<MessageMapIterator>& msgIts, size_t begin, size_t end)
+    {
+        if (end - begin == 1) {
+            badMessages.emplace(msgIts[begin]->second.msgId);
+            return;
+        }
+
+        size_t mid = begin + (end - begin) / 2;
+        if (!VerifyRange(msgIts, begin, mid)) {
+            FindBadMessages(msgIts, begin, mid);
+        }
+        if (!VerifyRange(msgIts, mid, end)) {
+            FindBadMessages(msgIts, mid, end);
+        }
+    }
+
+    bool VerifyRange(const std::vector<MessageMapIterator>& msgIts, size_t begin, size_t end)
+    {
+        if (end - begin == 1) {
+            const auto& msg = msgIts[begin]->second;
+            return msg.sig.VerifyInsecure(msg.pubKey, msg.msgHash);
+        }
+
+        std::map<uint256, std::vector<MessageMapIterator>> byMessageHash;
+        for (size_t i = begin; i < end; i++) {
+            byMessageHash[msgIts[i]->second.msgHash].emplace_back(msgIts[i]);
+        }
+        return VerifyBatch(byMessageHash);
+    }
+
     // All Verify methods take ownership of the passed byMessageHash map and thus might modify the map. This is to avoid
     // unnecessary copies
 
@@ -232,4 +266,73 @@ private:
     }
 };
 
+// Keeps one CBLSBatchVerifier per partition (e.g. per quorum) and verifies the partitions in parallel on the passed
+// thread pool. Results of all partitions are merged into badSources/badMessages afterwards, in partition order
+template<typename PartitionId, typename SourceId, typename MessageId>
+class CBLSPartitionedBatchVerifier
+{
+private:
+    typedef CBLSBatchVerifier<SourceId, MessageId> BatchVerifier;
+
+    bool secureVerification;
+    bool perMessageFallback;
+
+    std::map<PartitionId, BatchVerifier> partitions;
+
+public:
+    std::set<SourceId> badSources;
+    std::set<MessageId> badMessages;
+
+public:
+    CBLSPartitionedBatchVerifier(bool _secureVerification, bool _perMessageFallback) :
+            secureVerification(_secureVerification),
+            perMessageFallback(_perMessageFallback)
+    {
+    }
+
+    void PushMessage(const PartitionId& partitionId, const SourceId& sourceId, const MessageId& msgId, const uint256& msgHash, const CBLSSignature& sig, const CBLSPublicKey& pubKey)
+    {
+        auto it = partitions.find(partitionId);
+        if (it == partitions.end()) {
+            it = partitions.emplace(std::piecewise_construct,
+                    std::forward_as_tuple(partitionId),
+                    std::forward_as_tuple(secureVerification, perMessageFallback)).first;
+        }
+        it->second.PushMessage(sourceId, msgId, msgHash, sig, pubKey);
+    }
+
+    size_t GetPartitionCount() const
+    {
+        return partitions.size();
+    }
+
+    // pool might be nullptr or have no threads, in which case all partitions are verified on the calling thread
+    void Verify(ctpl::thread_pool* pool)
+    {
+        std::vector<std::future<void>> futures;
+        if (pool && pool->size() > 0 && partitions.size() > 1) {
+            // the first partition is verified by the calling thread while the others are verified by the pool
+            for (auto it = std::next(partitions.begin()); it != partitions.end(); ++it) {
+                auto& verifier = it->second;
+                futures.emplace_back(pool->push([&verifier](int threadId) {
+                    verifier.Verify();
+                }));
+            }
+            partitions.begin()->second.Verify();
+        } else {
+            for (auto& p : partitions) {
+                p.second.Verify();
+            }
+        }
+        for (auto& f : futures) {
+            f.get();
+        }
+
+        for (auto& p : partitions) {
+            badSources.insert(p.second.badSources.begin(), p.second.badSources.end());
+            badMessages.insert(p.second.badMessages.begin(), p.second.badMessages.end());
+        }
+    }
+};
+
 #endif //genix_CRYPTO_BLS_BATCHVERIFIER_H
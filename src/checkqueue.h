@@ -16,6 +16,82 @@
 template <typename T>
 class CCheckQueueControl;
 
+/** Interface through which CCheckQueueWorkers serve the queues registered with them */
+class CCheckQueueBase
+{
+public:
+    virtual ~CCheckQueueBase() {}
+
+    //! Whether there are verifications queued which no thread has taken yet
+    virtual bool HasQueued() = 0;
+
+    //! Help with the queued verifications, returns as soon as there are none left to take
+    virtual void Help() = 0;
+};
+
+/**
+ * Worker threads shared by several CCheckQueues, e.g. so that the script, header
+ * and special tx checks don't each need their own set of threads. A worker blocks
+ * until any of the queues has verifications queued and helps with them like a
+ * dedicated worker of that queue would, until none are left to take.
+ */
+class CCheckQueueWorkers
+{
+private:
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    std::vector<CCheckQueueBase*> queues;
+
+    CCheckQueueBase* FindQueued()
+    {
+        for (CCheckQueueBase* queue : queues) {
+            if (queue->HasQueued()) {
+                return queue;
+            }
+        }
+        return nullptr;
+    }
+
+public:
+    void Register(CCheckQueueBase* queue)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        queues.push_back(queue);
+    }
+
+    void Unregister(CCheckQueueBase* queue)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        queues.erase(std::remove(queues.begin(), queues.end(), queue), queues.end());
+    }
+
+    //! Called by the queues after verifications were added. Queues must not hold their own mutex here.
+    void Notify(bool fAll)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (fAll) {
+            cond.notify_all();
+        } else {
+            cond.notify_one();
+        }
+    }
+
+    //! Worker thread
+    void Thread()
+    {
+        while (true) {
+            CCheckQueueBase* queue;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while ((queue = FindQueued()) == nullptr) {
+                    cond.wait(lock);
+                }
+            }
+            queue->Help();
+        }
+    }
+};
+
 /** 
  * Queue for verifications that have to be performed.
   * The verifications are represented by a type T, which must provide an
@@ -24,12 +100,17 @@ class CCheckQueueControl;
   * One thread (the master) is assumed to push batches of verifications
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
-  * as an N'th worker, until all jobs are done.
+  * as an N'th worker, until all jobs are done. The worker threads are
+  * either dedicated to the queue or shared with other queues through
+  * CCheckQueueWorkers.
   */
 template <typename T>
-class CCheckQueue
+class CCheckQueue : public CCheckQueueBase
 {
 private:
+    //! The shared workers serving this queue, if any
+    CCheckQueueWorkers* const pworkers;
+
     //! Mutex to protect the inner state
     boost::mutex mutex;
 
@@ -65,8 +146,11 @@ private:
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
-    /** Internal function that does bulk of the verification work. */
-    bool Loop(bool fMaster = false)
+    /**
+     * Internal function that does bulk of the verification work. A helper (a shared
+     * worker) returns instead of waiting once there is nothing left to take.
+     */
+    bool Loop(bool fMaster = false, bool fHelper = false)
     {
         boost::condition_variable& cond = fMaster ? condMaster : condWorker;
         std::vector<T> vChecks;
@@ -89,6 +173,10 @@ private:
                 }
                 // logically, the do loop starts here
                 while (queue.empty()) {
+                    if (fHelper) {
+                        nTotal--;
+                        return true;
+                    }
                     if ((fMaster || fQuit) && nTodo == 0) {
                         nTotal--;
                         bool fRet = fAllOk;
@@ -130,8 +218,14 @@ public:
     //! Mutex to ensure only one concurrent CCheckQueueControl
     boost::mutex ControlMutex;
 
-    //! Create a new check queue
-    CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn) {}
+    //! Create a new check queue, optionally served by shared workers instead of Thread()
+    explicit CCheckQueue(unsigned int nBatchSizeIn, CCheckQueueWorkers* pworkersIn = nullptr) :
+        pworkers(pworkersIn), nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn)
+    {
+        if (pworkers) {
+            pworkers->Register(this);
+        }
+    }
 
     //! Worker thread
     void Thread()
@@ -139,6 +233,17 @@ public:
         Loop();
     }
 
+    bool HasQueued() override
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        return !queue.empty();
+    }
+
+    void Help() override
+    {
+        Loop(false, true);
+    }
+
     //! Wait until execution finishes, and return whether all evaluations were successful.
     bool Wait()
     {
@@ -148,20 +253,28 @@ public:
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        for (T& check : vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            for (T& check : vChecks) {
+                queue.push_back(T());
+                check.swap(queue.back());
+            }
+            nTodo += vChecks.size();
+            if (vChecks.size() == 1)
+                condWorker.notify_one();
+            else if (vChecks.size() > 1)
+                condWorker.notify_all();
+        }
+        if (pworkers && !vChecks.empty()) {
+            pworkers->Notify(vChecks.size() > 1);
         }
-        nTodo += vChecks.size();
-        if (vChecks.size() == 1)
-            condWorker.notify_one();
-        else if (vChecks.size() > 1)
-            condWorker.notify_all();
     }
 
     ~CCheckQueue()
     {
+        if (pworkers) {
+            pworkers->Unregister(this);
+        }
     }
 
 };
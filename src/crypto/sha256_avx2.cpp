@@ -67,9 +67,9 @@ void inline Write8(unsigned char* out, int offset, __m256i v) {
     WriteLE32(out + 224 + offset, _mm256_extract_epi32(v, 0));
 }
 
-}
-
-void Transform_8way(unsigned char* out, const unsigned char* in)
+/** The first two transforms give the single SHA256, the third one hashes that again. */
+template<bool fDouble>
+void inline TransformMultiway(unsigned char* out, const unsigned char* in)
 {
     // Transform 1
     __m256i a = K(0x6a09e667ul);
@@ -234,6 +234,18 @@ void Transform_8way(unsigned char* out, const unsigned char* in)
     w6 = Add(t6, g);
     w7 = Add(t7, h);
 
+    if (!fDouble) {
+        Write8(out, 0, w0);
+        Write8(out, 4, w1);
+        Write8(out, 8, w2);
+        Write8(out, 12, w3);
+        Write8(out, 16, w4);
+        Write8(out, 20, w5);
+        Write8(out, 24, w6);
+        Write8(out, 28, w7);
+        return;
+    }
+
     // Transform 3
     a = K(0x6a09e667ul);
     b = K(0xbb67ae85ul);
@@ -322,4 +334,16 @@ void Transform_8way(unsigned char* out, const unsigned char* in)
 
 }
 
+void Transform_8way(unsigned char* out, const unsigned char* in)
+{
+    TransformMultiway<true>(out, in);
+}
+
+void TransformS64_8way(unsigned char* out, const unsigned char* in)
+{
+    TransformMultiway<false>(out, in);
+}
+
+}
+
 #endif
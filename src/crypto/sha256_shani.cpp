@@ -143,8 +143,11 @@ void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks)
 }
 
 namespace sha256d64_shani {
+namespace {
 
-void Transform_2way(unsigned char* out, const unsigned char* in)
+/** The first two transforms give the single SHA256, the third one hashes that again. */
+template<bool fDouble>
+void inline TransformMultiway(unsigned char* out, const unsigned char* in)
 {
     __m128i am0, am1, am2, am3, as0, as1, aso0, aso1;
     __m128i bm0, bm1, bm2, bm3, bs0, bs1, bso0, bso1;
@@ -270,6 +273,15 @@ void Transform_2way(unsigned char* out, const unsigned char* in)
     /* Extract hash */
     Unshuffle(as0, as1);
     Unshuffle(bs0, bs1);
+
+    if (!fDouble) {
+        Save(out, as0);
+        Save(out + 16, as1);
+        Save(out + 32, bs0);
+        Save(out + 48, bs1);
+        return;
+    }
+
     am0 = as0;
     bm0 = bs0;
     am1 = as1;
@@ -356,4 +368,16 @@ void Transform_2way(unsigned char* out, const unsigned char* in)
 
 }
 
+void Transform_2way(unsigned char* out, const unsigned char* in)
+{
+    TransformMultiway<true>(out, in);
+}
+
+void TransformS64_2way(unsigned char* out, const unsigned char* in)
+{
+    TransformMultiway<false>(out, in);
+}
+
+}
+
 #endif
@@ -59,9 +59,9 @@ void inline Write4(unsigned char* out, int offset, __m128i v) {
     WriteLE32(out + 96 + offset, _mm_extract_epi32(v, 0));
 }
 
-}
-
-void Transform_4way(unsigned char* out, const unsigned char* in)
+/** The first two transforms give the single SHA256, the third one hashes that again. */
+template<bool fDouble>
+void inline TransformMultiway(unsigned char* out, const unsigned char* in)
 {
     // Transform 1
     __m128i a = K(0x6a09e667ul);
@@ -226,6 +226,18 @@ void Transform_4way(unsigned char* out, const unsigned char* in)
     w6 = Add(t6, g);
     w7 = Add(t7, h);
 
+    if (!fDouble) {
+        Write4(out, 0, w0);
+        Write4(out, 4, w1);
+        Write4(out, 8, w2);
+        Write4(out, 12, w3);
+        Write4(out, 16, w4);
+        Write4(out, 20, w5);
+        Write4(out, 24, w6);
+        Write4(out, 28, w7);
+        return;
+    }
+
     // Transform 3
     a = K(0x6a09e667ul);
     b = K(0xbb67ae85ul);
@@ -314,4 +326,16 @@ void Transform_4way(unsigned char* out, const unsigned char* in)
 
 }
 
+void Transform_4way(unsigned char* out, const unsigned char* in)
+{
+    TransformMultiway<true>(out, in);
+}
+
+void TransformS64_4way(unsigned char* out, const unsigned char* in)
+{
+    TransformMultiway<false>(out, in);
+}
+
+}
+
 #endif
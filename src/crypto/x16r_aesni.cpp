@@ -0,0 +1,300 @@
+// Copyright (c) 2018-2021 The Genix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// AES-NI implementations of the ECHO-512 and SHAvite-512 compression functions used
+// by X16R. Both are built from plain AES rounds, which map 1:1 onto AESENC. Buffering,
+// padding and the contexts are the same as in the sphlib versions (echo.c, shavite.c),
+// so the results are bit for bit identical.
+
+#ifdef ENABLE_AESNI
+
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include <algorithm>
+
+#include <crypto/common.h>
+#include <crypto/sph_echo.h>
+#include <crypto/sph_shavite.h>
+
+namespace {
+
+inline __m128i Load(const void* p) { return _mm_loadu_si128((const __m128i*)p); }
+inline void Store(void* p, __m128i x) { _mm_storeu_si128((__m128i*)p, x); }
+
+/** Multiply every byte by x in GF(2^8) with the AES polynomial */
+inline __m128i XTime(__m128i x)
+{
+    __m128i hi = _mm_cmplt_epi8(x, _mm_setzero_si128());
+    return _mm_xor_si128(_mm_add_epi8(x, x), _mm_and_si128(hi, _mm_set1_epi8(0x1b)));
+}
+
+void EchoCompress(sph_echo_big_context* sc)
+{
+    __m128i W[16];
+    for (int i = 0; i < 8; i++) {
+        W[i] = Load(&sc->u.Vb[i][0]);
+        W[i + 8] = Load(sc->buf + 16 * i);
+    }
+
+    // the 128 bit counter is the key of the first AES round, incremented after each word
+    uint64_t k0 = (uint64_t)sc->C0 | ((uint64_t)sc->C1 << 32);
+    uint64_t k1 = (uint64_t)sc->C2 | ((uint64_t)sc->C3 << 32);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (int r = 0; r < 10; r++) {
+        // BIG.SubWords
+        for (int i = 0; i < 16; i++) {
+            W[i] = _mm_aesenc_si128(W[i], _mm_set_epi64x(k1, k0));
+            W[i] = _mm_aesenc_si128(W[i], zero);
+            if (++k0 == 0) {
+                k1++;
+            }
+        }
+
+        // BIG.ShiftRows
+        __m128i t;
+        t = W[1]; W[1] = W[5]; W[5] = W[9]; W[9] = W[13]; W[13] = t;
+        t = W[2]; W[2] = W[10]; W[10] = t;
+        t = W[6]; W[6] = W[14]; W[14] = t;
+        t = W[15]; W[15] = W[11]; W[11] = W[7]; W[7] = W[3]; W[3] = t;
+
+        // BIG.MixColumns
+        for (int i = 0; i < 16; i += 4) {
+            __m128i a = W[i], b = W[i + 1], c = W[i + 2], d = W[i + 3];
+            __m128i ab = _mm_xor_si128(a, b);
+            __m128i bc = _mm_xor_si128(b, c);
+            __m128i cd = _mm_xor_si128(c, d);
+            __m128i abx = XTime(ab);
+            __m128i bcx = XTime(bc);
+            __m128i cdx = XTime(cd);
+            W[i] = _mm_xor_si128(abx, _mm_xor_si128(bc, d));
+            W[i + 1] = _mm_xor_si128(bcx, _mm_xor_si128(a, cd));
+            W[i + 2] = _mm_xor_si128(cdx, _mm_xor_si128(ab, d));
+            W[i + 3] = _mm_xor_si128(_mm_xor_si128(abx, bcx), _mm_xor_si128(cdx, _mm_xor_si128(ab, c)));
+        }
+    }
+
+    for (int i = 0; i < 8; i++) {
+        __m128i v = Load(&sc->u.Vb[i][0]);
+        v = _mm_xor_si128(v, _mm_xor_si128(Load(sc->buf + 16 * i), _mm_xor_si128(W[i], W[i + 8])));
+        Store(&sc->u.Vb[i][0], v);
+    }
+}
+
+void EchoIncrCounter(sph_echo_big_context* sc, uint32_t val)
+{
+    sc->C0 += val;
+    if (sc->C0 < val) {
+        if (++sc->C1 == 0)
+            if (++sc->C2 == 0)
+                ++sc->C3;
+    }
+}
+
+void ShaviteCompress(sph_shavite_big_context* sc, const unsigned char* msg)
+{
+    alignas(16) uint32_t rk[448];
+    memcpy(rk, msg, 128);
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set_epi32(-1, 0, 0, 0);
+
+    // key schedule, alternating nonlinear (AES based) and linear expansion
+    size_t u = 32;
+    for (;;) {
+        for (int s = 0; s < 8; s++) {
+            __m128i x = _mm_shuffle_epi32(Load(&rk[u - 32]), 0x39);
+            x = _mm_aesenc_si128(x, zero);
+            x = _mm_xor_si128(x, Load(&rk[u - 4]));
+            if (u == 32) {
+                x = _mm_xor_si128(x, _mm_xor_si128(_mm_set_epi32(sc->count3, sc->count2, sc->count1, sc->count0), ones));
+            } else if (u == 164) {
+                x = _mm_xor_si128(x, _mm_xor_si128(_mm_set_epi32(sc->count0, sc->count1, sc->count2, sc->count3), ones));
+            } else if (u == 316) {
+                x = _mm_xor_si128(x, _mm_xor_si128(_mm_set_epi32(sc->count1, sc->count0, sc->count3, sc->count2), ones));
+            } else if (u == 440) {
+                x = _mm_xor_si128(x, _mm_xor_si128(_mm_set_epi32(sc->count2, sc->count3, sc->count0, sc->count1), ones));
+            }
+            Store(&rk[u], x);
+            u += 4;
+        }
+        if (u == 448)
+            break;
+        for (int s = 0; s < 8; s++) {
+            Store(&rk[u], _mm_xor_si128(Load(&rk[u - 32]), Load(&rk[u - 7])));
+            u += 4;
+        }
+    }
+
+    __m128i p0 = Load(&sc->h[0]);
+    __m128i p1 = Load(&sc->h[4]);
+    __m128i p2 = Load(&sc->h[8]);
+    __m128i p3 = Load(&sc->h[12]);
+    const __m128i* k = (const __m128i*)rk;
+    for (int r = 0; r < 14; r++) {
+        __m128i x;
+        x = _mm_xor_si128(p1, k[0]);
+        x = _mm_aesenc_si128(x, k[1]);
+        x = _mm_aesenc_si128(x, k[2]);
+        x = _mm_aesenc_si128(x, k[3]);
+        x = _mm_aesenc_si128(x, zero);
+        p0 = _mm_xor_si128(p0, x);
+
+        x = _mm_xor_si128(p3, k[4]);
+        x = _mm_aesenc_si128(x, k[5]);
+        x = _mm_aesenc_si128(x, k[6]);
+        x = _mm_aesenc_si128(x, k[7]);
+        x = _mm_aesenc_si128(x, zero);
+        p2 = _mm_xor_si128(p2, x);
+        k += 8;
+
+        __m128i t = p3;
+        p3 = p2;
+        p2 = p1;
+        p1 = p0;
+        p0 = t;
+    }
+
+    Store(&sc->h[0], _mm_xor_si128(Load(&sc->h[0]), p0));
+    Store(&sc->h[4], _mm_xor_si128(Load(&sc->h[4]), p1));
+    Store(&sc->h[8], _mm_xor_si128(Load(&sc->h[8]), p2));
+    Store(&sc->h[12], _mm_xor_si128(Load(&sc->h[12]), p3));
+}
+
+} // namespace
+
+namespace echo512_aesni {
+
+void Init(void* cc)
+{
+    sph_echo512_init(cc);
+}
+
+void Update(void* cc, const void* data, size_t len)
+{
+    sph_echo_big_context* sc = (sph_echo_big_context*)cc;
+    const unsigned char* in = (const unsigned char*)data;
+    size_t ptr = sc->ptr;
+    while (len > 0) {
+        size_t clen = std::min(sizeof sc->buf - ptr, len);
+        memcpy(sc->buf + ptr, in, clen);
+        ptr += clen;
+        in += clen;
+        len -= clen;
+        if (ptr == sizeof sc->buf) {
+            EchoIncrCounter(sc, 1024);
+            EchoCompress(sc);
+            ptr = 0;
+        }
+    }
+    sc->ptr = ptr;
+}
+
+void Close(void* cc, void* dst)
+{
+    sph_echo_big_context* sc = (sph_echo_big_context*)cc;
+    unsigned char* buf = sc->buf;
+    size_t ptr = sc->ptr;
+    unsigned char count[16];
+
+    uint32_t elen = (uint32_t)ptr << 3;
+    EchoIncrCounter(sc, elen);
+    WriteLE32(count, sc->C0);
+    WriteLE32(count + 4, sc->C1);
+    WriteLE32(count + 8, sc->C2);
+    WriteLE32(count + 12, sc->C3);
+    // a block without any message bits is processed with a zero counter
+    if (elen == 0) {
+        sc->C0 = sc->C1 = sc->C2 = sc->C3 = 0;
+    }
+    buf[ptr++] = 0x80;
+    memset(buf + ptr, 0, sizeof sc->buf - ptr);
+    if (ptr > sizeof sc->buf - 18) {
+        EchoCompress(sc);
+        sc->C0 = sc->C1 = sc->C2 = sc->C3 = 0;
+        memset(buf, 0, sizeof sc->buf);
+    }
+    buf[sizeof sc->buf - 18] = 0x00; // 512 bit output, little endian
+    buf[sizeof sc->buf - 17] = 0x02;
+    memcpy(buf + sizeof sc->buf - 16, count, 16);
+    EchoCompress(sc);
+    memcpy(dst, sc->u.Vb, 64);
+    sph_echo512_init(cc);
+}
+
+} // namespace echo512_aesni
+
+namespace shavite512_aesni {
+
+void Init(void* cc)
+{
+    sph_shavite512_init(cc);
+}
+
+void Update(void* cc, const void* data, size_t len)
+{
+    sph_shavite_big_context* sc = (sph_shavite_big_context*)cc;
+    const unsigned char* in = (const unsigned char*)data;
+    size_t ptr = sc->ptr;
+    while (len > 0) {
+        size_t clen = std::min(sizeof sc->buf - ptr, len);
+        memcpy(sc->buf + ptr, in, clen);
+        ptr += clen;
+        in += clen;
+        len -= clen;
+        if (ptr == sizeof sc->buf) {
+            if ((sc->count0 += 1024) == 0) {
+                if (++sc->count1 == 0)
+                    if (++sc->count2 == 0)
+                        ++sc->count3;
+            }
+            ShaviteCompress(sc, sc->buf);
+            ptr = 0;
+        }
+    }
+    sc->ptr = ptr;
+}
+
+void Close(void* cc, void* dst)
+{
+    sph_shavite_big_context* sc = (sph_shavite_big_context*)cc;
+    unsigned char* buf = sc->buf;
+    size_t ptr = sc->ptr;
+
+    uint32_t count0 = (sc->count0 += ptr << 3);
+    uint32_t count1 = sc->count1;
+    uint32_t count2 = sc->count2;
+    uint32_t count3 = sc->count3;
+    if (ptr == 0) {
+        buf[0] = 0x80;
+        memset(buf + 1, 0, 109);
+        sc->count0 = sc->count1 = sc->count2 = sc->count3 = 0;
+    } else if (ptr < 110) {
+        buf[ptr++] = 0x80;
+        memset(buf + ptr, 0, 110 - ptr);
+    } else {
+        buf[ptr++] = 0x80;
+        memset(buf + ptr, 0, 128 - ptr);
+        ShaviteCompress(sc, buf);
+        memset(buf, 0, 110);
+        sc->count0 = sc->count1 = sc->count2 = sc->count3 = 0;
+    }
+    WriteLE32(buf + 110, count0);
+    WriteLE32(buf + 114, count1);
+    WriteLE32(buf + 118, count2);
+    WriteLE32(buf + 122, count3);
+    buf[126] = 0x00; // 512 bit output, little endian
+    buf[127] = 0x02;
+    ShaviteCompress(sc, buf);
+    for (int u = 0; u < 16; u++) {
+        WriteLE32((unsigned char*)dst + (u << 2), sc->h[u]);
+    }
+    sph_shavite512_init(cc);
+}
+
+} // namespace shavite512_aesni
+
+#endif
@@ -7,12 +7,22 @@
 
 #include "clientversion.h"
 #include "fs.h"
+#include "hash.h"
+#include "memusage.h"
+#include "random.h"
 #include "serialize.h"
 #include "streams.h"
 #include "util.h"
 #include "utilstrencodings.h"
 #include "version.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <typeindex>
 
 #include <leveldb/db.h>
@@ -251,12 +261,20 @@ public:
         return ReadDataStream(ssKey, ssValue);
     }
 
-    bool ReadDataStream(const CDataStream& ssKey, CDataStream& ssValue) const
+    /** snapshot optionally points to a snapshot obtained from GetSnapshot() to read from */
+    bool ReadDataStream(const CDataStream& ssKey, CDataStream& ssValue, const leveldb::Snapshot* snapshot = nullptr) const
     {
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        leveldb::Status status;
+        if (snapshot) {
+            leveldb::ReadOptions snapshotoptions = readoptions;
+            snapshotoptions.snapshot = snapshot;
+            status = pdb->Get(snapshotoptions, slKey, &strValue);
+        } else {
+            status = pdb->Get(readoptions, slKey, &strValue);
+        }
         if (!status.ok()) {
             if (status.IsNotFound())
                 return false;
@@ -336,6 +354,17 @@ public:
 
     bool WriteBatch(CDBBatch& batch, bool fSync = false);
 
+    /** Returns a consistent view of the current DB state, which must be released with ReleaseSnapshot() */
+    const leveldb::Snapshot* GetSnapshot() const
+    {
+        return pdb->GetSnapshot();
+    }
+
+    void ReleaseSnapshot(const leveldb::Snapshot* snapshot) const
+    {
+        pdb->ReleaseSnapshot(snapshot);
+    }
+
     // not available for LevelDB; provide for compatibility with BDB
     bool Flush()
     {
@@ -397,6 +426,75 @@ public:
 
 };
 
+/**
+ * Bump allocator used by CDBTransaction for keys and value holders. Memory is handed out from large chunks and only
+ * released as a whole by Clear(), which keeps one chunk around so that a transaction that is reused for every block
+ * doesn't go back to malloc for each write.
+ */
+class CDBArena
+{
+private:
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+    std::vector<Chunk> chunks;
+    size_t chunkUsed{0}; // bytes used in chunks.back()
+
+public:
+    CDBArena() = default;
+    CDBArena(const CDBArena&) = delete;
+    CDBArena& operator=(const CDBArena&) = delete;
+
+    void* Allocate(size_t size, size_t align)
+    {
+        if (!chunks.empty()) {
+            size_t offset = (chunkUsed + align - 1) & ~(align - 1);
+            if (offset + size <= chunks.back().size) {
+                chunkUsed = offset + size;
+                return chunks.back().data.get() + offset;
+            }
+        }
+        if (size > CHUNK_SIZE / 4 && !chunks.empty()) {
+            // oversized allocations get a chunk of their own, so that the current chunk can still be filled up
+            chunks.insert(chunks.end() - 1, Chunk{std::unique_ptr<char[]>(new char[size]), size});
+            return chunks[chunks.size() - 2].data.get();
+        }
+        size_t chunkSize = CHUNK_SIZE;
+        if (size > chunkSize) {
+            chunkSize = size;
+        }
+        chunks.emplace_back(Chunk{std::unique_ptr<char[]>(new char[chunkSize]), chunkSize});
+        chunkUsed = size;
+        return chunks.back().data.get();
+    }
+
+    void Clear()
+    {
+        // keep one regular chunk for the next use
+        auto it = std::find_if(chunks.begin(), chunks.end(), [](const Chunk& chunk) { return chunk.size == CHUNK_SIZE; });
+        if (it != chunks.end()) {
+            Chunk keep = std::move(*it);
+            chunks.clear();
+            chunks.emplace_back(std::move(keep));
+        } else {
+            chunks.clear();
+        }
+        chunkUsed = 0;
+    }
+
+    size_t GetMemoryUsage() const
+    {
+        size_t usage = memusage::DynamicUsage(chunks);
+        for (const auto& chunk : chunks) {
+            usage += memusage::MallocUsage(chunk.size);
+        }
+        return usage;
+    }
+};
+
 template<typename CDBTransaction>
 class CDBTransactionIterator
 {
@@ -409,7 +507,10 @@ private:
     // At all times, only one of both provides the current value. The decision is made by comparing the current keys
     // of both iterators, so that always the smaller key is the current one. On Next(), the previously chosen iterator
     // is advanced.
-    typename CDBTransaction::WritesMap::iterator transactionIt;
+    // The transaction side is a position in the sorted entries of the transaction, so the transaction must not be
+    // modified while it is iterated.
+    const std::vector<uint32_t>& sortedEntries;
+    size_t transactionPos;
     std::unique_ptr<ParentIterator> parentIt;
     CDataStream parentKey;
     bool curIsParent{false};
@@ -417,14 +518,16 @@ private:
 public:
     CDBTransactionIterator(CDBTransaction& _transaction) :
             transaction(_transaction),
+            sortedEntries(_transaction.GetSortedEntries()),
             parentKey(SER_DISK, CLIENT_VERSION)
     {
-        transactionIt = transaction.writes.end();
+        transactionPos = sortedEntries.size();
         parentIt = std::unique_ptr<ParentIterator>(transaction.parent.NewIterator());
     }
 
     void SeekToFirst() {
-        transactionIt = transaction.writes.begin();
+        transactionPos = 0;
+        SkipErased();
         parentIt->SeekToFirst();
         SkipDeletedAndOverwritten();
         DecideCur();
@@ -436,18 +539,19 @@ public:
     }
 
     void Seek(const CDataStream& ssKey) {
-        transactionIt = transaction.writes.lower_bound(ssKey);
+        transactionPos = transaction.LowerBound(ssKey);
+        SkipErased();
         parentIt->Seek(ssKey);
         SkipDeletedAndOverwritten();
         DecideCur();
     }
 
     bool Valid() {
-        return transactionIt != transaction.writes.end() || parentIt->Valid();
+        return TransactionValid() || parentIt->Valid();
     }
 
     void Next() {
-        if (transactionIt == transaction.writes.end() && !parentIt->Valid()) {
+        if (!TransactionValid() && !parentIt->Valid()) {
             return;
         }
         if (curIsParent) {
@@ -455,8 +559,9 @@ public:
             parentIt->Next();
             SkipDeletedAndOverwritten();
         } else {
-            assert(transactionIt != transaction.writes.end());
-            ++transactionIt;
+            assert(TransactionValid());
+            ++transactionPos;
+            SkipErased();
         }
         DecideCur();
     }
@@ -467,25 +572,14 @@ public:
             return false;
         }
 
-        if (curIsParent) {
-            try {
-                // TODO try to avoid this copy (we need a stream that allows reading from external buffers)
-                CDataStream ssKey = parentKey;
-                ssKey >> key;
-            } catch (const std::exception&) {
-                return false;
-            }
-            return true;
-        } else {
-            try {
-                // TODO try to avoid this copy (we need a stream that allows reading from external buffers)
-                CDataStream ssKey = transactionIt->first;
-                ssKey >> key;
-            } catch (const std::exception&) {
-                return false;
-            }
-            return true;
+        try {
+            // TODO try to avoid this copy (we need a stream that allows reading from external buffers)
+            CDataStream ssKey = curIsParent ? parentKey : CurTransactionKey();
+            ssKey >> key;
+        } catch (const std::exception&) {
+            return false;
         }
+        return true;
     }
 
     CDataStream GetKey() {
@@ -495,7 +589,7 @@ public:
         if (curIsParent) {
             return parentKey;
         } else {
-            return transactionIt->first;
+            return CurTransactionKey();
         }
     }
 
@@ -506,7 +600,7 @@ public:
         if (curIsParent) {
             return parentIt->GetKeySize();
         } else {
-            return transactionIt->first.vKey.size();
+            return CurEntry().keySize;
         }
     }
 
@@ -518,15 +612,34 @@ public:
         if (curIsParent) {
             return transaction.Read(parentKey, value);
         } else {
-            return transaction.Read(transactionIt->first, value);
+            return CDBTransaction::ReadEntry(CurEntry(), value);
         }
     };
 
 private:
+    bool TransactionValid() const {
+        return transactionPos < sortedEntries.size();
+    }
+
+    const typename CDBTransaction::Entry& CurEntry() const {
+        return transaction.entries[sortedEntries[transactionPos]];
+    }
+
+    CDataStream CurTransactionKey() const {
+        const auto& e = CurEntry();
+        return CDataStream(e.key, e.key + e.keySize, SER_DISK, CLIENT_VERSION);
+    }
+
+    void SkipErased() {
+        while (TransactionValid() && !CurEntry().value) {
+            ++transactionPos;
+        }
+    }
+
     void SkipDeletedAndOverwritten() {
         while (parentIt->Valid()) {
             parentKey = parentIt->GetKey();
-            if (!transaction.deletes.count(parentKey) && !transaction.writes.count(parentKey)) {
+            if (!transaction.HasEntry(parentKey)) {
                 break;
             }
             parentIt->Next();
@@ -534,47 +647,51 @@ private:
     }
 
     void DecideCur() {
-        if (transactionIt != transaction.writes.end() && !parentIt->Valid()) {
+        if (TransactionValid() && !parentIt->Valid()) {
             curIsParent = false;
-        } else if (transactionIt == transaction.writes.end() && parentIt->Valid()) {
+        } else if (!TransactionValid() && parentIt->Valid()) {
             curIsParent = true;
-        } else if (transactionIt != transaction.writes.end() && parentIt->Valid()) {
-            if (CDBTransaction::DataStreamCmp::less(transactionIt->first, parentKey)) {
-                curIsParent = false;
-            } else {
-                curIsParent = true;
-            }
+        } else if (TransactionValid() && parentIt->Valid()) {
+            const auto& e = CurEntry();
+            curIsParent = CDBTransaction::CompareKeys(e.key, e.keySize, parentKey.data(), parentKey.size()) >= 0;
         }
     }
 };
 
+/**
+ * Buffers writes and erases on top of a parent (a CDBWrapper or another CDBTransaction) until they are committed.
+ *
+ * Keys are copied into an arena and values are kept in their typed form (also placed in the arena) until Commit(),
+ * which serializes them and hands all pending changes to the commit target in key order. Entries are found through
+ * an open addressing hash table and only sorted when an iterator or Commit() needs it. The vectors and the arena are
+ * reused after Clear(), so a transaction that is used for every block mostly works without any allocations.
+ */
 template<typename Parent, typename CommitTarget>
 class CDBTransaction {
     friend class CDBTransactionIterator<CDBTransaction>;
 
-protected:
-    Parent &parent;
-    CommitTarget &commitTarget;
-    ssize_t memoryUsage{0}; // signed, just in case we made an error in the calculations so that we don't get an overflow
+public:
+    /** A value that was serialized already. It serializes to its bytes, so it can be written without decoding it */
+    struct SerializedValue {
+        std::shared_ptr<const std::string> data;
 
-    struct DataStreamCmp {
-        static bool less(const CDataStream& a, const CDataStream& b) {
-            return std::lexicographical_compare(
-                    (const uint8_t*)a.data(), (const uint8_t*)a.data() + a.size(),
-                    (const uint8_t*)b.data(), (const uint8_t*)b.data() + b.size());
-        }
-        bool operator()(const CDataStream& a, const CDataStream& b) const {
-            return less(a, b);
+        template <typename Stream>
+        void Serialize(Stream& s) const {
+            s.write(data->data(), data->size());
         }
     };
 
+protected:
+    Parent &parent;
+    CommitTarget &commitTarget;
+
     struct ValueHolder {
         size_t memoryUsage;
         ValueHolder(size_t _memoryUsage) : memoryUsage(_memoryUsage) {}
         virtual ~ValueHolder() = default;
         virtual void Write(const CDataStream& ssKey, CommitTarget &parent) = 0;
+        virtual void Serialize(CDataStream& ssValue) const = 0;
     };
-    typedef std::unique_ptr<ValueHolder> ValueHolderPtr;
 
     template <typename V>
     struct ValueHolderImpl : ValueHolder {
@@ -582,12 +699,50 @@ protected:
 
         virtual void Write(const CDataStream& ssKey, CommitTarget &commitTarget) {
             // we're moving the value instead of copying it. This means that Write() can only be called once per
-            // ValueHolderImpl instance. Commit() clears the write maps, so this ok.
+            // ValueHolderImpl instance. Commit() clears the transaction, so this ok.
             commitTarget.Write(ssKey, std::move(value));
         }
+        virtual void Serialize(CDataStream& ssValue) const {
+            ssValue << value;
+        }
         V value;
     };
 
+    // Reads deserialize the bytes, which may be shared with other owners (e.g. the snapshot overlay of CEvoDB)
+    struct SerializedValueHolder : ValueHolder {
+        SerializedValueHolder(std::shared_ptr<const std::string> _data) : ValueHolder(_data->size()), data(std::move(_data)) {}
+
+        virtual void Write(const CDataStream& ssKey, CommitTarget &commitTarget) {
+            commitTarget.Write(ssKey, SerializedValue{data});
+        }
+        virtual void Serialize(CDataStream& ssValue) const {
+            ssValue.write(data->data(), data->size());
+        }
+        std::shared_ptr<const std::string> data;
+    };
+
+    struct Entry {
+        uint64_t hash;
+        const char* key; // in the arena
+        uint32_t keySize;
+        ValueHolder* value; // in the arena, nullptr for pending erases
+    };
+
+    static const uint32_t NO_ENTRY = std::numeric_limits<uint32_t>::max();
+    // hash tables bigger than this are freed by Clear() instead of being kept for the next use
+    static const size_t MAX_RETAINED_SLOTS = 1 << 16;
+
+    CDBArena arena;
+    std::vector<Entry> entries; // in order of first use of the key
+    std::vector<uint32_t> table; // indexes into entries, at most half full
+    const uint64_t k0, k1; // salt for the hash table
+    size_t valuesMemoryUsage{0};
+
+    // indexes into entries, sorted by key. Only rebuilt when a new key was added since it was last used
+    mutable std::vector<uint32_t> sortedEntries;
+    mutable std::atomic<bool> fSortedValid{true};
+    mutable std::mutex cs_sorted;
+
     template<typename K>
     static CDataStream KeyToDataStream(const K& key) {
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
@@ -596,14 +751,145 @@ protected:
         return ssKey;
     }
 
-    typedef std::map<CDataStream, ValueHolderPtr, DataStreamCmp> WritesMap;
-    typedef std::set<CDataStream, DataStreamCmp> DeletesSet;
+    /** Same order as leveldb's default comparator */
+    static int CompareKeys(const char* a, size_t aSize, const char* b, size_t bSize) {
+        size_t n = aSize < bSize ? aSize : bSize;
+        int r = n ? memcmp(a, b, n) : 0;
+        if (r != 0) {
+            return r;
+        }
+        return aSize < bSize ? -1 : (aSize > bSize ? 1 : 0);
+    }
+
+    template <typename V>
+    static bool ReadEntry(const Entry& e, V& value) {
+        if (!e.value) {
+            return false;
+        }
+        if (auto *impl = dynamic_cast<ValueHolderImpl<V> *>(e.value)) {
+            value = impl->value;
+            return true;
+        }
+        auto *serialized = dynamic_cast<SerializedValueHolder *>(e.value);
+        if (!serialized) {
+            throw std::runtime_error("Read called with V != previously written type");
+        }
+        try {
+            CDataStream ssValue(serialized->data->data(), serialized->data->data() + serialized->data->size(), SER_DISK, CLIENT_VERSION);
+            ssValue >> value;
+        } catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t HashKey(const char* key, size_t keySize) const {
+        return CSipHasher(k0, k1).Write((const unsigned char*)key, keySize).Finalize();
+    }
+
+    const Entry* FindEntry(const CDataStream& ssKey) const {
+        if (table.empty()) {
+            return nullptr;
+        }
+        uint64_t hash = HashKey(ssKey.data(), ssKey.size());
+        size_t mask = table.size() - 1;
+        for (size_t i = hash & mask; table[i] != NO_ENTRY; i = (i + 1) & mask) {
+            const Entry& e = entries[table[i]];
+            if (e.hash == hash && CompareKeys(e.key, e.keySize, ssKey.data(), ssKey.size()) == 0) {
+                return &e;
+            }
+        }
+        return nullptr;
+    }
+
+    bool HasEntry(const CDataStream& ssKey) const {
+        return FindEntry(ssKey) != nullptr;
+    }
+
+    void InsertIntoTable(uint32_t idx) {
+        size_t mask = table.size() - 1;
+        size_t i = entries[idx].hash & mask;
+        while (table[i] != NO_ENTRY) {
+            i = (i + 1) & mask;
+        }
+        table[i] = idx;
+    }
+
+    Entry& GetOrAddEntry(const CDataStream& ssKey) {
+        const Entry* existing = FindEntry(ssKey);
+        if (existing) {
+            return entries[existing - entries.data()];
+        }
+
+        if ((entries.size() + 1) * 2 > table.size()) {
+            table.assign(table.empty() ? 64 : table.size() * 2, (uint32_t)NO_ENTRY);
+            for (uint32_t i = 0; i < entries.size(); i++) {
+                InsertIntoTable(i);
+            }
+        }
+
+        char* key = (char*)arena.Allocate(ssKey.size(), 1);
+        if (!ssKey.empty()) {
+            memcpy(key, ssKey.data(), ssKey.size());
+        }
+        entries.emplace_back(Entry{HashKey(ssKey.data(), ssKey.size()), key, (uint32_t)ssKey.size(), nullptr});
+        InsertIntoTable(entries.size() - 1);
+        fSortedValid = false;
+        return entries.back();
+    }
+
+    void ReleaseValue(Entry& e) {
+        if (e.value) {
+            valuesMemoryUsage -= e.value->memoryUsage;
+            // the memory itself stays in the arena until Clear()
+            e.value->~ValueHolder();
+            e.value = nullptr;
+        }
+    }
+
+    const std::vector<uint32_t>& GetSortedEntries() const {
+        if (!fSortedValid) {
+            std::lock_guard<std::mutex> lock(cs_sorted);
+            if (!fSortedValid) {
+                sortedEntries.resize(entries.size());
+                for (uint32_t i = 0; i < entries.size(); i++) {
+                    sortedEntries[i] = i;
+                }
+                std::sort(sortedEntries.begin(), sortedEntries.end(), [this](uint32_t a, uint32_t b) {
+                    const Entry& ea = entries[a];
+                    const Entry& eb = entries[b];
+                    return CompareKeys(ea.key, ea.keySize, eb.key, eb.keySize) < 0;
+                });
+                fSortedValid = true;
+            }
+        }
+        return sortedEntries;
+    }
 
-    WritesMap writes;
-    DeletesSet deletes;
+    size_t LowerBound(const CDataStream& ssKey) const {
+        const auto& sorted = GetSortedEntries();
+        auto it = std::lower_bound(sorted.begin(), sorted.end(), ssKey, [this](uint32_t idx, const CDataStream& k) {
+            const Entry& e = entries[idx];
+            return CompareKeys(e.key, e.keySize, k.data(), k.size()) < 0;
+        });
+        return it - sorted.begin();
+    }
 
 public:
-    CDBTransaction(Parent &_parent, CommitTarget &_commitTarget) : parent(_parent), commitTarget(_commitTarget) {}
+    CDBTransaction(Parent &_parent, CommitTarget &_commitTarget) :
+            parent(_parent),
+            commitTarget(_commitTarget),
+            k0(GetRand(std::numeric_limits<uint64_t>::max())),
+            k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+    CDBTransaction(const CDBTransaction&) = delete;
+    CDBTransaction& operator=(const CDBTransaction&) = delete;
+
+    ~CDBTransaction() {
+        for (auto& e : entries) {
+            ReleaseValue(e);
+        }
+    }
 
     template <typename K, typename V>
     void Write(const K& key, const V& v) {
@@ -612,18 +898,25 @@ public:
 
     template <typename V>
     void Write(const CDataStream& ssKey, const V& v) {
+        static_assert(alignof(ValueHolderImpl<V>) <= alignof(std::max_align_t), "over-aligned values are not supported");
+
         auto valueMemoryUsage = ::GetSerializeSize(v, SER_DISK, CLIENT_VERSION);
 
-        if (deletes.erase(ssKey)) {
-            memoryUsage -= ssKey.size();
-        }
-        auto it = writes.emplace(ssKey, nullptr).first;
-        if (it->second) {
-            memoryUsage -= ssKey.size() + it->second->memoryUsage;
-        }
-        it->second = std::make_unique<ValueHolderImpl<V>>(v, valueMemoryUsage);
+        Entry& e = GetOrAddEntry(ssKey);
+        void* p = arena.Allocate(sizeof(ValueHolderImpl<V>), alignof(ValueHolderImpl<V>));
+        ValueHolder* holder = new (p) ValueHolderImpl<V>(v, valueMemoryUsage);
+        ReleaseValue(e);
+        e.value = holder;
+        valuesMemoryUsage += valueMemoryUsage;
+    }
 
-        memoryUsage += ssKey.size() + valueMemoryUsage;
+    void Write(const CDataStream& ssKey, const SerializedValue& v) {
+        Entry& e = GetOrAddEntry(ssKey);
+        void* p = arena.Allocate(sizeof(SerializedValueHolder), alignof(SerializedValueHolder));
+        ValueHolder* holder = new (p) SerializedValueHolder(v.data);
+        ReleaseValue(e);
+        e.value = holder;
+        valuesMemoryUsage += holder->memoryUsage;
     }
 
     template <typename K, typename V>
@@ -633,18 +926,9 @@ public:
 
     template <typename V>
     bool Read(const CDataStream& ssKey, V& value) {
-        if (deletes.count(ssKey)) {
-            return false;
-        }
-
-        auto it = writes.find(ssKey);
-        if (it != writes.end()) {
-            auto *impl = dynamic_cast<ValueHolderImpl<V> *>(it->second.get());
-            if (!impl) {
-                throw std::runtime_error("Read called with V != previously written type");
-            }
-            value = impl->value;
-            return true;
+        const Entry* e = FindEntry(ssKey);
+        if (e) {
+            return ReadEntry(*e, value);
         }
 
         return parent.Read(ssKey, value);
@@ -656,12 +940,9 @@ public:
     }
 
     bool Exists(const CDataStream& ssKey) {
-        if (deletes.count(ssKey)) {
-            return false;
-        }
-
-        if (writes.count(ssKey)) {
-            return true;
+        const Entry* e = FindEntry(ssKey);
+        if (e) {
+            return e->value != nullptr;
         }
 
         return parent.Exists(ssKey);
@@ -673,47 +954,80 @@ public:
     }
 
     void Erase(const CDataStream& ssKey) {
-        auto it = writes.find(ssKey);
-        if (it != writes.end()) {
-            memoryUsage -= ssKey.size() + it->second->memoryUsage;
-            writes.erase(it);
-        }
-        if (deletes.emplace(ssKey).second) {
-            memoryUsage += ssKey.size();
-        }
+        ReleaseValue(GetOrAddEntry(ssKey));
     }
 
     void Clear() {
-        writes.clear();
-        deletes.clear();
-        memoryUsage = 0;
+        for (auto& e : entries) {
+            ReleaseValue(e);
+        }
+        entries.clear();
+        sortedEntries.clear();
+        if (table.size() > MAX_RETAINED_SLOTS) {
+            std::vector<Entry>().swap(entries);
+            std::vector<uint32_t>().swap(table);
+            std::vector<uint32_t>().swap(sortedEntries);
+        } else {
+            std::fill(table.begin(), table.end(), (uint32_t)NO_ENTRY);
+        }
+        fSortedValid = true;
+        arena.Clear();
+        valuesMemoryUsage = 0;
     }
 
     void Commit() {
-        for (const auto &k : deletes) {
-            commitTarget.Erase(k);
-        }
-        for (auto &p : writes) {
-            p.second->Write(p.first, commitTarget);
+        // hand everything to the target in key order, so that it ends up as one sorted run in the batch
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+        for (uint32_t idx : GetSortedEntries()) {
+            const Entry& e = entries[idx];
+            ssKey.clear();
+            ssKey.write(e.key, e.keySize);
+            if (e.value) {
+                e.value->Write(ssKey, commitTarget);
+            } else {
+                commitTarget.Erase(ssKey);
+            }
         }
         Clear();
     }
 
     bool IsClean() {
-        return writes.empty() && deletes.empty();
+        return entries.empty();
     }
 
-    size_t GetMemoryUsage() const {
-        if (memoryUsage < 0) {
-            // something went wrong when we accounted/calculated used memory...
-            static volatile bool didPrint = false;
-            if (!didPrint) {
-                LogPrintf("CDBTransaction::%s -- negative memoryUsage (%d)", __func__, memoryUsage);
-                didPrint = true;
+    /**
+     * Calls cb(ssKey, &ssValue) with the serialized value for every pending write and cb(ssKey, nullptr) for
+     * every pending erase, in key order
+     */
+    template <typename Callback>
+    void ForEachPending(Callback&& cb) const {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        for (uint32_t idx : GetSortedEntries()) {
+            const Entry& e = entries[idx];
+            ssKey.clear();
+            ssKey.write(e.key, e.keySize);
+            if (e.value) {
+                ssValue.clear();
+                e.value->Serialize(ssValue);
+                cb(ssKey, &ssValue);
+            } else {
+                cb(ssKey, nullptr);
             }
-            return 0;
         }
-        return (size_t)memoryUsage;
+    }
+
+    /**
+     * Memory used by the transaction itself (arena, entries and indexes) is accounted exactly, the heap memory owned
+     * by the buffered values is accounted with their serialized size.
+     */
+    size_t GetMemoryUsage() const {
+        return arena.GetMemoryUsage() +
+               memusage::DynamicUsage(entries) +
+               memusage::DynamicUsage(table) +
+               memusage::DynamicUsage(sortedEntries) +
+               valuesMemoryUsage;
     }
 
     CDBTransactionIterator<CDBTransaction>* NewIterator() {
@@ -116,30 +116,37 @@ bool CalcCbTxMerkleRootMNList(const CBlock& block, const CBlockIndex* pindexPrev
     int64_t nTime2 = GetTimeMicros(); nTimeDMN += nTime2 - nTime1;
     LogPrint(BCLog::BENCHMARK, "            - BuildNewListFromBlock: %.2fms [%.2fs]\n", 0.001 * (nTime2 - nTime1), nTimeDMN * 0.000001);
 
-    CSimplifiedMNList sml(tmpMNList);
+    // The merkle tree is updated with the changes between the list it was last built from and the new list. This
+    // usually is the list of the previous block (or the same list when mining), so only a few entries need rehashing
+    static CDeterministicMNList mnListCached;
+    static CSimplifiedMNListMerkleTree merkleTreeCached;
+
+    auto diff = mnListCached.BuildDiff(tmpMNList);
+    std::set<uint256> toRemove;
+    std::map<uint256, uint256> toSet;
+    for (const auto& dmn : diff.addedMNs) {
+        toSet.emplace(dmn->proTxHash, CSimplifiedMNListEntry(*dmn).CalcHash());
+    }
+    for (const auto& p : diff.updatedMNs) {
+        auto dmn = tmpMNList.GetMNByInternalId(p.first);
+        toSet.emplace(dmn->proTxHash, CSimplifiedMNListEntry(*dmn).CalcHash());
+    }
+    for (const auto& internalId : diff.removedMns) {
+        toRemove.emplace(mnListCached.GetMNByInternalId(internalId)->proTxHash);
+    }
 
     int64_t nTime3 = GetTimeMicros(); nTimeSMNL += nTime3 - nTime2;
-    LogPrint(BCLog::BENCHMARK, "            - CSimplifiedMNList: %.2fms [%.2fs]\n", 0.001 * (nTime3 - nTime2), nTimeSMNL * 0.000001);
+    LogPrint(BCLog::BENCHMARK, "            - CSimplifiedMNListEntry: %.2fms [%.2fs]\n", 0.001 * (nTime3 - nTime2), nTimeSMNL * 0.000001);
 
-    static CSimplifiedMNList smlCached;
-    static uint256 merkleRootCached;
-    static bool mutatedCached{false};
-
-    if (sml.mnList == smlCached.mnList) {
-        merkleRootRet = merkleRootCached;
-        return !mutatedCached;
-    }
+    merkleTreeCached.Update(toRemove, toSet);
+    mnListCached = tmpMNList;
 
     bool mutated = false;
-    merkleRootRet = sml.CalcMerkleRoot(&mutated);
+    merkleRootRet = merkleTreeCached.GetRoot(&mutated);
 
     int64_t nTime4 = GetTimeMicros(); nTimeMerkle += nTime4 - nTime3;
     LogPrint(BCLog::BENCHMARK, "            - CalcMerkleRoot: %.2fms [%.2fs]\n", 0.001 * (nTime4 - nTime3), nTimeMerkle * 0.000001);
 
-    smlCached = std::move(sml);
-    merkleRootCached = merkleRootRet;
-    mutatedCached = mutated;
-
     return !mutated;
 }
 
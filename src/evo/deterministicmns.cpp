@@ -8,6 +8,7 @@
 #include "base58.h"
 #include "chainparams.h"
 #include "core_io.h"
+#include "crypto/sha256.h"
 #include "script/standard.h"
 #include "ui_interface.h"
 #include "validation.h"
@@ -19,6 +20,7 @@
 #include <univalue.h>
 
 static const std::string DB_LIST_SNAPSHOT = "dmn_S";
+static const std::string DB_LIST_SNAPSHOT_COMPACT = "dmn_SC";
 static const std::string DB_LIST_DIFF = "dmn_D";
 
 CDeterministicMNManager* deterministicMNManager;
@@ -249,18 +251,20 @@ std::vector<CDeterministicMNCPtr> CDeterministicMNList::CalculateQuorum(size_t m
 {
     auto scores = CalculateScores(modifier);
 
-    // sort is descending order
-    std::sort(scores.rbegin(), scores.rend(), [](const std::pair<arith_uint256, CDeterministicMNCPtr>& a, std::pair<arith_uint256, CDeterministicMNCPtr>& b) {
+    // only the top maxSize entries are needed, so don't sort the whole list
+    // order is descending by score, ties are broken the same way as the non deterministic MNs did it
+    size_t count = std::min(maxSize, scores.size());
+    std::partial_sort(scores.begin(), scores.begin() + count, scores.end(), [](const std::pair<arith_uint256, CDeterministicMNCPtr>& a, const std::pair<arith_uint256, CDeterministicMNCPtr>& b) {
         if (a.first == b.first) {
             // this should actually never happen, but we should stay compatible with how the non deterministic MNs did the sorting
-            return a.second->collateralOutpoint < b.second->collateralOutpoint;
+            return b.second->collateralOutpoint < a.second->collateralOutpoint;
         }
-        return a.first < b.first;
+        return b.first < a.first;
     });
 
     // take top maxSize entries and return it
     std::vector<CDeterministicMNCPtr> result;
-    result.resize(std::min(maxSize, scores.size()));
+    result.resize(count);
     for (size_t i = 0; i < result.size(); i++) {
         result[i] = std::move(scores[i].second);
     }
@@ -269,27 +273,38 @@ std::vector<CDeterministicMNCPtr> CDeterministicMNList::CalculateQuorum(size_t m
 
 std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> CDeterministicMNList::CalculateScores(const uint256& modifier) const
 {
-    std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> scores;
-    scores.reserve(GetAllMNsCount());
+    std::vector<CDeterministicMNCPtr> dmns;
+    dmns.reserve(GetAllMNsCount());
     ForEachMN(true, [&](const CDeterministicMNCPtr& dmn) {
         if (dmn->pdmnState->confirmedHash.IsNull()) {
             // we only take confirmed MNs into account to avoid hash grinding on the ProRegTxHash to sneak MNs into a
             // future quorums
             return;
         }
-        // calculate sha256(sha256(proTxHash, confirmedHash), modifier) per MN
-        // Please note that this is not a double-sha256 but a single-sha256
-        // The first part is already precalculated (confirmedHashWithProRegTxHash)
-        // TODO When https://github.com/bitcoin/bitcoin/pull/13191 gets backported, implement something that is similar but for single-sha256
-        uint256 h;
-        CSHA256 sha256;
-        sha256.Write(dmn->pdmnState->confirmedHashWithProRegTxHash.begin(), dmn->pdmnState->confirmedHashWithProRegTxHash.size());
-        sha256.Write(modifier.begin(), modifier.size());
-        sha256.Finalize(h.begin());
-
-        scores.emplace_back(UintToArith256(h), dmn);
+        dmns.emplace_back(dmn);
     });
 
+    // calculate sha256(sha256(proTxHash, confirmedHash), modifier) per MN
+    // Please note that this is not a double-sha256 but a single-sha256
+    // The first part is already precalculated (confirmedHashWithProRegTxHash), so every MN hashes exactly one
+    // 64 byte block, which lets us hash all of them in one batch
+    std::vector<unsigned char> blocks(dmns.size() * 64);
+    for (size_t i = 0; i < dmns.size(); i++) {
+        const uint256& h = dmns[i]->pdmnState->confirmedHashWithProRegTxHash;
+        std::copy(h.begin(), h.end(), blocks.begin() + i * 64);
+        std::copy(modifier.begin(), modifier.end(), blocks.begin() + i * 64 + 32);
+    }
+    std::vector<uint256> hashes(dmns.size());
+    if (!dmns.empty()) {
+        SHA256S64(hashes[0].begin(), blocks.data(), dmns.size());
+    }
+
+    std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> scores;
+    scores.reserve(dmns.size());
+    for (size_t i = 0; i < dmns.size(); i++) {
+        scores.emplace_back(UintToArith256(hashes[i]), std::move(dmns[i]));
+    }
+
     return scores;
 }
 
@@ -489,8 +504,88 @@ void CDeterministicMNList::RemoveMN(const uint256& proTxHash)
     mnInternalIdMap = mnInternalIdMap.erase(dmn->internalId);
 }
 
-CDeterministicMNManager::CDeterministicMNManager(CEvoDB& _evoDb) :
-    evoDb(_evoDb)
+bool CDeterministicMNListCache::IsCheckpoint(int nHeight, int nTipHeight)
+{
+    int nDistance = nTipHeight - nHeight;
+    if (nDistance <= LISTS_CACHE_SIZE) {
+        return true;
+    }
+    // the spacing doubles every time the distance to the tip doubles, up to the point where the snapshots on disk are
+    // about as close
+    int nSpacing = 2;
+    while (nSpacing * 2 <= MAX_CHECKPOINT_SPACING && nDistance > LISTS_CACHE_SIZE * nSpacing) {
+        nSpacing *= 2;
+    }
+    return (nHeight % nSpacing) == 0;
+}
+
+bool CDeterministicMNListCache::Get(const uint256& blockHash, CDeterministicMNList& mnListRet)
+{
+    auto it = lists.find(blockHash);
+    if (it == lists.end()) {
+        return false;
+    }
+    it->second.nLastAccess = nAccessCounter++;
+    mnListRet = it->second.mnList;
+    return true;
+}
+
+void CDeterministicMNListCache::Add(const CDeterministicMNList& mnList, size_t nCost)
+{
+    auto p = lists.emplace(mnList.GetBlockHash(), CachedList{mnList, nCost, nAccessCounter++});
+    if (p.second) {
+        nSize += nCost;
+    }
+}
+
+void CDeterministicMNListCache::Erase(const uint256& blockHash)
+{
+    auto it = lists.find(blockHash);
+    if (it != lists.end()) {
+        nSize -= it->second.nCost;
+        lists.erase(it);
+    }
+}
+
+void CDeterministicMNListCache::Cleanup(int nTipHeight)
+{
+    typedef decltype(lists)::iterator Iterator;
+
+    // lists which are not checkpoints anymore now that the tip moved on are removed, the remaining old lists may be
+    // evicted to stay below the memory limit
+    std::vector<Iterator> evictable;
+    for (auto it = lists.begin(); it != lists.end(); ) {
+        int nListHeight = it->second.mnList.GetHeight();
+        if (nListHeight + LISTS_CACHE_SIZE >= nTipHeight) {
+            ++it;
+        } else if (!IsCheckpoint(nListHeight, nTipHeight)) {
+            nSize -= it->second.nCost;
+            it = lists.erase(it);
+        } else {
+            evictable.emplace_back(it++);
+        }
+    }
+
+    if (nSize <= nMaxSize) {
+        return;
+    }
+
+    // evict down to 3/4 of the limit, so that this does not happen on every call while we're at the limit
+    std::sort(evictable.begin(), evictable.end(), [](const Iterator& a, const Iterator& b) {
+        return a->second.nLastAccess < b->second.nLastAccess;
+    });
+    for (const auto& it : evictable) {
+        if (nSize <= nMaxSize / 4 * 3) {
+            break;
+        }
+        nSize -= it->second.nCost;
+        lists.erase(it);
+    }
+}
+
+CDeterministicMNManager::CDeterministicMNManager(CEvoDB& _evoDb, size_t _nMaxCacheSize) :
+    evoDb(_evoDb),
+    mnListsCache(_nMaxCacheSize)
 {
 }
 
@@ -531,7 +626,7 @@ bool CDeterministicMNManager::ProcessBlock(const CBlock& block, const CBlockInde
 
         evoDb.Write(std::make_pair(DB_LIST_DIFF, newList.GetBlockHash()), diff);
         if ((nHeight % SNAPSHOT_LIST_PERIOD) == 0 || oldList.GetHeight() == -1) {
-            evoDb.Write(std::make_pair(DB_LIST_SNAPSHOT, newList.GetBlockHash()), newList);
+            evoDb.Write(std::make_pair(DB_LIST_SNAPSHOT_COMPACT, newList.GetBlockHash()), CDeterministicMNListSnapshot(newList));
             LogPrintf("CDeterministicMNManager::%s -- Wrote snapshot. nHeight=%d, mapCurMNs.allMNsCount=%d\n",
                 __func__, nHeight, newList.GetAllMNsCount());
         }
@@ -553,7 +648,7 @@ bool CDeterministicMNManager::ProcessBlock(const CBlock& block, const CBlockInde
     }
 
     LOCK(cs);
-    CleanupCache(nHeight);
+    mnListsCache.Cleanup(nHeight);
 
     return true;
 }
@@ -578,8 +673,9 @@ bool CDeterministicMNManager::UndoBlock(const CBlock& block, const CBlockIndex*
 
         evoDb.Erase(std::make_pair(DB_LIST_DIFF, blockHash));
         evoDb.Erase(std::make_pair(DB_LIST_SNAPSHOT, blockHash));
+        evoDb.Erase(std::make_pair(DB_LIST_SNAPSHOT_COMPACT, blockHash));
 
-        mnListsCache.erase(blockHash);
+        mnListsCache.Erase(blockHash);
     }
 
     if (diff.HasChanges()) {
@@ -883,26 +979,28 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
 {
     LOCK(cs);
 
+    // the tip might not be updated yet while the block at pindex is being connected
+    int nTipHeight = tipIndex ? std::max(tipIndex->nHeight, pindex->nHeight) : pindex->nHeight;
+
     CDeterministicMNList snapshot;
     std::list<std::pair<const CBlockIndex*, CDeterministicMNListDiff>> listDiff;
 
     while (true) {
         // try using cache before reading from disk
-        auto it = mnListsCache.find(pindex->GetBlockHash());
-        if (it != mnListsCache.end()) {
-            snapshot = it->second;
+        if (mnListsCache.Get(pindex->GetBlockHash(), snapshot)) {
             break;
         }
 
-        if (evoDb.Read(std::make_pair(DB_LIST_SNAPSHOT, pindex->GetBlockHash()), snapshot)) {
-            mnListsCache.emplace(pindex->GetBlockHash(), snapshot);
+        if (ReadSnapshot(pindex->GetBlockHash(), snapshot)) {
+            // this one does not share anything with the other cached lists
+            mnListsCache.Add(snapshot, CDeterministicMNListCache::LIST_CACHE_ENTRY_COST + snapshot.GetAllMNsCount() * CDeterministicMNListCache::LIST_CACHE_MN_COST);
             break;
         }
 
         CDeterministicMNListDiff diff;
-        if (!evoDb.Read(std::make_pair(DB_LIST_DIFF, pindex->GetBlockHash()), diff)) {
+        if (!evoDb.ReadImmutable(std::make_pair(DB_LIST_DIFF, pindex->GetBlockHash()), diff)) {
             snapshot = CDeterministicMNList(pindex->GetBlockHash(), -1, 0);
-            mnListsCache.emplace(pindex->GetBlockHash(), snapshot);
+            mnListsCache.Add(snapshot, CDeterministicMNListCache::LIST_CACHE_ENTRY_COST);
             break;
         }
 
@@ -910,17 +1008,29 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
         pindex = pindex->pprev;
     }
 
+    // number of MNs changed since the last list we've put into the cache
+    size_t nChanged = 0;
     for (const auto& p : listDiff) {
         auto diffIndex = p.first;
         auto& diff = p.second;
         if (diff.HasChanges()) {
             snapshot = snapshot.ApplyDiff(diffIndex, diff);
+            nChanged += diff.addedMNs.size() + diff.updatedMNs.size() + diff.removedMns.size();
         } else {
             snapshot.SetBlockHash(diffIndex->GetBlockHash());
             snapshot.SetHeight(diffIndex->nHeight);
         }
 
-        mnListsCache.emplace(diffIndex->GetBlockHash(), snapshot);
+        // don't keep every list on the way for deep lookups, the checkpoints are enough to bound the number of diffs
+        // to apply for later lookups
+        if (diffIndex == listDiff.back().first || CDeterministicMNListCache::IsCheckpoint(diffIndex->nHeight, nTipHeight)) {
+            mnListsCache.Add(snapshot, CDeterministicMNListCache::LIST_CACHE_ENTRY_COST + nChanged * CDeterministicMNListCache::LIST_CACHE_MN_COST);
+            nChanged = 0;
+        }
+    }
+
+    if (mnListsCache.IsFull()) {
+        mnListsCache.Cleanup(nTipHeight);
     }
 
     return snapshot;
@@ -968,19 +1078,16 @@ bool CDeterministicMNManager::IsDIP3Enforced(int nHeight)
     return nHeight >= Params().GetConsensus().DIP0003EnforcementHeight;
 }
 
-void CDeterministicMNManager::CleanupCache(int nHeight)
+bool CDeterministicMNManager::ReadSnapshot(const uint256& blockHash, CDeterministicMNList& snapshotRet)
 {
-    AssertLockHeld(cs);
-
-    std::vector<uint256> toDelete;
-    for (const auto& p : mnListsCache) {
-        if (p.second.GetHeight() + LISTS_CACHE_SIZE < nHeight) {
-            toDelete.emplace_back(p.first);
-        }
-    }
-    for (const auto& h : toDelete) {
-        mnListsCache.erase(h);
+    // diffs and snapshots are keyed by block hash and never change, so they can be read without blocking on validation
+    CDeterministicMNListSnapshot snapshot;
+    if (evoDb.ReadImmutable(std::make_pair(DB_LIST_SNAPSHOT_COMPACT, blockHash), snapshot)) {
+        snapshotRet = std::move(snapshot.mnList);
+        return true;
     }
+    // snapshots written by older versions are still in the old format
+    return evoDb.ReadImmutable(std::make_pair(DB_LIST_SNAPSHOT, blockHash), snapshotRet);
 }
 
 bool CDeterministicMNManager::UpgradeDiff(CDBBatch& batch, const CBlockIndex* pindexNext, const CDeterministicMNList& curMNList, CDeterministicMNList& newMNList)
@@ -1075,7 +1182,7 @@ void CDeterministicMNManager::UpgradeDBIfNeeded()
         UpgradeDiff(batch, pindex, curMNList, newMNList);
 
         if ((nHeight % SNAPSHOT_LIST_PERIOD) == 0) {
-            batch.Write(std::make_pair(DB_LIST_SNAPSHOT, pindex->GetBlockHash()), newMNList);
+            batch.Write(std::make_pair(DB_LIST_SNAPSHOT_COMPACT, pindex->GetBlockHash()), CDeterministicMNListSnapshot(newMNList));
             evoDb.GetRawDB().WriteBatch(batch);
             batch.Clear();
         }
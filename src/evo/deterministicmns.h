@@ -10,6 +10,7 @@
 #include "dbwrapper.h"
 #include "evodb.h"
 #include "providertx.h"
+#include "saltedhasher.h"
 #include "simplifiedmns.h"
 #include "sync.h"
 
@@ -17,6 +18,7 @@
 #include "immer/map_transient.hpp"
 
 #include <map>
+#include <unordered_map>
 
 class CBlock;
 class CBlockIndex;
@@ -329,6 +331,161 @@ public:
         }
     }
 
+private:
+    // flags for the MN entries in the snapshot format
+    enum SnapshotFlags : uint8_t {
+        SnapshotFlag_collateralInProTx      = 0x01, // collateralOutpoint.hash == proTxHash, only n is stored
+        SnapshotFlag_confirmedHashNull      = 0x02, // confirmedHash and confirmedHashWithProRegTxHash are not stored
+        SnapshotFlag_confirmedHashDerived   = 0x04, // confirmedHashWithProRegTxHash is not stored, but recalculated
+    };
+
+    /**
+     * Allocation pool for the MNs of an unserialized snapshot. All MNs and states are allocated in two arrays, the
+     * CDeterministicMNCPtr/CDeterministicMNStateCPtr handed out are aliasing pointers into these, which keep the
+     * whole pool alive.
+     */
+    struct SnapshotPool {
+        std::vector<CDeterministicMN> mns;
+        std::vector<CDeterministicMNState> states;
+    };
+
+public:
+    static const uint8_t SNAPSHOT_VERSION = 1;
+
+    /**
+     * Compact encoding of the list, used for snapshots in the database. Compared to Serialize, MNs are written in
+     * internalId order with delta encoded ids and integers, and fields which are implied by the proTxHash are left out
+     */
+    template<typename Stream>
+    void SerializeSnapshot(Stream& s) const
+    {
+        std::vector<CDeterministicMNCPtr> mns;
+        mns.reserve(mnMap.size());
+        for (const auto& p : mnMap) {
+            mns.emplace_back(p.second);
+        }
+        std::sort(mns.begin(), mns.end(), [](const CDeterministicMNCPtr& a, const CDeterministicMNCPtr& b) {
+            return a->internalId < b->internalId;
+        });
+
+        s << (uint8_t)SNAPSHOT_VERSION;
+        NCONST_PTR(this)->SerializationOpBase(s, CSerActionSerialize());
+        WriteCompactSize(s, mns.size());
+        uint64_t prevInternalId = 0;
+        for (const auto& dmn : mns) {
+            const auto& state = *dmn->pdmnState;
+            uint8_t flags = 0;
+            if (dmn->collateralOutpoint.hash == dmn->proTxHash) {
+                flags |= SnapshotFlag_collateralInProTx;
+            }
+            if (state.confirmedHash.IsNull() && state.confirmedHashWithProRegTxHash.IsNull()) {
+                flags |= SnapshotFlag_confirmedHashNull;
+            } else {
+                CDeterministicMNState tmp;
+                tmp.UpdateConfirmedHash(dmn->proTxHash, state.confirmedHash);
+                if (tmp.confirmedHashWithProRegTxHash == state.confirmedHashWithProRegTxHash) {
+                    flags |= SnapshotFlag_confirmedHashDerived;
+                }
+            }
+
+            WriteVarInt<Stream, uint64_t>(s, dmn->internalId - prevInternalId);
+            prevInternalId = dmn->internalId;
+            s << dmn->proTxHash;
+            s << flags;
+            if (flags & SnapshotFlag_collateralInProTx) {
+                WriteVarInt<Stream, uint32_t>(s, dmn->collateralOutpoint.n);
+            } else {
+                s << dmn->collateralOutpoint;
+            }
+            s << dmn->nOperatorReward;
+
+            // heights are >= -1
+            WriteVarInt<Stream, uint32_t>(s, (uint32_t)(state.nRegisteredHeight + 1));
+            WriteVarInt<Stream, uint32_t>(s, (uint32_t)(state.nLastPaidHeight + 1));
+            WriteVarInt<Stream, uint32_t>(s, (uint32_t)state.nPoSePenalty);
+            WriteVarInt<Stream, uint32_t>(s, (uint32_t)(state.nPoSeRevivedHeight + 1));
+            WriteVarInt<Stream, uint32_t>(s, (uint32_t)(state.nPoSeBanHeight + 1));
+            s << state.nRevocationReason;
+            if (!(flags & SnapshotFlag_confirmedHashNull)) {
+                s << state.confirmedHash;
+                if (!(flags & SnapshotFlag_confirmedHashDerived)) {
+                    s << state.confirmedHashWithProRegTxHash;
+                }
+            }
+            s << state.keyIDOwner;
+            s << state.pubKeyOperator;
+            s << state.keyIDVoting;
+            s << state.addr;
+            s << state.scriptPayout;
+            s << state.scriptOperatorPayout;
+        }
+    }
+
+    template<typename Stream>
+    void UnserializeSnapshot(Stream& s)
+    {
+        mnMap = MnMap();
+        mnUniquePropertyMap = MnUniquePropertyMap();
+        mnInternalIdMap = MnInternalIdMap();
+
+        uint8_t nVersion;
+        s >> nVersion;
+        if (nVersion != SNAPSHOT_VERSION) {
+            throw std::ios_base::failure(strprintf("unsupported snapshot version %d", nVersion));
+        }
+        SerializationOpBase(s, CSerActionUnserialize());
+
+        size_t cnt = ReadCompactSize(s);
+        auto pool = std::make_shared<SnapshotPool>();
+        pool->mns.resize(cnt);
+        pool->states.resize(cnt);
+
+        uint64_t internalId = 0;
+        for (size_t i = 0; i < cnt; i++) {
+            auto& dmn = pool->mns[i];
+            auto& state = pool->states[i];
+
+            internalId += ReadVarInt<Stream, uint64_t>(s);
+            dmn.internalId = internalId;
+            s >> dmn.proTxHash;
+            uint8_t flags;
+            s >> flags;
+            if (flags & SnapshotFlag_collateralInProTx) {
+                dmn.collateralOutpoint.hash = dmn.proTxHash;
+                dmn.collateralOutpoint.n = ReadVarInt<Stream, uint32_t>(s);
+            } else {
+                s >> dmn.collateralOutpoint;
+            }
+            s >> dmn.nOperatorReward;
+
+            state.nRegisteredHeight = (int)ReadVarInt<Stream, uint32_t>(s) - 1;
+            state.nLastPaidHeight = (int)ReadVarInt<Stream, uint32_t>(s) - 1;
+            state.nPoSePenalty = (int)ReadVarInt<Stream, uint32_t>(s);
+            state.nPoSeRevivedHeight = (int)ReadVarInt<Stream, uint32_t>(s) - 1;
+            state.nPoSeBanHeight = (int)ReadVarInt<Stream, uint32_t>(s) - 1;
+            s >> state.nRevocationReason;
+            if (!(flags & SnapshotFlag_confirmedHashNull)) {
+                uint256 confirmedHash;
+                s >> confirmedHash;
+                if (flags & SnapshotFlag_confirmedHashDerived) {
+                    state.UpdateConfirmedHash(dmn.proTxHash, confirmedHash);
+                } else {
+                    state.confirmedHash = confirmedHash;
+                    s >> state.confirmedHashWithProRegTxHash;
+                }
+            }
+            s >> state.keyIDOwner;
+            s >> state.pubKeyOperator;
+            s >> state.keyIDVoting;
+            s >> state.addr;
+            s >> state.scriptPayout;
+            s >> state.scriptOperatorPayout;
+
+            dmn.pdmnState = CDeterministicMNStateCPtr(pool, &state);
+            AddMN(CDeterministicMNCPtr(pool, &dmn));
+        }
+    }
+
 public:
     size_t GetAllMNsCount() const
     {
@@ -532,6 +689,31 @@ private:
     }
 };
 
+/**
+ * A list snapshot as stored in the database, uses the format of CDeterministicMNList::SerializeSnapshot
+ */
+class CDeterministicMNListSnapshot
+{
+public:
+    CDeterministicMNList mnList;
+
+public:
+    CDeterministicMNListSnapshot() {}
+    explicit CDeterministicMNListSnapshot(const CDeterministicMNList& _mnList) : mnList(_mnList) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        mnList.SerializeSnapshot(s);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        mnList.UnserializeSnapshot(s);
+    }
+};
+
 class CDeterministicMNListDiff
 {
 public:
@@ -617,10 +799,61 @@ public:
     }
 };
 
+// default for -mnlistcache, in megabytes
+static const unsigned int DEFAULT_MNLIST_CACHE_SIZE = 32;
+
+/**
+ * In memory cache of MN lists, keyed by block hash. Lists of the last LISTS_CACHE_SIZE blocks are always kept. Older
+ * lists are thinned out to checkpoints which get sparser the farther away they are from the tip, and the least
+ * recently used ones are evicted when the estimated size of the cache grows above nMaxSize.
+ * Not thread safe, CDeterministicMNManager guards it with its cs.
+ */
+class CDeterministicMNListCache
+{
+public:
+    static const int LISTS_CACHE_SIZE = 576;
+    // older checkpoints get no sparser than this, which is how often snapshots are written to disk
+    static const int MAX_CHECKPOINT_SPACING = 576;
+
+    // Rough memory estimation for cached lists. Lists share all unchanged entries with the lists they were built
+    // from, so a list built from a diff is only charged for the entries changed by the diff
+    static const size_t LIST_CACHE_ENTRY_COST = 256;
+    static const size_t LIST_CACHE_MN_COST = 512;
+
+private:
+    struct CachedList {
+        CDeterministicMNList mnList;
+        size_t nCost;
+        int64_t nLastAccess;
+    };
+
+    std::unordered_map<uint256, CachedList, StaticSaltedHasher> lists;
+    size_t nSize{0};
+    size_t nMaxSize;
+    int64_t nAccessCounter{0};
+
+public:
+    explicit CDeterministicMNListCache(size_t _nMaxSize) : nMaxSize(_nMaxSize) {}
+
+    static bool IsCheckpoint(int nHeight, int nTipHeight);
+
+    bool Get(const uint256& blockHash, CDeterministicMNList& mnListRet);
+    // does nothing if the list is already cached
+    void Add(const CDeterministicMNList& mnList, size_t nCost);
+    void Erase(const uint256& blockHash);
+    // Removes lists which are not checkpoints anymore for a tip at nTipHeight. If the cache is still above its maximum
+    // size afterwards, the least recently used lists below the last LISTS_CACHE_SIZE blocks are evicted
+    void Cleanup(int nTipHeight);
+
+    bool IsFull() const { return nSize > nMaxSize; }
+    size_t GetCount() const { return lists.size(); }
+    size_t GetSize() const { return nSize; }
+};
+
 class CDeterministicMNManager
 {
     static const int SNAPSHOT_LIST_PERIOD = 576; // once per day
-    static const int LISTS_CACHE_SIZE = 576;
+    static_assert(CDeterministicMNListCache::MAX_CHECKPOINT_SPACING == SNAPSHOT_LIST_PERIOD, "cache checkpoints should not be sparser than snapshots");
 
 public:
     CCriticalSection cs;
@@ -628,11 +861,11 @@ public:
 private:
     CEvoDB& evoDb;
 
-    std::map<uint256, CDeterministicMNList> mnListsCache;
+    CDeterministicMNListCache mnListsCache;
     const CBlockIndex* tipIndex{nullptr};
 
 public:
-    CDeterministicMNManager(CEvoDB& _evoDb);
+    CDeterministicMNManager(CEvoDB& _evoDb, size_t _nMaxCacheSize = (size_t)DEFAULT_MNLIST_CACHE_SIZE << 20);
 
     bool ProcessBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, bool fJustCheck);
     bool UndoBlock(const CBlock& block, const CBlockIndex* pindex);
@@ -658,7 +891,7 @@ public:
     void UpgradeDBIfNeeded();
 
 private:
-    void CleanupCache(int nHeight);
+    bool ReadSnapshot(const uint256& blockHash, CDeterministicMNList& snapshotRet);
 };
 
 extern CDeterministicMNManager* deterministicMNManager;
@@ -37,12 +37,29 @@ CEvoDB::CEvoDB(size_t nCacheSize, bool fMemory, bool fWipe) :
     rootDBTransaction(db, rootBatch),
     curDBTransaction(rootDBTransaction, rootDBTransaction)
 {
+    committedSnapshot = std::make_shared<CEvoDBSnapshot>(std::make_shared<CEvoDBSnapshot::DBSnapshot>(db));
 }
 
 void CEvoDB::CommitCurTransaction()
 {
     LOCK(cs);
-    curDBTransaction.Commit();
+
+    // publish the changes of this transaction and hand the same serialized values to the root transaction, so that
+    // every value is only serialized once
+    auto newSnapshot = std::make_shared<CEvoDBSnapshot>(*committedSnapshot);
+    curDBTransaction.ForEachPending([&](const CDataStream& ssKey, const CDataStream* pssValue) {
+        std::shared_ptr<const std::string> value;
+        if (pssValue) {
+            value = std::make_shared<const std::string>(pssValue->begin(), pssValue->end());
+            rootDBTransaction.Write(ssKey, RootTransaction::SerializedValue{value});
+        } else {
+            rootDBTransaction.Erase(ssKey);
+        }
+        newSnapshot->overlay = newSnapshot->overlay.set(std::string(ssKey.begin(), ssKey.end()), std::move(value));
+    });
+    std::atomic_store(&committedSnapshot, CEvoDBSnapshotPtr(std::move(newSnapshot)));
+
+    curDBTransaction.Clear();
 }
 
 void CEvoDB::RollbackCurTransaction()
@@ -53,10 +70,14 @@ void CEvoDB::RollbackCurTransaction()
 
 bool CEvoDB::CommitRootTransaction()
 {
+    LOCK(cs);
     assert(curDBTransaction.IsClean());
     rootDBTransaction.Commit();
     bool ret = db.WriteBatch(rootBatch);
     rootBatch.Clear();
+
+    // everything is in the DB now, start over with an empty overlay
+    std::atomic_store(&committedSnapshot, CEvoDBSnapshotPtr(std::make_shared<CEvoDBSnapshot>(std::make_shared<CEvoDBSnapshot::DBSnapshot>(db))));
     return ret;
 }
 
@@ -9,6 +9,10 @@
 #include "sync.h"
 #include "uint256.h"
 
+#include "immer/map.hpp"
+
+#include <memory>
+
 // "b_b" was used in the initial version of deterministic MN storage
 // "b_b2" was used after compact diffs were introduced
 static const std::string EVODB_BEST_BLOCK = "b_b2";
@@ -29,6 +33,80 @@ public:
     void Rollback();
 };
 
+/**
+ * Immutable view of the committed state of the evo DB, i.e. of all blocks that were connected/disconnected so far.
+ * It consists of a LevelDB snapshot of the flushed state and an overlay with the serialized writes/erases of all
+ * blocks committed since the last flush. A new one is published after every commit, so readers can keep using the
+ * one they got without ever taking CEvoDB::cs.
+ *
+ * Costs: the overlay only holds serialized values, so every read of a key committed since the last flush deserializes
+ * it again. The LevelDB snapshot is pinned from one flush (CEvoDB::CommitRootTransaction) to the next and for as long
+ * as a reader keeps an older CEvoDBSnapshot alive, which keeps LevelDB from compacting away overwritten entries in
+ * the meantime.
+ */
+class CEvoDBSnapshot
+{
+    friend class CEvoDB;
+
+private:
+    struct DBSnapshot {
+        const CDBWrapper& db;
+        const leveldb::Snapshot* snapshot;
+        DBSnapshot(const CDBWrapper& _db) : db(_db), snapshot(_db.GetSnapshot()) {}
+        ~DBSnapshot() { db.ReleaseSnapshot(snapshot); }
+    };
+
+    // serialized key -> serialized value, erased keys map to nullptr
+    typedef immer::map<std::string, std::shared_ptr<const std::string>> Overlay;
+
+    std::shared_ptr<const DBSnapshot> dbSnapshot;
+    Overlay overlay;
+
+public:
+    explicit CEvoDBSnapshot(std::shared_ptr<const DBSnapshot> _dbSnapshot) : dbSnapshot(std::move(_dbSnapshot)) {}
+
+    template <typename K, typename V>
+    bool Read(const K& key, V& value) const
+    {
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        if (!ReadDataStream(key, ssValue)) {
+            return false;
+        }
+        try {
+            ssValue >> value;
+        } catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+
+    template <typename K>
+    bool Exists(const K& key) const
+    {
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        return ReadDataStream(key, ssValue);
+    }
+
+private:
+    template <typename K>
+    bool ReadDataStream(const K& key, CDataStream& ssValue) const
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+        ssKey << key;
+
+        if (auto p = overlay.find(std::string(ssKey.begin(), ssKey.end()))) {
+            if (!*p) {
+                return false;
+            }
+            ssValue.write((*p)->data(), (*p)->size());
+            return true;
+        }
+        return dbSnapshot->db.ReadDataStream(ssKey, ssValue, dbSnapshot->snapshot);
+    }
+};
+typedef std::shared_ptr<const CEvoDBSnapshot> CEvoDBSnapshotPtr;
+
 class CEvoDB
 {
 private:
@@ -42,6 +120,9 @@ private:
     RootTransaction rootDBTransaction;
     CurTransaction curDBTransaction;
 
+    // only replaced while holding cs, but loaded without it via std::atomic_load
+    CEvoDBSnapshotPtr committedSnapshot;
+
 public:
     CEvoDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
@@ -77,6 +158,30 @@ public:
         return curDBTransaction.Exists(key);
     }
 
+    /**
+     * Returns the current committed state. This never blocks on validation, but does not include the writes of the
+     * block that is being connected/disconnected right now.
+     */
+    CEvoDBSnapshotPtr GetSnapshot() const
+    {
+        return std::atomic_load(&committedSnapshot);
+    }
+
+    /**
+     * Reads from the committed state first and only falls back to the current transaction (and thus cs) if the key
+     * is not found there, e.g. because the current block just wrote it or because it was written to the raw DB.
+     * Only use this for keys whose values never change once written, e.g. data keyed by a block hash. Values which
+     * are not flushed yet are deserialized on every call, see CEvoDBSnapshot.
+     */
+    template <typename K, typename V>
+    bool ReadImmutable(const K& key, V& value)
+    {
+        if (GetSnapshot()->Read(key, value)) {
+            return true;
+        }
+        return Read(key, value);
+    }
+
     template <typename K>
     void Erase(const K& key)
     {
@@ -91,6 +196,7 @@ public:
 
     size_t GetMemoryUsage()
     {
+        // the values in the overlay of the committed snapshot are shared with the root transaction
         return rootDBTransaction.GetMemoryUsage();
     }
 
@@ -14,7 +14,12 @@
 #include "base58.h"
 #include "chainparams.h"
 #include "consensus/merkle.h"
+#include "crypto/sha256.h"
+#include "saltedhasher.h"
+#include "streams.h"
+#include "sync.h"
 #include "univalue.h"
+#include "unordered_lru_cache.h"
 #include "validation.h"
 
 CSimplifiedMNListEntry::CSimplifiedMNListEntry(const CDeterministicMN& dmn) :
@@ -88,6 +93,113 @@ uint256 CSimplifiedMNList::CalcMerkleRoot(bool* pmutated) const
     return ComputeMerkleRoot(leaves, pmutated);
 }
 
+CSimplifiedMNListMerkleTree::CSimplifiedMNListMerkleTree()
+{
+    Clear();
+}
+
+void CSimplifiedMNListMerkleTree::Update(const std::set<uint256>& toRemove, const std::map<uint256, uint256>& toSet)
+{
+    std::vector<uint256> newProRegTxHashes;
+    std::vector<std::vector<uint256>> newLevels(1);
+    auto& newLeaves = newLevels[0];
+    newProRegTxHashes.reserve(proRegTxHashes.size() + toSet.size());
+    newLeaves.reserve(proRegTxHashes.size() + toSet.size());
+
+    // merge the sorted changes into the sorted entries
+    auto it = toSet.begin();
+    for (size_t i = 0; i < proRegTxHashes.size(); i++) {
+        const auto& proRegTxHash = proRegTxHashes[i];
+        for (; it != toSet.end() && it->first < proRegTxHash; ++it) {
+            newProRegTxHashes.emplace_back(it->first);
+            newLeaves.emplace_back(it->second);
+        }
+        if (it != toSet.end() && it->first == proRegTxHash) {
+            newProRegTxHashes.emplace_back(it->first);
+            newLeaves.emplace_back(it->second);
+            ++it;
+        } else if (!toRemove.count(proRegTxHash)) {
+            newProRegTxHashes.emplace_back(proRegTxHash);
+            newLeaves.emplace_back(levels[0][i]);
+        }
+    }
+    for (; it != toSet.end(); ++it) {
+        newProRegTxHashes.emplace_back(it->first);
+        newLeaves.emplace_back(it->second);
+    }
+
+    // Build the new levels bottom up. A node only needs to be hashed again if one of its children differs from the
+    // child at the same position in the old tree, so if nothing was added or removed, only the paths from the changed
+    // entries to the root are recalculated. Otherwise everything right of the first added/removed entry is.
+    std::vector<unsigned char> buf;
+    std::vector<size_t> toHash;
+    while (newLevels.back().size() > 1) {
+        size_t l = newLevels.size() - 1;
+        const auto& cur = newLevels[l];
+        const auto* oldCur = l + 1 < levels.size() ? &levels[l] : nullptr;
+        const auto* oldNext = l + 1 < levels.size() ? &levels[l + 1] : nullptr;
+
+        std::vector<uint256> next((cur.size() + 1) / 2);
+        toHash.clear();
+        for (size_t p = 0; p < next.size(); p++) {
+            // the last entry is paired with itself if the level has an odd size
+            size_t a = p * 2;
+            size_t b = std::min(a + 1, cur.size() - 1);
+            if (oldCur && p < oldNext->size() && b == std::min(a + 1, oldCur->size() - 1) &&
+                (*oldCur)[a] == cur[a] && (*oldCur)[b] == cur[b]) {
+                next[p] = (*oldNext)[p];
+            } else {
+                toHash.emplace_back(p);
+            }
+        }
+
+        buf.resize(toHash.size() * 64);
+        for (size_t i = 0; i < toHash.size(); i++) {
+            size_t a = toHash[i] * 2;
+            size_t b = std::min(a + 1, cur.size() - 1);
+            memcpy(&buf[i * 64], cur[a].begin(), 32);
+            memcpy(&buf[i * 64 + 32], cur[b].begin(), 32);
+        }
+        // hash in place, the first 32 * toHash.size() bytes hold the results afterwards
+        SHA256D64(buf.data(), buf.data(), toHash.size());
+        for (size_t i = 0; i < toHash.size(); i++) {
+            memcpy(next[toHash[i]].begin(), &buf[i * 32], 32);
+        }
+
+        newLevels.emplace_back(std::move(next));
+    }
+
+    proRegTxHashes = std::move(newProRegTxHashes);
+    levels = std::move(newLevels);
+}
+
+void CSimplifiedMNListMerkleTree::Clear()
+{
+    proRegTxHashes.clear();
+    levels.assign(1, std::vector<uint256>());
+}
+
+uint256 CSimplifiedMNListMerkleTree::GetRoot(bool* pmutated) const
+{
+    if (pmutated) {
+        // same check as in ComputeMerkleRoot
+        bool mutation = false;
+        for (size_t l = 0; l + 1 < levels.size() && !mutation; l++) {
+            for (size_t pos = 0; pos + 1 < levels[l].size(); pos += 2) {
+                if (levels[l][pos] == levels[l][pos + 1]) {
+                    mutation = true;
+                    break;
+                }
+            }
+        }
+        *pmutated = mutation;
+    }
+    if (levels.back().empty()) {
+        return uint256();
+    }
+    return levels.back()[0];
+}
+
 CSimplifiedMNListDiff::CSimplifiedMNListDiff()
 {
 }
@@ -185,10 +297,9 @@ void CSimplifiedMNListDiff::ToJson(UniValue& obj) const
     }
 }
 
-bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& blockHash, CSimplifiedMNListDiff& mnListDiffRet, std::string& errorRet)
+static bool GetSimplifiedMNListDiffBlocks(const uint256& baseBlockHash, const uint256& blockHash, const CBlockIndex*& baseBlockIndexRet, const CBlockIndex*& blockIndexRet, std::string& errorRet)
 {
     AssertLockHeld(cs_main);
-    mnListDiffRet = CSimplifiedMNListDiff();
 
     const CBlockIndex* baseBlockIndex = chainActive.Genesis();
     if (!baseBlockHash.IsNull()) {
@@ -215,6 +326,22 @@ bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& bloc
         return false;
     }
 
+    baseBlockIndexRet = baseBlockIndex;
+    blockIndexRet = blockIndex;
+    return true;
+}
+
+bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& blockHash, CSimplifiedMNListDiff& mnListDiffRet, std::string& errorRet)
+{
+    AssertLockHeld(cs_main);
+    mnListDiffRet = CSimplifiedMNListDiff();
+
+    const CBlockIndex* baseBlockIndex;
+    const CBlockIndex* blockIndex;
+    if (!GetSimplifiedMNListDiffBlocks(baseBlockHash, blockHash, baseBlockIndex, blockIndex, errorRet)) {
+        return false;
+    }
+
     LOCK(deterministicMNManager->cs);
 
     auto baseDmnList = deterministicMNManager->GetListForBlock(baseBlockIndex);
@@ -250,3 +377,43 @@ bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& bloc
 
     return true;
 }
+
+bool BuildSimplifiedMNListDiffSerialized(const uint256& baseBlockHash, const uint256& blockHash, int nVersion, std::vector<unsigned char>& dataRet, std::string& errorRet)
+{
+    AssertLockHeld(cs_main);
+
+    // Light clients usually all ask for the same diffs right after a new block arrived. A diff only depends on the
+    // two blocks, so the result can be reused as long as both blocks are still in the active chain
+    typedef std::shared_ptr<const std::vector<unsigned char>> DataPtr;
+    static CCriticalSection cs;
+    static unordered_lru_cache<uint256, DataPtr, StaticSaltedHasher, 64> cache;
+
+    const CBlockIndex* baseBlockIndex;
+    const CBlockIndex* blockIndex;
+    if (!GetSimplifiedMNListDiffBlocks(baseBlockHash, blockHash, baseBlockIndex, blockIndex, errorRet)) {
+        return false;
+    }
+
+    // the serialized diff only differs between versions below and above LLMQS_PROTO_VERSION
+    uint256 cacheKey = ::SerializeHash(std::make_tuple(baseBlockHash, blockHash, nVersion >= LLMQS_PROTO_VERSION));
+
+    DataPtr data;
+    {
+        LOCK(cs);
+        if (cache.get(cacheKey, data)) {
+            dataRet = *data;
+            return true;
+        }
+    }
+
+    CSimplifiedMNListDiff mnListDiff;
+    if (!BuildSimplifiedMNListDiff(baseBlockHash, blockHash, mnListDiff, errorRet)) {
+        return false;
+    }
+    dataRet.clear();
+    CVectorWriter(SER_NETWORK, nVersion, dataRet, 0, mnListDiff);
+
+    LOCK(cs);
+    cache.insert(cacheKey, std::make_shared<const std::vector<unsigned char>>(dataRet));
+    return true;
+}
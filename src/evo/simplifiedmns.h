@@ -12,6 +12,9 @@
 #include "serialize.h"
 #include "version.h"
 
+#include <map>
+#include <set>
+
 class UniValue;
 class CDeterministicMNList;
 class CDeterministicMN;
@@ -84,6 +87,30 @@ public:
     uint256 CalcMerkleRoot(bool* pmutated = nullptr) const;
 };
 
+/**
+ * Merkle tree over the entry hashes of a simplified MN list, which can be updated with the changes between two lists.
+ * Only the changed entries have to be hashed by the caller and only the parts of the tree which are affected by these
+ * changes are recalculated. The root is the same as the one of CSimplifiedMNList::CalcMerkleRoot.
+ */
+class CSimplifiedMNListMerkleTree
+{
+private:
+    // sorted, same order as the leaves
+    std::vector<uint256> proRegTxHashes;
+    // levels[0] are the entry hashes, the last level holds the root
+    std::vector<std::vector<uint256>> levels;
+
+public:
+    CSimplifiedMNListMerkleTree();
+
+    // removes the entries in toRemove and adds or replaces the entry hashes in toSet (both keyed by proRegTxHash)
+    void Update(const std::set<uint256>& toRemove, const std::map<uint256, uint256>& toSet);
+    void Clear();
+
+    size_t Size() const { return proRegTxHashes.size(); }
+    uint256 GetRoot(bool* pmutated = nullptr) const;
+};
+
 /// P2P messages
 
 class CGetSimplifiedMNListDiff
@@ -146,5 +173,7 @@ public:
 };
 
 bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& blockHash, CSimplifiedMNListDiff& mnListDiffRet, std::string& errorRet);
+// same as BuildSimplifiedMNListDiff, but returns the diff serialized for nVersion and caches the result for later requests
+bool BuildSimplifiedMNListDiffSerialized(const uint256& baseBlockHash, const uint256& blockHash, int nVersion, std::vector<unsigned char>& dataRet, std::string& errorRet);
 
 #endif //genix_SIMPLIFIEDMNS_H
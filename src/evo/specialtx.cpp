@@ -12,12 +12,125 @@
 
 #include "cbtx.h"
 #include "deterministicmns.h"
+#include "providertx.h"
 #include "specialtx.h"
 
 #include "llmq/quorums_commitment.h"
 #include "llmq/quorums_blockprocessor.h"
+#include "llmq/quorums_utils.h"
 
-bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state)
+bool CSpecialTxSigCheck::operator()()
+{
+    if (!sig.IsValid()) {
+        return false;
+    }
+    try {
+        if (fAggregated) {
+            return sig.VerifySecureAggregated(pubKeys, hash);
+        }
+        return sig.VerifyInsecure(pubKeys[0], hash);
+    } catch (...) {
+        return false;
+    }
+}
+
+void CSpecialTxSigCheck::swap(CSpecialTxSigCheck& check)
+{
+    std::swap(sig, check.sig);
+    pubKeys.swap(check.pubKeys);
+    std::swap(hash, check.hash);
+    std::swap(fAggregated, check.fAggregated);
+}
+
+template <typename ProTx>
+static bool GetOperatorSigCheck(const CTransaction& tx, const CDeterministicMNList& mnList, std::vector<CSpecialTxSigCheck>& vChecks)
+{
+    ProTx ptx;
+    if (!GetTxPayload(tx, ptx)) {
+        return false;
+    }
+    auto dmn = mnList.GetMN(ptx.proTxHash);
+    if (!dmn) {
+        return false;
+    }
+    vChecks.emplace_back(ptx.sig, dmn->pdmnState->pubKeyOperator.Get(), ::SerializeHash(ptx));
+    return true;
+}
+
+static bool GetCommitmentSigChecks(const CTransaction& tx, std::vector<CSpecialTxSigCheck>& vChecks)
+{
+    AssertLockHeld(cs_main);
+
+    llmq::CFinalCommitmentTxPayload qcTx;
+    if (!GetTxPayload(tx, qcTx)) {
+        return false;
+    }
+    const auto& qc = qcTx.commitment;
+    if (qc.IsNull()) {
+        // nothing to verify
+        return true;
+    }
+
+    const auto& llmqs = Params().GetConsensus().llmqs;
+    auto paramsIt = llmqs.find((Consensus::LLMQType)qc.llmqType);
+    auto quorumIt = mapBlockIndex.find(qc.quorumHash);
+    if (paramsIt == llmqs.end() || quorumIt == mapBlockIndex.end() || !qc.VerifySizes(paramsIt->second)) {
+        return false;
+    }
+    const auto& params = paramsIt->second;
+
+    auto members = llmq::CLLMQUtils::GetQuorumMembers(params.type, quorumIt->second);
+    std::vector<CBLSPublicKey> memberPubKeys;
+    for (size_t i = 0; i < members->members.size() && i < qc.signers.size(); i++) {
+        if (qc.signers[i]) {
+            memberPubKeys.emplace_back(members->members[i]->pdmnState->pubKeyOperator.Get());
+        }
+    }
+    if (memberPubKeys.empty()) {
+        return false;
+    }
+
+    uint256 commitmentHash = llmq::CLLMQUtils::BuildCommitmentHash(params.type, qc.quorumHash, qc.validMembers, qc.quorumPublicKey, qc.quorumVvecHash);
+    vChecks.emplace_back(qc.membersSig, std::move(memberPubKeys), commitmentHash);
+    vChecks.emplace_back(qc.quorumSig, qc.quorumPublicKey, commitmentHash);
+    return true;
+}
+
+void GetSpecialTxSigChecks(const CBlock& block, const CBlockIndex* pindexPrev, std::vector<CSpecialTxSigCheck>& vChecksRet, std::vector<bool>& vSigsCheckedRet)
+{
+    vSigsCheckedRet.assign(block.vtx.size(), false);
+    if (!pindexPrev || pindexPrev->nHeight + 1 < Params().GetConsensus().DIP0003Height) {
+        return;
+    }
+
+    // only pull the MN list when there is something to check in this block
+    std::unique_ptr<CDeterministicMNList> mnList;
+
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        if (tx.nVersion != 3) {
+            continue;
+        }
+        switch (tx.nType) {
+        case TRANSACTION_PROVIDER_UPDATE_SERVICE:
+        case TRANSACTION_PROVIDER_UPDATE_REVOKE:
+            if (!mnList) {
+                mnList.reset(new CDeterministicMNList(deterministicMNManager->GetListForBlock(pindexPrev)));
+            }
+            if (tx.nType == TRANSACTION_PROVIDER_UPDATE_SERVICE) {
+                vSigsCheckedRet[i] = GetOperatorSigCheck<CProUpServTx>(tx, *mnList, vChecksRet);
+            } else {
+                vSigsCheckedRet[i] = GetOperatorSigCheck<CProUpRevTx>(tx, *mnList, vChecksRet);
+            }
+            break;
+        case TRANSACTION_QUORUM_COMMITMENT:
+            vSigsCheckedRet[i] = GetCommitmentSigChecks(tx, vChecksRet);
+            break;
+        }
+    }
+}
+
+bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, bool fCheckSigs)
 {
     if (tx.nVersion != 3 || tx.nType == TRANSACTION_NORMAL)
         return true;
@@ -30,11 +143,11 @@ bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVali
     case TRANSACTION_PROVIDER_REGISTER:
         return CheckProRegTx(tx, pindexPrev, state);
     case TRANSACTION_PROVIDER_UPDATE_SERVICE:
-        return CheckProUpServTx(tx, pindexPrev, state);
+        return CheckProUpServTx(tx, pindexPrev, state, fCheckSigs);
     case TRANSACTION_PROVIDER_UPDATE_REGISTRAR:
         return CheckProUpRegTx(tx, pindexPrev, state);
     case TRANSACTION_PROVIDER_UPDATE_REVOKE:
-        return CheckProUpRevTx(tx, pindexPrev, state);
+        return CheckProUpRevTx(tx, pindexPrev, state, fCheckSigs);
     case TRANSACTION_COINBASE:
         return CheckCbTx(tx, pindexPrev, state);
     case TRANSACTION_QUORUM_COMMITMENT:
@@ -86,7 +199,7 @@ bool UndoSpecialTx(const CTransaction& tx, const CBlockIndex* pindex)
     return false;
 }
 
-bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, bool fJustCheck, bool fCheckCbTxMerleRoots)
+bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, bool fJustCheck, bool fCheckCbTxMerleRoots, const std::vector<bool>* pvSigsChecked)
 {
     static int64_t nTimeLoop = 0;
     static int64_t nTimeQuorum = 0;
@@ -95,9 +208,14 @@ bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CV
 
     int64_t nTime1 = GetTimeMicros();
 
+    bool fCheckQcSigs = false;
     for (int i = 0; i < (int)block.vtx.size(); i++) {
         const CTransaction& tx = *block.vtx[i];
-        if (!CheckSpecialTx(tx, pindex->pprev, state)) {
+        bool fCheckSigs = !pvSigsChecked || !(*pvSigsChecked)[i];
+        if (tx.nVersion == 3 && tx.nType == TRANSACTION_QUORUM_COMMITMENT) {
+            fCheckQcSigs |= fCheckSigs;
+        }
+        if (!CheckSpecialTx(tx, pindex->pprev, state, fCheckSigs)) {
             return false;
         }
         if (!ProcessSpecialTx(tx, pindex, state)) {
@@ -108,7 +226,7 @@ bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CV
     int64_t nTime2 = GetTimeMicros(); nTimeLoop += nTime2 - nTime1;
     LogPrint(BCLog::BENCHMARK, "        - Loop: %.2fms [%.2fs]\n", 0.001 * (nTime2 - nTime1), nTimeLoop * 0.000001);
 
-    if (!llmq::quorumBlockProcessor->ProcessBlock(block, pindex, state)) {
+    if (!llmq::quorumBlockProcessor->ProcessBlock(block, pindex, state, fCheckQcSigs)) {
         return false;
     }
 
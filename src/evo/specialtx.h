@@ -5,6 +5,7 @@
 #ifndef genix_SPECIALTX_H
 #define genix_SPECIALTX_H
 
+#include "bls/bls.h"
 #include "primitives/transaction.h"
 #include "streams.h"
 #include "version.h"
@@ -13,8 +14,41 @@ class CBlock;
 class CBlockIndex;
 class CValidationState;
 
-bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state);
-bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, bool fJustCheck, bool fCheckCbTxMerleRoots);
+/**
+ * Verifies a single BLS signature found in a special transaction, either the operator signature of a
+ * ProUpServTx/ProUpRevTx or the members/quorum signature of a final commitment. All inputs are resolved
+ * against the state at pindexPrev up front, so that the checks can run on the check queue threads while
+ * ConnectBlock is still busy with the scripts.
+ */
+class CSpecialTxSigCheck
+{
+private:
+    CBLSSignature sig;
+    std::vector<CBLSPublicKey> pubKeys;
+    uint256 hash;
+    bool fAggregated;
+
+public:
+    CSpecialTxSigCheck() : fAggregated(false) {}
+    CSpecialTxSigCheck(const CBLSSignature& _sig, const CBLSPublicKey& _pubKey, const uint256& _hash) :
+        sig(_sig), pubKeys(1, _pubKey), hash(_hash), fAggregated(false) {}
+    CSpecialTxSigCheck(const CBLSSignature& _sig, std::vector<CBLSPublicKey>&& _pubKeys, const uint256& _hash) :
+        sig(_sig), pubKeys(std::move(_pubKeys)), hash(_hash), fAggregated(true) {}
+
+    bool operator()();
+    void swap(CSpecialTxSigCheck& check);
+};
+
+/**
+ * Collects the BLS signature checks of all special txs in the block. vSigsCheckedRet[i] is set when every
+ * signature of block.vtx[i] is covered by the returned checks. Txs which are malformed or reference
+ * unknown MNs/quorums are left to the serial checks in ProcessSpecialTxsInBlock, which reject them.
+ */
+void GetSpecialTxSigChecks(const CBlock& block, const CBlockIndex* pindexPrev, std::vector<CSpecialTxSigCheck>& vChecksRet, std::vector<bool>& vSigsCheckedRet);
+
+bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, bool fCheckSigs = true);
+/** pvSigsChecked optionally marks the txs whose signatures were already verified via GetSpecialTxSigChecks */
+bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, bool fJustCheck, bool fCheckCbTxMerleRoots, const std::vector<bool>* pvSigsChecked = nullptr);
 bool UndoSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex);
 
 template <typename T>
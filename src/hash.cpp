@@ -2,11 +2,38 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#if defined(HAVE_CONFIG_H)
+#include "config/genix-config.h"
+#endif
+
 #include "hash.h"
 #include "crypto/common.h"
 #include "crypto/hmac_sha512.h"
 #include "pubkey.h"
 
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+#if defined(ENABLE_AESNI) && !defined(BUILD_BITCOIN_INTERNAL)
+namespace echo512_aesni
+{
+void Init(void* cc);
+void Update(void* cc, const void* data, size_t len);
+void Close(void* cc, void* dst);
+}
+namespace shavite512_aesni
+{
+void Init(void* cc);
+void Update(void* cc, const void* data, size_t len);
+void Close(void* cc, void* dst);
+}
+#endif
+
 
 inline uint32_t ROTL32(uint32_t x, int8_t r)
 {
@@ -246,3 +273,221 @@ uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint3
     SIPROUND;
     return v0 ^ v1 ^ v2 ^ v3;
 }
+
+namespace {
+
+/** The sph kernels used by X16R, indexed by the nibble selecting them */
+struct X16RAlgo
+{
+    void (*init)(void* cc);
+    void (*update)(void* cc, const void* data, size_t len);
+    void (*close)(void* cc, void* dst);
+};
+
+const char* const x16rAlgoNames[16] = {
+    "blake", "bmw", "groestl", "jh", "keccak", "skein", "luffa", "cubehash",
+    "shavite", "simd", "echo", "hamsi", "fugue", "shabal", "whirlpool", "sha512",
+};
+
+/** The implementations in use, X16RAutoDetect may replace some of them with accelerated ones */
+X16RAlgo x16rAlgos[16] = {
+    {sph_blake512_init, sph_blake512, sph_blake512_close},          //0
+    {sph_bmw512_init, sph_bmw512, sph_bmw512_close},                //1
+    {sph_groestl512_init, sph_groestl512, sph_groestl512_close},    //2
+    {sph_jh512_init, sph_jh512, sph_jh512_close},                   //3
+    {sph_keccak512_init, sph_keccak512, sph_keccak512_close},       //4
+    {sph_skein512_init, sph_skein512, sph_skein512_close},          //5
+    {sph_luffa512_init, sph_luffa512, sph_luffa512_close},          //6
+    {sph_cubehash512_init, sph_cubehash512, sph_cubehash512_close}, //7
+    {sph_shavite512_init, sph_shavite512, sph_shavite512_close},    //8
+    {sph_simd512_init, sph_simd512, sph_simd512_close},             //9
+    {sph_echo512_init, sph_echo512, sph_echo512_close},             //A
+    {sph_hamsi512_init, sph_hamsi512, sph_hamsi512_close},          //B
+    {sph_fugue512_init, sph_fugue512, sph_fugue512_close},          //C
+    {sph_shabal512_init, sph_shabal512, sph_shabal512_close},       //D
+    {sph_whirlpool_init, sph_whirlpool, sph_whirlpool_close},       //E
+    {sph_sha512_init, sph_sha512, sph_sha512_close},                //F
+};
+
+/** Large enough for the context of any of the X16R algorithms */
+union X16RContext
+{
+    sph_blake512_context     blake;
+    sph_bmw512_context       bmw;
+    sph_groestl512_context   groestl;
+    sph_jh512_context        jh;
+    sph_keccak512_context    keccak;
+    sph_skein512_context     skein;
+    sph_luffa512_context     luffa;
+    sph_cubehash512_context  cubehash;
+    sph_shavite512_context   shavite;
+    sph_simd512_context      simd;
+    sph_echo512_context      echo;
+    sph_hamsi512_context     hamsi;
+    sph_fugue512_context     fugue;
+    sph_shabal512_context    shabal;
+    sph_whirlpool_context    whirlpool;
+    sph_sha512_context       sha512;
+};
+
+#if defined(ENABLE_X16R_STATS) && !defined(BUILD_BITCOIN_INTERNAL)
+inline uint64_t X16RTicks()
+{
+#if !defined(_MSC_VER) && (defined(__x86_64__) || defined(__amd64__))
+    uint64_t r1 = 0, r2 = 0;
+    __asm__ volatile ("rdtsc" : "=a"(r1), "=d"(r2)); // Constrain r1 to rax and r2 to rdx.
+    return (r2 << 32) | r1;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/**
+ * X16R statistics are only collected when built with --enable-x16r-stats, and never in
+ * libgenixconsensus. They are counted in a few cache line sized shards, selected by
+ * thread id, so that threads hashing concurrently (e.g. the header check threads) rarely
+ * share a counter. Relaxed atomics are enough, the counters are only summed up for reporting.
+ */
+struct alignas(64) X16RStatsShard
+{
+    std::atomic<uint64_t> nHits[16];
+    std::atomic<uint64_t> nBytes[16];
+    std::atomic<uint64_t> nTicks[16];
+};
+
+const size_t X16R_STATS_SHARDS = 16;
+X16RStatsShard x16rStats[X16R_STATS_SHARDS];
+
+inline X16RStatsShard& GetX16RStatsShard()
+{
+    return x16rStats[std::hash<std::thread::id>()(std::this_thread::get_id()) % X16R_STATS_SHARDS];
+}
+
+inline void X16RStage(X16RContext& ctx, X16RStatsShard& stats, int algo, const void* data, size_t len, void* out)
+{
+    const X16RAlgo& a = x16rAlgos[algo];
+    uint64_t nStart = X16RTicks();
+    a.init(&ctx);
+    a.update(&ctx, data, len);
+    a.close(&ctx, out);
+    stats.nTicks[algo].fetch_add(X16RTicks() - nStart, std::memory_order_relaxed);
+    stats.nHits[algo].fetch_add(1, std::memory_order_relaxed);
+    stats.nBytes[algo].fetch_add(len, std::memory_order_relaxed);
+}
+#else
+struct X16RStatsShard {};
+
+inline X16RStatsShard& GetX16RStatsShard()
+{
+    static X16RStatsShard dummy;
+    return dummy;
+}
+
+inline void X16RStage(X16RContext& ctx, X16RStatsShard&, int algo, const void* data, size_t len, void* out)
+{
+    const X16RAlgo& a = x16rAlgos[algo];
+    a.init(&ctx);
+    a.update(&ctx, data, len);
+    a.close(&ctx, out);
+}
+#endif // ENABLE_X16R_STATS
+
+/** Check an implementation of algorithm algo against the sph reference */
+bool X16RSelfTest(int algo, const X16RAlgo& impl)
+{
+    X16RContext ctx;
+    unsigned char data[300];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (unsigned char)(i * 37 + 11);
+    }
+    // lengths covering empty input, X16R inputs and multiple blocks with all padding cases
+    for (size_t len : {0, 1, 64, 80, 109, 110, 111, 127, 128, 129, 300}) {
+        uint512 expected, actual;
+        X16RAlgo ref = x16rAlgos[algo];
+        ref.init(&ctx);
+        ref.update(&ctx, data, len);
+        ref.close(&ctx, &expected);
+        impl.init(&ctx);
+        // feed in two parts to exercise the buffering
+        impl.update(&ctx, data, len / 3);
+        impl.update(&ctx, data + len / 3, len - len / 3);
+        impl.close(&ctx, &actual);
+        if (expected != actual) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+std::string X16RAutoDetect()
+{
+    std::string ret = "standard";
+#if defined(ENABLE_AESNI) && !defined(BUILD_BITCOIN_INTERNAL) && defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+    uint32_t eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && ((ecx >> 25) & 1)) {
+        const X16RAlgo echo = {echo512_aesni::Init, echo512_aesni::Update, echo512_aesni::Close};
+        const X16RAlgo shavite = {shavite512_aesni::Init, shavite512_aesni::Update, shavite512_aesni::Close};
+        if (X16RSelfTest(10, echo) && X16RSelfTest(8, shavite)) {
+            x16rAlgos[10] = echo;
+            x16rAlgos[8] = shavite;
+            ret = "aesni(echo,shavite)";
+        }
+    }
+#endif
+    return ret;
+}
+
+const char* GetX16RAlgoName(int algo)
+{
+    assert(algo >= 0 && algo < 16);
+    return x16rAlgoNames[algo];
+}
+
+#if defined(ENABLE_X16R_STATS) && !defined(BUILD_BITCOIN_INTERNAL)
+std::array<X16RAlgoStats, 16> GetX16RStats()
+{
+    std::array<X16RAlgoStats, 16> ret;
+    for (const auto& shard : x16rStats) {
+        for (int algo = 0; algo < 16; algo++) {
+            ret[algo].nHits += shard.nHits[algo].load(std::memory_order_relaxed);
+            ret[algo].nBytes += shard.nBytes[algo].load(std::memory_order_relaxed);
+            ret[algo].nTicks += shard.nTicks[algo].load(std::memory_order_relaxed);
+        }
+    }
+    return ret;
+}
+
+void ResetX16RStats()
+{
+    for (auto& shard : x16rStats) {
+        for (int algo = 0; algo < 16; algo++) {
+            shard.nHits[algo].store(0, std::memory_order_relaxed);
+            shard.nBytes[algo].store(0, std::memory_order_relaxed);
+            shard.nTicks[algo].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+#endif // ENABLE_X16R_STATS
+
+void HashX16RStage(int algo, const unsigned char* data, size_t len, uint512& hash)
+{
+    assert(algo >= 0 && algo < 16);
+    X16RContext ctx;
+    X16RStage(ctx, GetX16RStatsShard(), algo, data, len, &hash);
+}
+
+uint256 HashX16RBuffer(const unsigned char* data, size_t len, const uint256& PrevBlockHash)
+{
+    X16RContext ctx;
+    X16RStatsShard& stats = GetX16RStatsShard();
+    uint512 hash[2];
+
+    X16RStage(ctx, stats, GetHashSelection(PrevBlockHash, 0), data, len, &hash[0]);
+    for (int i = 1; i < 16; i++) {
+        X16RStage(ctx, stats, GetHashSelection(PrevBlockHash, i), &hash[(i - 1) & 1], 64, &hash[i & 1]);
+    }
+
+    return hash[1].trim256();
+}
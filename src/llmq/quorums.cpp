@@ -51,32 +51,27 @@ CQuorum::~CQuorum()
     }
 }
 
-void CQuorum::Init(const CFinalCommitment& _qc, const CBlockIndex* _pindexQuorum, const uint256& _minedBlockHash, const std::vector<CDeterministicMNCPtr>& _members)
+void CQuorum::Init(const CFinalCommitment& _qc, const CBlockIndex* _pindexQuorum, const uint256& _minedBlockHash, const CQuorumMembersCPtr& _members)
 {
     qc = _qc;
     pindexQuorum = _pindexQuorum;
-    members = _members;
+    members = _members->members;
+    quorumMembers = _members;
     minedBlockHash = _minedBlockHash;
 }
 
 bool CQuorum::IsMember(const uint256& proTxHash) const
 {
-    for (auto& dmn : members) {
-        if (dmn->proTxHash == proTxHash) {
-            return true;
-        }
-    }
-    return false;
+    return quorumMembers->GetMemberIndex(proTxHash) != -1;
 }
 
 bool CQuorum::IsValidMember(const uint256& proTxHash) const
 {
-    for (size_t i = 0; i < members.size(); i++) {
-        if (members[i]->proTxHash == proTxHash) {
-            return qc.validMembers[i];
-        }
+    int memberIdx = quorumMembers->GetMemberIndex(proTxHash);
+    if (memberIdx == -1) {
+        return false;
     }
-    return false;
+    return qc.validMembers[memberIdx];
 }
 
 CBLSPublicKey CQuorum::GetPubKeyShare(size_t memberIdx) const
@@ -95,12 +90,7 @@ CBLSSecretKey CQuorum::GetSkShare() const
 
 int CQuorum::GetMemberIndex(const uint256& proTxHash) const
 {
-    for (size_t i = 0; i < members.size(); i++) {
-        if (members[i]->proTxHash == proTxHash) {
-            return (int)i;
-        }
-    }
-    return -1;
+    return quorumMembers->GetMemberIndex(proTxHash);
 }
 
 void CQuorum::WriteContributions(CEvoDB& evoDb)
@@ -120,7 +110,7 @@ bool CQuorum::ReadContributions(CEvoDB& evoDb)
     uint256 dbKey = MakeQuorumKey(*this);
 
     BLSVerificationVector qv;
-    if (evoDb.Read(std::make_pair(DB_QUORUM_QUORUM_VVEC, dbKey), qv)) {
+    if (evoDb.ReadImmutable(std::make_pair(DB_QUORUM_QUORUM_VVEC, dbKey), qv)) {
         quorumVvec = std::make_shared<BLSVerificationVector>(std::move(qv));
     } else {
         return false;
@@ -128,7 +118,7 @@ bool CQuorum::ReadContributions(CEvoDB& evoDb)
 
     // We ignore the return value here as it is ok if this fails. If it fails, it usually means that we are not a
     // member of the quorum but observed the whole DKG process to have the quorum verification vector.
-    evoDb.Read(std::make_pair(DB_QUORUM_SK_SHARE, dbKey), skShare);
+    evoDb.ReadImmutable(std::make_pair(DB_QUORUM_SK_SHARE, dbKey), skShare);
 
     return true;
 }
@@ -233,7 +223,7 @@ bool CQuorumManager::BuildQuorumFromCommitment(const CFinalCommitment& qc, const
     assert(pindexQuorum);
     assert(qc.quorumHash == pindexQuorum->GetBlockHash());
 
-    auto members = CLLMQUtils::GetAllQuorumMembers((Consensus::LLMQType)qc.llmqType, pindexQuorum);
+    auto members = CLLMQUtils::GetQuorumMembers((Consensus::LLMQType)qc.llmqType, pindexQuorum);
 
     quorum->Init(qc, pindexQuorum, minedBlockHash, members);
 
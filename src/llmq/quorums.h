@@ -8,6 +8,7 @@
 #include "evo/evodb.h"
 #include "evo/deterministicmns.h"
 #include "llmq/quorums_commitment.h"
+#include "llmq/quorums_utils.h"
 
 #include "validationinterface.h"
 #include "consensus/params.h"
@@ -46,6 +47,9 @@ public:
     CBLSSecretKey skShare;
 
 private:
+    // proTxHash -> member index lookup for members
+    CQuorumMembersCPtr quorumMembers;
+
     // Recovery of public key shares is very slow, so we start a background thread that pre-populates a cache so that
     // the public key shares are ready when needed later
     mutable CBLSWorkerCache blsCache;
@@ -55,7 +59,7 @@ private:
 public:
     CQuorum(const Consensus::LLMQParams& _params, CBLSWorker& _blsWorker) : params(_params), blsCache(_blsWorker), stopCachePopulatorThread(false) {}
     ~CQuorum();
-    void Init(const CFinalCommitment& _qc, const CBlockIndex* _pindexQuorum, const uint256& _minedBlockHash, const std::vector<CDeterministicMNCPtr>& _members);
+    void Init(const CFinalCommitment& _qc, const CBlockIndex* _pindexQuorum, const uint256& _minedBlockHash, const CQuorumMembersCPtr& _members);
 
     bool IsMember(const uint256& proTxHash) const;
     bool IsValidMember(const uint256& proTxHash) const;
@@ -73,6 +73,9 @@ void StartLLMQSystem()
     if (quorumDKGSessionManager) {
         quorumDKGSessionManager->StartMessageHandlerPool();
     }
+    if (quorumSigningManager) {
+        quorumSigningManager->StartVerifyPool();
+    }
     if (quorumSigSharesManager) {
         quorumSigSharesManager->RegisterAsRecoveredSigsListener();
         quorumSigSharesManager->StartWorkerThread();
@@ -97,6 +100,9 @@ void StopLLMQSystem()
         quorumSigSharesManager->StopWorkerThread();
         quorumSigSharesManager->UnregisterAsRecoveredSigsListener();
     }
+    if (quorumSigningManager) {
+        quorumSigningManager->StopVerifyPool();
+    }
     if (quorumDKGSessionManager) {
         quorumDKGSessionManager->StopMessageHandlerPool();
     }
@@ -444,6 +444,28 @@ CSigningManager::CSigningManager(CDBWrapper& llmqDb, bool fMemory) :
 {
 }
 
+void CSigningManager::StartVerifyPool()
+{
+    int threadCount = gArgs.GetArg("-llmqverifythreads", DEFAULT_LLMQ_VERIFY_THREADS);
+    if (threadCount <= 0) {
+        threadCount = std::min(std::max(GetNumCores() / 2, 1), 4);
+    }
+    threadCount = std::min(threadCount, MAX_LLMQ_VERIFY_THREADS);
+
+    // with a single thread, verification is done by the caller
+    if (threadCount > 1) {
+        verifyPool.resize(threadCount - 1);
+        RenameThreadPool(verifyPool, "genix-q-verify");
+    }
+    LogPrintf("CSigningManager::%s -- using %d threads for LLMQ signature verification\n", __func__, threadCount);
+}
+
+void CSigningManager::StopVerifyPool()
+{
+    verifyPool.clear_queue();
+    verifyPool.stop(true);
+}
+
 bool CSigningManager::AlreadyHave(const CInv& inv)
 {
     LOCK(cs);
@@ -611,7 +633,8 @@ bool CSigningManager::ProcessPendingRecoveredSigs(CConnman& connman)
 
     // It's ok to perform insecure batched verification here as we verify against the quorum public keys, which are not
     // craftable by individual entities, making the rogue public key attack impossible
-    CBLSBatchVerifier<NodeId, uint256> batchVerifier(false, false);
+    // Sigs of different quorums are verified in parallel
+    CBLSPartitionedBatchVerifier<std::pair<Consensus::LLMQType, uint256>, NodeId, uint256> batchVerifier(false, false);
 
     size_t verifyCount = 0;
     for (auto& p : recSigsByNode) {
@@ -625,17 +648,18 @@ bool CSigningManager::ProcessPendingRecoveredSigs(CConnman& connman)
                 break;
             }
 
-            const auto& quorum = quorums.at(std::make_pair((Consensus::LLMQType)recSig.llmqType, recSig.quorumHash));
-            batchVerifier.PushMessage(nodeId, recSig.GetHash(), CLLMQUtils::BuildSignHash(recSig), recSig.sig.Get(), quorum->qc.quorumPublicKey);
+            auto quorumKey = std::make_pair((Consensus::LLMQType)recSig.llmqType, recSig.quorumHash);
+            const auto& quorum = quorums.at(quorumKey);
+            batchVerifier.PushMessage(quorumKey, nodeId, recSig.GetHash(), CLLMQUtils::BuildSignHash(recSig), recSig.sig.Get(), quorum->qc.quorumPublicKey);
             verifyCount++;
         }
     }
 
     cxxtimer::Timer verifyTimer(true);
-    batchVerifier.Verify();
+    batchVerifier.Verify(&verifyPool);
     verifyTimer.stop();
 
-    LogPrint(BCLog::LLMQ, "CSigningManager::%s -- verified recovered sig(s). count=%d, vt=%d, nodes=%d\n", __func__, verifyCount, verifyTimer.count(), recSigsByNode.size());
+    LogPrint(BCLog::LLMQ, "CSigningManager::%s -- verified recovered sig(s). count=%d, vt=%d, nodes=%d, quorums=%d\n", __func__, verifyCount, verifyTimer.count(), recSigsByNode.size(), batchVerifier.GetPartitionCount());
 
     std::unordered_set<uint256, StaticSaltedHasher> processed;
     for (auto& p : recSigsByNode) {
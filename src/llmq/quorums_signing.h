@@ -9,6 +9,7 @@
 
 #include "net.h"
 #include "chainparams.h"
+#include "ctpl.h"
 #include "saltedhasher.h"
 #include "univalue.h"
 #include "unordered_lru_cache.h"
@@ -18,6 +19,10 @@
 namespace llmq
 {
 
+// 0 = auto, 1 = verify on the worker thread of CSigSharesManager
+static const int DEFAULT_LLMQ_VERIFY_THREADS = 0;
+static const int MAX_LLMQ_VERIFY_THREADS = 16;
+
 class CRecoveredSig
 {
 public:
@@ -135,9 +140,15 @@ private:
 
     std::vector<CRecoveredSigsListener*> recoveredSigsListeners;
 
+    // used to batch verify sig shares and recovered sigs of different quorums in parallel
+    ctpl::thread_pool verifyPool;
+
 public:
     CSigningManager(CDBWrapper& llmqDb, bool fMemory);
 
+    void StartVerifyPool();
+    void StopVerifyPool();
+
     bool AlreadyHave(const CInv& inv);
     bool GetRecoveredSigForGetData(const uint256& hash, CRecoveredSig& ret);
 
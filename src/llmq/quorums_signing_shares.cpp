@@ -34,58 +34,75 @@ std::string CSigSesAnn::ToString() const
 
 void CSigSharesInv::Merge(const CSigSharesInv& inv2)
 {
-    for (size_t i = 0; i < inv.size(); i++) {
-        if (inv2.inv[i]) {
-            inv[i] = inv2.inv[i];
-        }
+    assert(inv2.size == size);
+    for (size_t i = 0; i < words.size(); i++) {
+        words[i] |= inv2.words[i];
+    }
+}
+
+void CSigSharesInv::AndNot(const CSigSharesInv& inv2)
+{
+    assert(inv2.size == size);
+    for (size_t i = 0; i < words.size(); i++) {
+        words[i] &= ~inv2.words[i];
     }
 }
 
 size_t CSigSharesInv::CountSet() const
 {
-    return (size_t)std::count(inv.begin(), inv.end(), true);
+    size_t count = 0;
+    for (uint64_t w : words) {
+        count += (size_t)__builtin_popcountll(w);
+    }
+    return count;
 }
 
 std::string CSigSharesInv::ToString() const
 {
     std::string str = "(";
     bool first = true;
-    for (size_t i = 0; i < inv.size(); i++) {
-        if (!inv[i]) {
-            continue;
-        }
-
+    ForEachSet([&](uint16_t quorumMember) {
         if (!first) {
             str += ",";
         }
         first = false;
-        str += strprintf("%d", i);
-    }
+        str += strprintf("%d", quorumMember);
+    });
     str += ")";
     return str;
 }
 
-void CSigSharesInv::Init(size_t size)
+void CSigSharesInv::Init(size_t _size)
 {
-    inv.resize(size, false);
+    size = _size;
+    words.assign((size + 63) / 64, 0);
 }
 
 bool CSigSharesInv::IsSet(uint16_t quorumMember) const
 {
-    assert(quorumMember < inv.size());
-    return inv[quorumMember];
+    assert(quorumMember < size);
+    return (words[quorumMember / 64] >> (quorumMember % 64)) & 1;
 }
 
 void CSigSharesInv::Set(uint16_t quorumMember, bool v)
 {
-    assert(quorumMember < inv.size());
-    inv[quorumMember] = v;
+    assert(quorumMember < size);
+    uint64_t mask = (uint64_t)1 << (quorumMember % 64);
+    if (v) {
+        words[quorumMember / 64] |= mask;
+    } else {
+        words[quorumMember / 64] &= ~mask;
+    }
 }
 
 void CSigSharesInv::SetAll(bool v)
 {
-    for (size_t i = 0; i < inv.size(); i++) {
-        inv[i] = v;
+    for (auto& w : words) {
+        w = v ? ~(uint64_t)0 : 0;
+    }
+    // keep the bits beyond size cleared
+    if (v && size % 64) {
+        words.back() &= ((uint64_t)1 << (size % 64)) - 1;
     }
 }
 
@@ -95,7 +112,7 @@ std::string CBatchedSigShares::ToInvString() const
     // we use 400 here no matter what the real size is. We don't really care about that size as we just want to call ToString()
     inv.Init(400);
     for (size_t i = 0; i < sigShares.size(); i++) {
-        inv.inv[sigShares[i].first] = true;
+        inv.Set(sigShares[i].first, true);
     }
     return inv.ToString();
 }
@@ -115,23 +132,41 @@ static void InitSession(CSigSharesNodeState::Session& s, const uint256& signHash
     s.knows.Init((size_t)params.size);
 }
 
+CSigSharesNodeState::Session& CSigSharesNodeState::CreateSession(const uint256& signHash)
+{
+    Session* s;
+    if (!freeSessionSlots.empty()) {
+        s = freeSessionSlots.back();
+        freeSessionSlots.pop_back();
+    } else {
+        sessionSlots.emplace_back();
+        s = &sessionSlots.back();
+    }
+    sessions.emplace(signHash, s);
+    return *s;
+}
+
 CSigSharesNodeState::Session& CSigSharesNodeState::GetOrCreateSessionFromShare(const llmq::CSigShare& sigShare)
 {
-    auto& s = sessions[sigShare.GetSignHash()];
-    if (s.announced.inv.empty()) {
-        InitSession(s, sigShare.GetSignHash(), sigShare);
+    auto s = GetSessionBySignHash(sigShare.GetSignHash());
+    if (s) {
+        return *s;
     }
-    return s;
+    auto& newSession = CreateSession(sigShare.GetSignHash());
+    InitSession(newSession, sigShare.GetSignHash(), sigShare);
+    return newSession;
 }
 
 CSigSharesNodeState::Session& CSigSharesNodeState::GetOrCreateSessionFromAnn(const llmq::CSigSesAnn& ann)
 {
     auto signHash = CLLMQUtils::BuildSignHash((Consensus::LLMQType)ann.llmqType, ann.quorumHash, ann.id, ann.msgHash);
-    auto& s = sessions[signHash];
-    if (s.announced.inv.empty()) {
-        InitSession(s, signHash, ann);
+    auto s = GetSessionBySignHash(signHash);
+    if (s) {
+        return *s;
     }
-    return s;
+    auto& newSession = CreateSession(signHash);
+    InitSession(newSession, signHash, ann);
+    return newSession;
 }
 
 CSigSharesNodeState::Session* CSigSharesNodeState::GetSessionBySignHash(const uint256& signHash)
@@ -140,7 +175,7 @@ CSigSharesNodeState::Session* CSigSharesNodeState::GetSessionBySignHash(const ui
     if (it == sessions.end()) {
         return nullptr;
     }
-    return &it->second;
+    return it->second;
 }
 
 CSigSharesNodeState::Session* CSigSharesNodeState::GetSessionByRecvId(uint32_t sessionId)
@@ -172,8 +207,12 @@ void CSigSharesNodeState::RemoveSession(const uint256& signHash)
 {
     auto it = sessions.find(signHash);
     if (it != sessions.end()) {
-        sessionByRecvId.erase(it->second.recvSessionId);
+        Session* s = it->second;
+        sessionByRecvId.erase(s->recvSessionId);
         sessions.erase(it);
+        // the null signHash marks the slot as free
+        *s = Session();
+        freeSessionSlots.emplace_back(s);
     }
     requestedSigShares.EraseAllForSignHash(signHash);
     pendingIncomingSigShares.EraseAllForSignHash(signHash);
@@ -337,7 +376,7 @@ bool CSigSharesManager::VerifySigSharesInv(NodeId from, Consensus::LLMQType llmq
 {
     size_t quorumSize = (size_t)Params().GetConsensus().llmqs.at(llmqType).size;
 
-    if (inv.inv.size() != quorumSize) {
+    if (inv.Size() != quorumSize) {
         return false;
     }
     return true;
@@ -422,32 +461,37 @@ bool CSigSharesManager::ProcessMessageBatchedSigShares(CNode* pfrom, const CBatc
         return !ban;
     }
 
-    std::vector<CSigShare> sigShares;
-    sigShares.reserve(batchedSigShares.sigShares.size());
+    std::vector<CSigShare> receivedSigShares;
+    receivedSigShares.reserve(batchedSigShares.sigShares.size());
+    for (size_t i = 0; i < batchedSigShares.sigShares.size(); i++) {
+        receivedSigShares.emplace_back(RebuildSigShare(sessionInfo, batchedSigShares, i));
+    }
 
     {
         LOCK(cs);
         auto& nodeState = nodeStates[pfrom->GetId()];
-
-        for (size_t i = 0; i < batchedSigShares.sigShares.size(); i++) {
-            CSigShare sigShare = RebuildSigShare(sessionInfo, batchedSigShares, i);
+        for (auto& sigShare : receivedSigShares) {
             nodeState.requestedSigShares.Erase(sigShare.GetKey());
+        }
+    }
 
-            // TODO track invalid sig shares received for PoSe?
-            // It's important to only skip seen *valid* sig shares here. If a node sends us a
-            // batch of mostly valid sig shares with a single invalid one and thus batched
-            // verification fails, we'd skip the valid ones in the future if received from other nodes
-            if (this->sigShares.Has(sigShare.GetKey())) {
-                continue;
-            }
-
-            // TODO for PoSe, we should consider propagating shares even if we already have a recovered sig
-            if (quorumSigningManager->HasRecoveredSigForId((Consensus::LLMQType)sigShare.llmqType, sigShare.id)) {
-                continue;
-            }
+    std::vector<CSigShare> sigShares;
+    sigShares.reserve(receivedSigShares.size());
+    for (auto& sigShare : receivedSigShares) {
+        // TODO track invalid sig shares received for PoSe?
+        // It's important to only skip seen *valid* sig shares here. If a node sends us a
+        // batch of mostly valid sig shares with a single invalid one and thus batched
+        // verification fails, we'd skip the valid ones in the future if received from other nodes
+        if (this->sigShares.Has(sigShare.GetKey())) {
+            continue;
+        }
 
-            sigShares.emplace_back(sigShare);
+        // TODO for PoSe, we should consider propagating shares even if we already have a recovered sig
+        if (quorumSigningManager->HasRecoveredSigForId((Consensus::LLMQType)sigShare.llmqType, sigShare.id)) {
+            continue;
         }
+
+        sigShares.emplace_back(sigShare);
     }
 
     LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- signHash=%s, shares=%d, new=%d, inv={%s}, node=%d\n", __func__,
@@ -581,7 +625,8 @@ bool CSigSharesManager::ProcessPendingSigShares(CConnman& connman)
 
     // It's ok to perform insecure batched verification here as we verify against the quorum public key shares,
     // which are not craftable by individual entities, making the rogue public key attack impossible
-    CBLSBatchVerifier<NodeId, SigShareKey> batchVerifier(false, true);
+    // Shares of different quorums are verified in parallel
+    CBLSPartitionedBatchVerifier<std::pair<Consensus::LLMQType, uint256>, NodeId, SigShareKey> batchVerifier(false, true);
 
     size_t verifyCount = 0;
     for (auto& p : sigSharesByNodes) {
@@ -601,7 +646,8 @@ bool CSigSharesManager::ProcessPendingSigShares(CConnman& connman)
                 break;
             }
 
-            auto quorum = quorums.at(std::make_pair((Consensus::LLMQType)sigShare.llmqType, sigShare.quorumHash));
+            auto quorumKey = std::make_pair((Consensus::LLMQType)sigShare.llmqType, sigShare.quorumHash);
+            auto quorum = quorums.at(quorumKey);
             auto pubKeyShare = quorum->GetPubKeyShare(sigShare.quorumMember);
 
             if (!pubKeyShare.IsValid()) {
@@ -611,16 +657,16 @@ bool CSigSharesManager::ProcessPendingSigShares(CConnman& connman)
                 assert(false);
             }
 
-            batchVerifier.PushMessage(nodeId, sigShare.GetKey(), sigShare.GetSignHash(), sigShare.sigShare.Get(), pubKeyShare);
+            batchVerifier.PushMessage(quorumKey, nodeId, sigShare.GetKey(), sigShare.GetSignHash(), sigShare.sigShare.Get(), pubKeyShare);
             verifyCount++;
         }
     }
 
     cxxtimer::Timer verifyTimer(true);
-    batchVerifier.Verify();
+    batchVerifier.Verify(&quorumSigningManager->verifyPool);
     verifyTimer.stop();
 
-    LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- verified sig shares. count=%d, vt=%d, nodes=%d\n", __func__, verifyCount, verifyTimer.count(), sigSharesByNodes.size());
+    LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- verified sig shares. count=%d, vt=%d, nodes=%d, quorums=%d\n", __func__, verifyCount, verifyTimer.count(), sigSharesByNodes.size(), batchVerifier.GetPartitionCount());
 
     for (auto& p : sigSharesByNodes) {
         auto nodeId = p.first;
@@ -682,6 +728,7 @@ void CSigSharesManager::ProcessSigShare(NodeId nodeId, const CSigShare& sigShare
         if (!sigShares.Add(sigShare.GetKey(), sigShare)) {
             return;
         }
+
         sigSharesToAnnounce.Add(sigShare.GetKey(), true);
 
         // Update the time we've seen the last sigShare
@@ -698,11 +745,11 @@ void CSigSharesManager::ProcessSigShare(NodeId nodeId, const CSigShare& sigShare
                 session.knows.Set(sigShare.quorumMember, true);
             }
         }
+    }
 
-        size_t sigShareCount = sigShares.CountForSignHash(sigShare.GetSignHash());
-        if (sigShareCount >= quorum->params.threshold) {
-            canTryRecovery = true;
-        }
+    size_t sigShareCount = sigShares.CountForSignHash(sigShare.GetSignHash());
+    if (sigShareCount >= quorum->params.threshold) {
+        canTryRecovery = true;
     }
 
     if (canTryRecovery) {
@@ -719,23 +766,17 @@ void CSigSharesManager::TryRecoverSig(const CQuorumCPtr& quorum, const uint256&
     std::vector<CBLSSignature> sigSharesForRecovery;
     std::vector<CBLSId> idsForRecovery;
     {
-        LOCK(cs);
-
-        auto k = std::make_pair(quorum->params.type, id);
-
         auto signHash = CLLMQUtils::BuildSignHash(quorum->params.type, quorum->qc.quorumHash, id, msgHash);
-        auto sigShares = this->sigShares.GetAllForSignHash(signHash);
-        if (!sigShares) {
-            return;
-        }
 
         sigSharesForRecovery.reserve((size_t) quorum->params.threshold);
         idsForRecovery.reserve((size_t) quorum->params.threshold);
-        for (auto it = sigShares->begin(); it != sigShares->end() && sigSharesForRecovery.size() < quorum->params.threshold; ++it) {
-            auto& sigShare = it->second;
+        sigShares.ForEachForSignHash(signHash, [&](uint16_t quorumMember, const CSigShare& sigShare) {
+            if (sigSharesForRecovery.size() >= quorum->params.threshold) {
+                return;
+            }
             sigSharesForRecovery.emplace_back(sigShare.sigShare.Get());
-            idsForRecovery.emplace_back(CBLSId::FromHash(quorum->members[sigShare.quorumMember]->proTxHash));
-        }
+            idsForRecovery.emplace_back(CBLSId::FromHash(quorum->members[quorumMember]->proTxHash));
+        });
 
         // check if we can recover the final signature
         if (sigSharesForRecovery.size() < quorum->params.threshold) {
@@ -808,7 +849,7 @@ void CSigSharesManager::CollectSigSharesToRequest(std::unordered_map<NodeId, std
         nodeState.requestedSigShares.EraseIf([&](const SigShareKey& k, int64_t t) {
             if (now - t >= SIG_SHARE_REQUEST_TIMEOUT) {
                 // timeout while waiting for this one, so retry it with another node
-                LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::CollectSigSharesToRequest -- timeout while waiting for %s-%d, node=%d\n",
+                LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- timeout while waiting for %s-%d, node=%d\n", __func__,
                          k.first.ToString(), k.second, nodeId);
                 return true;
             }
@@ -817,27 +858,29 @@ void CSigSharesManager::CollectSigSharesToRequest(std::unordered_map<NodeId, std
 
         decltype(sigSharesToRequest.begin()->second)* invMap = nullptr;
 
-        for (auto& p2 : nodeState.sessions) {
-            auto& signHash = p2.first;
-            auto& session = p2.second;
+        nodeState.ForEachSession([&](CSigSharesNodeState::Session& session) {
+            auto& signHash = session.signHash;
 
             if (quorumSigningManager->HasRecoveredSigForSession(signHash)) {
-                continue;
+                return;
             }
 
-            for (size_t i = 0; i < session.announced.inv.size(); i++) {
-                if (!session.announced.inv[i]) {
-                    continue;
+            bool limitReached = false;
+            CSigSharesInv announced = session.announced;
+            announced.ForEachSet([&](uint16_t i) {
+                if (limitReached) {
+                    return;
                 }
-                auto k = std::make_pair(signHash, (uint16_t) i);
+                auto k = std::make_pair(signHash, i);
                 if (sigShares.Has(k)) {
                     // we already have it
-                    session.announced.inv[i] = false;
-                    continue;
+                    session.announced.Set(i, false);
+                    return;
                 }
                 if (nodeState.requestedSigShares.Size() >= maxRequestsForNode) {
                     // too many pending requests for this node
-                    break;
+                    limitReached = true;
+                    return;
                 }
                 auto p = sigSharesRequested.Get(k);
                 if (p) {
@@ -846,7 +889,7 @@ void CSigSharesManager::CollectSigSharesToRequest(std::unordered_map<NodeId, std
                         LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- other node timeout while waiting for %s-%d, re-request from=%d, node=%d\n", __func__,
                                  k.first.ToString(), k.second, nodeId, p->first);
                     } else {
-                        continue;
+                        return;
                     }
                 }
                 // if we got this far we should do a request
@@ -863,16 +906,16 @@ void CSigSharesManager::CollectSigSharesToRequest(std::unordered_map<NodeId, std
                     invMap = &sigSharesToRequest[nodeId];
                 }
                 auto& inv = (*invMap)[signHash];
-                if (inv.inv.empty()) {
+                if (!inv.IsInitialized()) {
                     const auto& params = Params().GetConsensus().llmqs.at((Consensus::LLMQType)session.llmqType);
                     inv.Init((size_t)params.size);
                 }
-                inv.inv[k.second] = true;
+                inv.Set(k.second, true);
 
                 // dont't request it again from this node
-                session.announced.inv[i] = false;
-            }
-        }
+                session.announced.Set(i, false);
+            });
+        });
     }
 }
 
@@ -890,32 +933,26 @@ void CSigSharesManager::CollectSigSharesToSend(std::unordered_map<NodeId, std::u
 
         decltype(sigSharesToSend.begin()->second)* sigSharesToSend2 = nullptr;
 
-        for (auto& p2 : nodeState.sessions) {
-            auto& signHash = p2.first;
-            auto& session = p2.second;
+        nodeState.ForEachSession([&](CSigSharesNodeState::Session& session) {
+            auto& signHash = session.signHash;
 
             if (quorumSigningManager->HasRecoveredSigForSession(signHash)) {
-                continue;
+                return;
             }
 
             CBatchedSigShares batchedSigShares;
 
-            for (size_t i = 0; i < session.requested.inv.size(); i++) {
-                if (!session.requested.inv[i]) {
-                    continue;
-                }
-                session.requested.inv[i] = false;
-
-                auto k = std::make_pair(signHash, (uint16_t)i);
-                const CSigShare* sigShare = sigShares.Get(k);
-                if (!sigShare) {
+            session.requested.ForEachSet([&](uint16_t i) {
+                auto k = std::make_pair(signHash, i);
+                CSigShare sigShare;
+                if (!sigShares.Get(k, sigShare)) {
                     // he requested something we don'have
-                    session.requested.inv[i] = false;
-                    continue;
+                    return;
                 }
 
-                batchedSigShares.sigShares.emplace_back((uint16_t)i, sigShare->sigShare);
-            }
+                batchedSigShares.sigShares.emplace_back(i, sigShare.sigShare);
+            });
+            session.requested.SetAll(false);
 
             if (!batchedSigShares.sigShares.empty()) {
                 if (sigSharesToSend2 == nullptr) {
@@ -924,7 +961,7 @@ void CSigSharesManager::CollectSigSharesToSend(std::unordered_map<NodeId, std::u
                 }
                 (*sigSharesToSend2).emplace(signHash, std::move(batchedSigShares));
             }
-        }
+        });
     }
 }
 
@@ -937,13 +974,13 @@ void CSigSharesManager::CollectSigSharesToAnnounce(std::unordered_map<NodeId, st
     this->sigSharesToAnnounce.ForEach([&](const SigShareKey& sigShareKey, bool) {
         auto& signHash = sigShareKey.first;
         auto quorumMember = sigShareKey.second;
-        const CSigShare* sigShare = sigShares.Get(sigShareKey);
-        if (!sigShare) {
+        CSigShare sigShare;
+        if (!sigShares.Get(sigShareKey, sigShare)) {
             return;
         }
 
         // announce to the nodes which we know through the intra-quorum-communication system
-        auto quorumKey = std::make_pair((Consensus::LLMQType)sigShare->llmqType, sigShare->quorumHash);
+        auto quorumKey = std::make_pair((Consensus::LLMQType)sigShare.llmqType, sigShare.quorumHash);
         auto it = quorumNodesMap.find(quorumKey);
         if (it == quorumNodesMap.end()) {
             auto nodeIds = g_connman->GetMasternodeQuorumNodes(quorumKey.first, quorumKey.second);
@@ -959,20 +996,20 @@ void CSigSharesManager::CollectSigSharesToAnnounce(std::unordered_map<NodeId, st
                 continue;
             }
 
-            auto& session = nodeState.GetOrCreateSessionFromShare(*sigShare);
+            auto& session = nodeState.GetOrCreateSessionFromShare(sigShare);
 
-            if (session.knows.inv[quorumMember]) {
+            if (session.knows.IsSet(quorumMember)) {
                 // he already knows that one
                 continue;
             }
 
             auto& inv = sigSharesToAnnounce[nodeId][signHash];
-            if (inv.inv.empty()) {
-                const auto& params = Params().GetConsensus().llmqs.at((Consensus::LLMQType)sigShare->llmqType);
+            if (!inv.IsInitialized()) {
+                const auto& params = Params().GetConsensus().llmqs.at((Consensus::LLMQType)sigShare.llmqType);
                 inv.Init((size_t)params.size);
             }
-            inv.inv[quorumMember] = true;
-            session.knows.inv[quorumMember] = true;
+            inv.Set(quorumMember, true);
+            session.knows.Set(quorumMember, true);
         }
     });
 
@@ -1161,12 +1198,9 @@ void CSigSharesManager::Cleanup()
     // quorumHash -> quorumPtr (as GetQuorum() requires cs_main, leading to deadlocks with cs held)
     std::unordered_map<std::pair<Consensus::LLMQType, uint256>, CQuorumCPtr, StaticSaltedHasher> quorums;
 
-    {
-        LOCK(cs);
-        sigShares.ForEach([&](const SigShareKey& k, const CSigShare& sigShare) {
-            quorums.emplace(std::make_pair((Consensus::LLMQType) sigShare.llmqType, sigShare.quorumHash), nullptr);
-        });
-    }
+    sigShares.ForEach([&](const SigShareKey& k, const CSigShare& sigShare) {
+        quorums.emplace(std::make_pair((Consensus::LLMQType) sigShare.llmqType, sigShare.quorumHash), nullptr);
+    });
 
     // Find quorums which became inactive
     for (auto it = quorums.begin(); it != quorums.end(); ) {
@@ -1179,7 +1213,8 @@ void CSigSharesManager::Cleanup()
     }
 
     {
-        // Now delete sessions which are for inactive quorums
+        // Now delete sessions which are for inactive quorums. Shares are only added with cs held, so scanning and
+        // removing under the same lock can't leave a share or announcement behind for a removed session
         LOCK(cs);
         std::unordered_set<uint256, StaticSaltedHasher> inactiveQuorumSessions;
         sigShares.ForEach([&](const SigShareKey& k, const CSigShare& sigShare) {
@@ -1196,15 +1231,17 @@ void CSigSharesManager::Cleanup()
         LOCK(cs);
 
         // Remove sessions which were succesfully recovered
-        std::unordered_set<uint256, StaticSaltedHasher> doneSessions;
+        std::unordered_set<uint256, StaticSaltedHasher> allSessions;
         sigShares.ForEach([&](const SigShareKey& k, const CSigShare& sigShare) {
-            if (doneSessions.count(sigShare.GetSignHash())) {
-                return;
-            }
-            if (quorumSigningManager->HasRecoveredSigForSession(sigShare.GetSignHash())) {
-                doneSessions.emplace(sigShare.GetSignHash());
-            }
+            allSessions.emplace(sigShare.GetSignHash());
         });
+        std::unordered_set<uint256, StaticSaltedHasher> doneSessions;
+        for (auto& signHash : allSessions) {
+            if (quorumSigningManager->HasRecoveredSigForSession(signHash)) {
+                doneSessions.emplace(signHash);
+            }
+        }
+
         for (auto& signHash : doneSessions) {
             RemoveSigSharesForSession(signHash);
         }
@@ -1220,21 +1257,24 @@ void CSigSharesManager::Cleanup()
             }
         }
         for (auto& signHash : timeoutSessions) {
-            size_t count = sigShares.CountForSignHash(signHash);
+            CSigShare oneSigShare;
+            std::set<uint16_t> members;
+            sigShares.ForEachForSignHash(signHash, [&](uint16_t quorumMember, const CSigShare& sigShare) {
+                if (members.empty()) {
+                    oneSigShare = sigShare;
+                }
+                members.emplace(quorumMember);
+            });
+            size_t count = members.size();
 
             if (count > 0) {
-                auto m = sigShares.GetAllForSignHash(signHash);
-                assert(m);
-
-                auto& oneSigShare = m->begin()->second;
-
                 std::string strMissingMembers;
                 if (LogAcceptCategory(BCLog::LLMQ_SIGS)) {
                     auto quorumIt = quorums.find(std::make_pair((Consensus::LLMQType)oneSigShare.llmqType, oneSigShare.quorumHash));
                     if (quorumIt != quorums.end()) {
                         auto& quorum = quorumIt->second;
                         for (size_t i = 0; i < quorum->members.size(); i++) {
-                            if (!m->count((uint16_t)i)) {
+                            if (!members.count((uint16_t)i)) {
                                 auto& dmn = quorum->members[i];
                                 strMissingMembers += strprintf("\n  %s", dmn->proTxHash.ToString());
                             }
@@ -1438,13 +1478,10 @@ void CSigSharesManager::ForceReAnnouncement(const CQuorumCPtr& quorum, Consensus
 {
     LOCK(cs);
     auto signHash = CLLMQUtils::BuildSignHash(llmqType, quorum->qc.quorumHash, id, msgHash);
-    auto sigs = sigShares.GetAllForSignHash(signHash);
-    if (sigs) {
-        for (auto& p : *sigs) {
-            // re-announce every sigshare to every node
-            sigSharesToAnnounce.Add(std::make_pair(signHash, p.first), true);
-        }
-    }
+    sigShares.ForEachForSignHash(signHash, [&](uint16_t quorumMember, const CSigShare&) {
+        // re-announce every sigshare to every node
+        sigSharesToAnnounce.Add(std::make_pair(signHash, quorumMember), true);
+    });
     for (auto& p : nodeStates) {
         CSigSharesNodeState& nodeState = p.second;
         auto session = nodeState.GetSessionBySignHash(signHash);
@@ -17,6 +17,8 @@
 
 #include "llmq/quorums.h"
 
+#include <deque>
+#include <map>
 #include <thread>
 #include <mutex>
 #include <unordered_map>
@@ -82,33 +84,75 @@ public:
     std::string ToString() const;
 };
 
+// Compact bitset with one bit per quorum member, packed into 64 bit words so that merging and diffing invs of
+// large quorums only needs a few word operations. The wire format is the same AUTOBITSET as used for std::vector<bool>
 class CSigSharesInv
 {
 public:
     uint32_t sessionId{(uint32_t)-1};
-    std::vector<bool> inv;
+
+private:
+    size_t size{0};
+    std::vector<uint64_t> words;
 
 public:
-    ADD_SERIALIZE_METHODS
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        uint64_t invSize = size;
+        std::vector<bool> inv(size);
+        ForEachSet([&](uint16_t quorumMember) {
+            inv[quorumMember] = true;
+        });
+
+        s << VARINT(sessionId);
+        s << COMPACTSIZE(invSize);
+        s << AUTOBITSET(inv, (size_t)invSize);
+    }
 
-    template<typename Stream, typename Operation>
-    inline void SerializationOp(Stream& s, Operation ser_action)
+    template<typename Stream>
+    void Unserialize(Stream& s)
     {
-        uint64_t invSize = inv.size();
+        uint64_t invSize;
+        std::vector<bool> inv;
 
-        READWRITE(VARINT(sessionId));
-        READWRITE(COMPACTSIZE(invSize));
-        READWRITE(AUTOBITSET(inv, (size_t)invSize));
+        s >> VARINT(sessionId);
+        s >> COMPACTSIZE(invSize);
+        s >> AUTOBITSET(inv, (size_t)invSize);
+
+        Init(inv.size());
+        for (size_t i = 0; i < inv.size(); i++) {
+            if (inv[i]) {
+                words[i / 64] |= (uint64_t)1 << (i % 64);
+            }
+        }
     }
 
     void Init(size_t size);
+    size_t Size() const { return size; }
+    bool IsInitialized() const { return size != 0; }
     bool IsSet(uint16_t quorumMember) const;
     void Set(uint16_t quorumMember, bool v);
     void SetAll(bool v);
     void Merge(const CSigSharesInv& inv2);
+    // clears all bits which are set in inv2
+    void AndNot(const CSigSharesInv& inv2);
 
     size_t CountSet() const;
     std::string ToString() const;
+
+    // calls f for every set bit, in ascending order
+    template<typename F>
+    void ForEachSet(F&& f) const
+    {
+        for (size_t i = 0; i < words.size(); i++) {
+            uint64_t w = words[i];
+            while (w) {
+                f((uint16_t)(i * 64 + __builtin_ctzll(w)));
+                w &= w - 1;
+            }
+        }
+    }
 };
 
 // sent through the message QBSIGSHARES as a vector of multiple batches
@@ -131,17 +175,89 @@ public:
     std::string ToInvString() const;
 };
 
+// Values of a single signing session, indexed by the quorum member. Sessions usually only see a fraction of the
+// members of large quorums, so this is sparse and ordered by quorum member
+template<typename T>
+class SigShareMemberMap
+{
+private:
+    std::map<uint16_t, T> entries;
+
+public:
+    bool Add(uint16_t quorumMember, const T& v)
+    {
+        return entries.emplace(quorumMember, v).second;
+    }
+
+    bool Erase(uint16_t quorumMember)
+    {
+        return entries.erase(quorumMember) != 0;
+    }
+
+    bool Has(uint16_t quorumMember) const
+    {
+        return entries.count(quorumMember) != 0;
+    }
+
+    T* Get(uint16_t quorumMember)
+    {
+        auto it = entries.find(quorumMember);
+        if (it == entries.end()) {
+            return nullptr;
+        }
+        return &it->second;
+    }
+
+    const T* GetFirst() const
+    {
+        if (entries.empty()) {
+            return nullptr;
+        }
+        return &entries.begin()->second;
+    }
+
+    size_t Size() const
+    {
+        return entries.size();
+    }
+
+    bool Empty() const
+    {
+        return entries.empty();
+    }
+
+    template<typename F>
+    void EraseIf(F&& f)
+    {
+        for (auto it = entries.begin(); it != entries.end(); ) {
+            if (f(it->first, it->second)) {
+                it = entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    template<typename F>
+    void ForEach(F&& f)
+    {
+        for (auto& p : entries) {
+            f(p.first, p.second);
+        }
+    }
+};
+
 template<typename T>
 class SigShareMap
 {
 private:
-    std::unordered_map<uint256, std::unordered_map<uint16_t, T>, StaticSaltedHasher> internalMap;
+    std::unordered_map<uint256, SigShareMemberMap<T>, StaticSaltedHasher> internalMap;
 
 public:
     bool Add(const SigShareKey& k, const T& v)
     {
         auto& m = internalMap[k.first];
-        return m.emplace(k.second, v).second;
+        return m.Add(k.second, v);
     }
 
     void Erase(const SigShareKey& k)
@@ -150,8 +266,8 @@ public:
         if (it == internalMap.end()) {
             return;
         }
-        it->second.erase(k.second);
-        if (it->second.empty()) {
+        it->second.Erase(k.second);
+        if (it->second.Empty()) {
             internalMap.erase(it);
         }
     }
@@ -167,7 +283,7 @@ public:
         if (it == internalMap.end()) {
             return false;
         }
-        return it->second.count(k.second) != 0;
+        return it->second.Has(k.second);
     }
 
     T* Get(const SigShareKey& k)
@@ -176,13 +292,7 @@ public:
         if (it == internalMap.end()) {
             return nullptr;
         }
-
-        auto jt = it->second.find(k.second);
-        if (jt == it->second.end()) {
-            return nullptr;
-        }
-
-        return &jt->second;
+        return it->second.Get(k.second);
     }
 
     T& GetOrAdd(const SigShareKey& k)
@@ -200,14 +310,14 @@ public:
         if (internalMap.empty()) {
             return nullptr;
         }
-        return &internalMap.begin()->second.begin()->second;
+        return internalMap.begin()->second.GetFirst();
     }
 
     size_t Size() const
     {
         size_t s = 0;
         for (auto& p : internalMap) {
-            s += p.second.size();
+            s += p.second.Size();
         }
         return s;
     }
@@ -218,7 +328,7 @@ public:
         if (it == internalMap.end()) {
             return 0;
         }
-        return it->second.size();
+        return it->second.Size();
     }
 
     bool Empty() const
@@ -226,15 +336,6 @@ public:
         return internalMap.empty();
     }
 
-    const std::unordered_map<uint16_t, T>* GetAllForSignHash(const uint256& signHash)
-    {
-        auto it = internalMap.find(signHash);
-        if (it == internalMap.end()) {
-            return nullptr;
-        }
-        return &it->second;
-    }
-
     void EraseAllForSignHash(const uint256& signHash)
     {
         internalMap.erase(signHash);
@@ -246,15 +347,11 @@ public:
         for (auto it = internalMap.begin(); it != internalMap.end(); ) {
             SigShareKey k;
             k.first = it->first;
-            for (auto jt = it->second.begin(); jt != it->second.end(); ) {
-                k.second = jt->first;
-                if (f(k, jt->second)) {
-                    jt = it->second.erase(jt);
-                } else {
-                    ++jt;
-                }
-            }
-            if (it->second.empty()) {
+            it->second.EraseIf([&](uint16_t quorumMember, T& v) {
+                k.second = quorumMember;
+                return f(k, v);
+            });
+            if (it->second.Empty()) {
                 it = internalMap.erase(it);
             } else {
                 ++it;
@@ -268,12 +365,109 @@ public:
         for (auto& p : internalMap) {
             SigShareKey k;
             k.first = p.first;
-            for (auto& p2 : p.second) {
-                k.second = p2.first;
-                f(k, p2.second);
-            }
+            p.second.ForEach([&](uint16_t quorumMember, T& v) {
+                k.second = quorumMember;
+                f(k, v);
+            });
+        }
+    }
+
+    template<typename F>
+    void ForEachForSignHash(const uint256& signHash, F&& f)
+    {
+        auto it = internalMap.find(signHash);
+        if (it == internalMap.end()) {
+            return;
+        }
+        it->second.ForEach(f);
+    }
+};
+
+/**
+ * A SigShareMap split into shards by signHash, each with its own lock. This allows share ingestion,
+ * announcement collection and recovery to run concurrently for different signing sessions.
+ * Values are only handed out as copies or inside the callbacks, which are invoked with the shard locked
+ * and thus must not acquire any other locks (holding CSigSharesManager::cs while calling in is fine).
+ */
+template<typename T>
+class ConcurrentSigShareMap
+{
+private:
+    static const size_t SHARD_COUNT = 16;
+
+    struct Shard
+    {
+        CCriticalSection cs;
+        SigShareMap<T> map;
+    };
+    mutable Shard shards[SHARD_COUNT];
+
+    Shard& GetShard(const uint256& signHash) const
+    {
+        return shards[signHash.GetCheapHash() % SHARD_COUNT];
+    }
+
+public:
+    bool Add(const SigShareKey& k, const T& v)
+    {
+        auto& shard = GetShard(k.first);
+        LOCK(shard.cs);
+        return shard.map.Add(k, v);
+    }
+
+    bool Has(const SigShareKey& k) const
+    {
+        auto& shard = GetShard(k.first);
+        LOCK(shard.cs);
+        return shard.map.Has(k);
+    }
+
+    bool Get(const SigShareKey& k, T& ret) const
+    {
+        auto& shard = GetShard(k.first);
+        LOCK(shard.cs);
+        const T* v = shard.map.Get(k);
+        if (!v) {
+            return false;
+        }
+        ret = *v;
+        return true;
+    }
+
+    size_t CountForSignHash(const uint256& signHash) const
+    {
+        auto& shard = GetShard(signHash);
+        LOCK(shard.cs);
+        return shard.map.CountForSignHash(signHash);
+    }
+
+    void EraseAllForSignHash(const uint256& signHash)
+    {
+        auto& shard = GetShard(signHash);
+        LOCK(shard.cs);
+        shard.map.EraseAllForSignHash(signHash);
+    }
+
+    template<typename F>
+    void ForEach(F&& f) const
+    {
+        for (auto& shard : shards) {
+            LOCK(shard.cs);
+            shard.map.ForEach([&](const SigShareKey& k, const T& v) {
+                f(k, v);
+            });
         }
     }
+
+    template<typename F>
+    void ForEachForSignHash(const uint256& signHash, F&& f) const
+    {
+        auto& shard = GetShard(signHash);
+        LOCK(shard.cs);
+        shard.map.ForEachForSignHash(signHash, [&](uint16_t quorumMember, const T& v) {
+            f(quorumMember, v);
+        });
+    }
 };
 
 class CSigSharesNodeState
@@ -307,8 +501,17 @@ public:
         CSigSharesInv requested;
         CSigSharesInv knows;
     };
+
+private:
+    // Sessions are allocated from a slot arena. The deque allocates them in chunks instead of one by one and never moves
+    // them, so pointers to a session stay valid until it's removed. Free slots have a null signHash and are reused for
+    // new sessions
+    std::deque<Session> sessionSlots;
+    std::vector<Session*> freeSessionSlots;
+
+public:
     // TODO limit number of sessions per node
-    std::unordered_map<uint256, Session, StaticSaltedHasher> sessions;
+    std::unordered_map<uint256, Session*, StaticSaltedHasher> sessions;
 
     std::unordered_map<uint32_t, Session*> sessionByRecvId;
     uint32_t nextSendSessionId{1};
@@ -325,6 +528,19 @@ public:
     bool GetSessionInfoByRecvId(uint32_t sessionId, SessionInfo& retInfo);
 
     void RemoveSession(const uint256& signHash);
+
+    template<typename F>
+    void ForEachSession(F&& f)
+    {
+        for (auto& s : sessionSlots) {
+            if (!s.signHash.IsNull()) {
+                f(s);
+            }
+        }
+    }
+
+private:
+    Session& CreateSession(const uint256& signHash);
 };
 
 class CSigSharesManager : public CRecoveredSigsListener
@@ -345,7 +561,9 @@ private:
     std::thread workThread;
     CThreadInterrupt workInterrupt;
 
-    SigShareMap<CSigShare> sigShares;
+    // has per shard locks, so it can be read without cs. Shares are only added and removed with cs held though, so
+    // that the session bookkeeping below is always consistent with it
+    ConcurrentSigShareMap<CSigShare> sigShares;
 
     // stores time of last receivedSigShare. Used to detect timeouts
     std::unordered_map<uint256, int64_t, StaticSaltedHasher> timeSeenForSessions;
@@ -12,12 +12,79 @@
 namespace llmq
 {
 
+static CQuorumMembersCache quorumMembersCache;
+
+CQuorumMembers::CQuorumMembers(std::vector<CDeterministicMNCPtr>&& _members) :
+    members(std::move(_members))
+{
+    memberIndexes.reserve(members.size());
+    for (size_t i = 0; i < members.size(); i++) {
+        memberIndexes.emplace(members[i]->proTxHash, (int)i);
+    }
+}
+
+int CQuorumMembers::GetMemberIndex(const uint256& proTxHash) const
+{
+    auto it = memberIndexes.find(proTxHash);
+    if (it == memberIndexes.end()) {
+        return -1;
+    }
+    return it->second;
+}
+
+bool CQuorumMembersCache::Get(const QuorumKey& key, CQuorumMembersCPtr& ret)
+{
+    LOCK(cs);
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        return false;
+    }
+    lru.splice(lru.begin(), lru, it->second.second);
+    ret = it->second.first;
+    return true;
+}
+
+void CQuorumMembersCache::Add(const QuorumKey& key, const CQuorumMembersCPtr& members)
+{
+    LOCK(cs);
+    if (entries.count(key)) {
+        // another thread was faster
+        return;
+    }
+    lru.emplace_front(key);
+    entries.emplace(key, std::make_pair(members, lru.begin()));
+    while (entries.size() > maxSize) {
+        entries.erase(lru.back());
+        lru.pop_back();
+    }
+}
+
+size_t CQuorumMembersCache::Size()
+{
+    LOCK(cs);
+    return entries.size();
+}
+
 std::vector<CDeterministicMNCPtr> CLLMQUtils::GetAllQuorumMembers(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum)
 {
+    return GetQuorumMembers(llmqType, pindexQuorum)->members;
+}
+
+CQuorumMembersCPtr CLLMQUtils::GetQuorumMembers(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum)
+{
+    CQuorumMembersCache::QuorumKey key(llmqType, pindexQuorum->GetBlockHash());
+
+    CQuorumMembersCPtr ret;
+    if (quorumMembersCache.Get(key, ret)) {
+        return ret;
+    }
+
     auto& params = Params().GetConsensus().llmqs.at(llmqType);
     auto allMns = deterministicMNManager->GetListForBlock(pindexQuorum);
-    auto modifier = ::SerializeHash(std::make_pair(llmqType, pindexQuorum->GetBlockHash()));
-    return allMns.CalculateQuorum(params.size, modifier);
+    auto modifier = ::SerializeHash(key);
+    ret = std::make_shared<const CQuorumMembers>(allMns.CalculateQuorum(params.size, modifier));
+    quorumMembersCache.Add(key, ret);
+    return ret;
 }
 
 uint256 CLLMQUtils::BuildCommitmentHash(Consensus::LLMQType llmqType, const uint256& blockHash, const std::vector<bool>& validMembers, const CBLSPublicKey& pubKey, const uint256& vvecHash)
@@ -45,29 +112,29 @@ std::set<uint256> CLLMQUtils::GetQuorumConnections(Consensus::LLMQType llmqType,
 {
     auto& params = Params().GetConsensus().llmqs.at(llmqType);
 
-    auto mns = GetAllQuorumMembers(llmqType, pindexQuorum);
+    auto quorumMembers = GetQuorumMembers(llmqType, pindexQuorum);
+    auto& mns = quorumMembers->members;
     std::set<uint256> result;
-    for (size_t i = 0; i < mns.size(); i++) {
+    // there can be no two members with the same proTxHash
+    int memberIdx = quorumMembers->GetMemberIndex(forMember);
+    if (memberIdx != -1) {
+        size_t i = (size_t)memberIdx;
         auto& dmn = mns[i];
-        if (dmn->proTxHash == forMember) {
-            // Connect to nodes at indexes (i+2^k)%n, where
-            //   k: 0..max(1, floor(log2(n-1))-1)
-            //   n: size of the quorum/ring
-            int gap = 1;
-            int gap_max = (int)mns.size() - 1;
-            int k = 0;
-            while ((gap_max >>= 1) || k <= 1) {
-                size_t idx = (i + gap) % mns.size();
-                auto& otherDmn = mns[idx];
-                if (otherDmn == dmn) {
-                    continue;
-                }
-                result.emplace(otherDmn->proTxHash);
-                gap <<= 1;
-                k++;
+        // Connect to nodes at indexes (i+2^k)%n, where
+        //   k: 0..max(1, floor(log2(n-1))-1)
+        //   n: size of the quorum/ring
+        int gap = 1;
+        int gap_max = (int)mns.size() - 1;
+        int k = 0;
+        while ((gap_max >>= 1) || k <= 1) {
+            size_t idx = (i + gap) % mns.size();
+            auto& otherDmn = mns[idx];
+            if (otherDmn == dmn) {
+                continue;
             }
-            // there can be no two members with the same proTxHash, so return early
-            break;
+            result.emplace(otherDmn->proTxHash);
+            gap <<= 1;
+            k++;
         }
     }
     return result;
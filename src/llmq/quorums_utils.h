@@ -7,19 +7,76 @@
 
 #include "consensus/params.h"
 #include "net.h"
+#include "saltedhasher.h"
 
 #include "evo/deterministicmns.h"
 
+#include <list>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 namespace llmq
 {
 
+// max number of quorums for which the members are kept in memory
+static const size_t QUORUM_MEMBERS_CACHE_SIZE = 256;
+
+/**
+ * The deterministically ordered members of a quorum, together with a proTxHash -> member index lookup.
+ * Only depends on the quorum block, so it never has to be invalidated.
+ */
+class CQuorumMembers
+{
+public:
+    std::vector<CDeterministicMNCPtr> members;
+    std::unordered_map<uint256, int, StaticSaltedHasher> memberIndexes;
+
+public:
+    explicit CQuorumMembers(std::vector<CDeterministicMNCPtr>&& _members);
+
+    // returns -1 if proTxHash is not a member
+    int GetMemberIndex(const uint256& proTxHash) const;
+};
+typedef std::shared_ptr<const CQuorumMembers> CQuorumMembersCPtr;
+
+/**
+ * LRU cache for the members of quorums, keyed by (llmqType, quorumHash). Entries never become stale as the members
+ * only depend on the quorum block. There is no member -> quorums index: the lookups by member (EnsureQuorumConnections
+ * and "quorum memberof") go through the quorums returned by ScanQuorums, which may reach further back than this cache,
+ * and checking one of them is a single CQuorumMembers::GetMemberIndex lookup.
+ */
+class CQuorumMembersCache
+{
+public:
+    typedef std::pair<Consensus::LLMQType, uint256> QuorumKey;
+
+private:
+    typedef std::list<QuorumKey> LruList;
+
+    const size_t maxSize;
+
+    CCriticalSection cs;
+    // most recently used quorum at the front
+    LruList lru;
+    std::unordered_map<QuorumKey, std::pair<CQuorumMembersCPtr, LruList::iterator>, StaticSaltedHasher> entries;
+
+public:
+    explicit CQuorumMembersCache(size_t _maxSize = QUORUM_MEMBERS_CACHE_SIZE) : maxSize(_maxSize) {}
+
+    bool Get(const QuorumKey& key, CQuorumMembersCPtr& ret);
+    // does nothing if key is already cached, evicts the least recently used quorum if the cache is full
+    void Add(const QuorumKey& key, const CQuorumMembersCPtr& members);
+    size_t Size();
+};
+
 class CLLMQUtils
 {
 public:
     // includes members which failed DKG
     static std::vector<CDeterministicMNCPtr> GetAllQuorumMembers(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum);
+    // same as GetAllQuorumMembers, but served from the members cache if possible
+    static CQuorumMembersCPtr GetQuorumMembers(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum);
 
     static uint256 BuildCommitmentHash(Consensus::LLMQType llmqType, const uint256& blockHash, const std::vector<bool>& validMembers, const CBLSPublicKey& pubKey, const uint256& vvecHash);
     static uint256 BuildSignHash(Consensus::LLMQType llmqType, const uint256& quorumHash, const uint256& id, const uint256& msgHash);
@@ -42,6 +42,8 @@
 #include <queue>
 #include <utility>
 
+#include <boost/bind.hpp>
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // genixMiner
@@ -103,6 +105,297 @@ static BlockAssembler::Options DefaultOptions(const CChainParams& params)
 
 BlockAssembler::BlockAssembler(const CChainParams& params) : BlockAssembler(params, DefaultOptions(params)) {}
 
+CBlockTemplateSelection::CBlockTemplateSelection(CTxMemPool& _pool) :
+    pool(_pool)
+{
+    connAdded = pool.NotifyEntryAdded.connect(boost::bind(&CBlockTemplateSelection::NotifyEntryAdded, this, _1));
+    connRemoved = pool.NotifyEntryRemoved.connect(boost::bind(&CBlockTemplateSelection::NotifyEntryRemoved, this, _1, _2));
+    connPrioritised = pool.NotifyEntryPrioritised.connect(boost::bind(&CBlockTemplateSelection::NotifyEntryPrioritised, this, _1));
+}
+
+void CBlockTemplateSelection::NotifyEntryAdded(CTransactionRef tx)
+{
+    LOCK(cs);
+    if (!fValid) {
+        return;
+    }
+    if (vAdded.size() >= MAX_PENDING_TXS) {
+        // nobody asked for a template in a while, a full selection is cheaper than tracking all of them
+        Invalidate();
+        return;
+    }
+    // Catch what would make UpdateFromSelection() fail here already, so that CanUpdate() doesn't skip the throttling
+    // of full selections. Parents which were added after the last template are appended before this tx
+    for (const auto& txin : tx->vin) {
+        const uint256& hashParent = txin.prevout.hash;
+        if (!setSelected.count(hashParent) && !setAdded.count(hashParent) && pool.exists(hashParent)) {
+            Invalidate();
+            return;
+        }
+    }
+    nAddedSize += ::GetSerializeSize(*tx, SER_NETWORK, PROTOCOL_VERSION);
+    if (nBlockSize + nAddedSize >= nBlockMaxSize) {
+        Invalidate();
+        return;
+    }
+    setAdded.insert(tx->GetHash());
+    vAdded.emplace_back(std::move(tx));
+}
+
+void CBlockTemplateSelection::NotifyEntryRemoved(CTransactionRef tx, MemPoolRemovalReason reason)
+{
+    LOCK(cs);
+    if (fValid && setSelected.count(tx->GetHash())) {
+        Invalidate();
+    }
+}
+
+void CBlockTemplateSelection::NotifyEntryPrioritised(CTransactionRef tx)
+{
+    LOCK(cs);
+    if (fValid) {
+        Invalidate();
+    }
+}
+
+void CBlockTemplateSelection::Invalidate()
+{
+    AssertLockHeld(cs);
+    fValid = false;
+    vQcTxHashes.clear();
+    vSelected.clear();
+    setSelected.clear();
+    fBlockFull = false;
+    fIncomplete = false;
+    vDeferred.clear();
+    vAdded.clear();
+    setAdded.clear();
+    nAddedSize = 0;
+}
+
+bool CBlockTemplateSelection::CanUpdate() const
+{
+    LOCK(cs);
+    return fValid && !fBlockFull && !fIncomplete;
+}
+
+uint64_t CBlockTemplateSelection::GetIncrementalUpdates() const
+{
+    LOCK(cs);
+    return nIncrementalUpdates;
+}
+
+std::unique_ptr<CBlockTemplateNotifier> g_blockTemplateNotifier;
+
+CBlockTemplateNotifier::CBlockTemplateNotifier(CTxMemPool& pool) :
+    mempool(pool),
+    selection(pool)
+{
+}
+
+CBlockTemplateNotifier::~CBlockTemplateNotifier()
+{
+    Stop();
+}
+
+void CBlockTemplateNotifier::Start(bool fPublishIn)
+{
+    std::lock_guard<std::mutex> lock(cs);
+    fPublish = fPublishIn;
+    if (fPublish && !updateThread.joinable()) {
+        updateThread = std::thread(&TraceThread<std::function<void()> >, "blocktmpl", std::function<void()>(std::bind(&CBlockTemplateNotifier::ThreadUpdate, this)));
+    }
+}
+
+void CBlockTemplateNotifier::Interrupt()
+{
+    std::lock_guard<std::mutex> lock(cs);
+    fInterrupted = true;
+    ++nEvents;
+    cond.notify_all();
+    condUpdate.notify_all();
+}
+
+void CBlockTemplateNotifier::Stop()
+{
+    Interrupt();
+    if (updateThread.joinable()) {
+        updateThread.join();
+    }
+}
+
+std::shared_ptr<const CBlockTemplate> CBlockTemplateNotifier::GetBlockTemplate(const CBlockIndex*& pindexPrevRet, unsigned int& nTransactionsUpdatedRet)
+{
+    AssertLockHeld(cs_main);
+
+    if (pindexPrev != chainActive.Tip() ||
+        (mempool.GetTransactionsUpdated() != nTransactionsUpdated && (GetTime() - nTimeStart > 5 || selection.CanUpdate())))
+    {
+        // Clear pindexPrev so future calls make a new block, despite any failures from here on
+        pindexPrev = nullptr;
+
+        // Store the chainActive.Tip() used before CreateNewBlock, to avoid races
+        nTransactionsUpdated = mempool.GetTransactionsUpdated();
+        const CBlockIndex* pindexPrevNew = chainActive.Tip();
+        nTimeStart = GetTime();
+
+        // Create new block
+        CScript scriptDummy = CScript() << OP_TRUE;
+        pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptDummy, &selection);
+        if (!pblocktemplate)
+            return nullptr;
+
+        // Need to update only after we know CreateNewBlock succeeded
+        pindexPrev = pindexPrevNew;
+
+        // Published on updateThread, so that subscribers aren't notified with cs_main held
+        std::lock_guard<std::mutex> lock(cs);
+        if (fPublish && !fInterrupted) {
+            pblocktemplateToPublish = pblocktemplate;
+            condUpdate.notify_all();
+        }
+    }
+
+    pindexPrevRet = pindexPrev;
+    nTransactionsUpdatedRet = nTransactionsUpdated;
+    return pblocktemplate;
+}
+
+bool CBlockTemplateNotifier::WaitForNewTemplate(const uint256& hashWatchedChain, unsigned int nTransactionsUpdatedLast)
+{
+    auto checktxtime = std::chrono::steady_clock::now() + std::chrono::minutes(1);
+    bool fWaitingForTxs = false;
+
+    std::unique_lock<std::mutex> lock(cs);
+    while (!fInterrupted) {
+        // The mempool lock is taken while notifying us about new txs, so don't hold cs while checking for them.
+        // Anything that happens after this is seen through nEvents.
+        uint64_t nEventsSeen = nEvents;
+        lock.unlock();
+        bool fChanged = chainActive.Tip()->GetBlockHash() != hashWatchedChain ||
+                        (fWaitingForTxs && mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast);
+        lock.lock();
+        if (fChanged) {
+            break;
+        }
+        if (nEvents != nEventsSeen) {
+            continue;
+        }
+
+        if (fWaitingForTxs) {
+            // Not every mempool update comes with a notification (e.g. InstantSend locks), so check again every 10 seconds
+            cond.wait_for(lock, std::chrono::seconds(10));
+        } else if (cond.wait_until(lock, checktxtime) == std::cv_status::timeout) {
+            fWaitingForTxs = true;
+            nTxWaiters++;
+        }
+    }
+    if (fWaitingForTxs) {
+        nTxWaiters--;
+    }
+    return !fInterrupted;
+}
+
+bool CBlockTemplateNotifier::ScheduleUpdate(int64_t nDelayMillis)
+{
+    if (!fPublish || fInterrupted) {
+        return false;
+    }
+    int64_t nTime = GetTimeMillis() + nDelayMillis;
+    if (nUpdateTime == 0 || nTime < nUpdateTime) {
+        nUpdateTime = nTime;
+        condUpdate.notify_all();
+    }
+    return true;
+}
+
+void CBlockTemplateNotifier::ScheduleTxUpdate()
+{
+    // Coalesce bursts of mempool changes into one template
+    if (!fTxUpdateScheduled) {
+        fTxUpdateScheduled = ScheduleUpdate(1000);
+    }
+}
+
+void CBlockTemplateNotifier::UpdateBlockTemplate()
+{
+    // Same as getblocktemplate, don't hand out templates which might miss superblock payments
+    if (!masternodeSync.IsSynced()) {
+        return;
+    }
+
+    bool fStale;
+    try {
+        LOCK(cs_main);
+        const CBlockIndex* pindexPrevTmp;
+        unsigned int nTransactionsUpdatedTmp;
+        if (!GetBlockTemplate(pindexPrevTmp, nTransactionsUpdatedTmp)) {
+            return;
+        }
+        // Mempool changes within 5 seconds of the last template aren't always picked up, try again later
+        fStale = nTransactionsUpdatedTmp != mempool.GetTransactionsUpdated();
+    } catch (const std::exception& e) {
+        LogPrintf("CBlockTemplateNotifier::%s -- failed to create block template: %s\n", __func__, e.what());
+        return;
+    }
+
+    if (fStale) {
+        std::lock_guard<std::mutex> lock(cs);
+        ScheduleTxUpdate();
+    }
+}
+
+void CBlockTemplateNotifier::ThreadUpdate()
+{
+    std::unique_lock<std::mutex> lock(cs);
+    while (!fInterrupted) {
+        if (pblocktemplateToPublish) {
+            std::shared_ptr<const CBlockTemplate> pblocktemplateNew = std::move(pblocktemplateToPublish);
+            pblocktemplateToPublish = nullptr;
+            lock.unlock();
+            GetMainSignals().NewBlockTemplate(pblocktemplateNew);
+            lock.lock();
+            continue;
+        }
+
+        if (nUpdateTime == 0) {
+            condUpdate.wait(lock);
+            continue;
+        }
+        int64_t nNow = GetTimeMillis();
+        if (nNow < nUpdateTime) {
+            condUpdate.wait_for(lock, std::chrono::milliseconds(nUpdateTime - nNow));
+            continue;
+        }
+        nUpdateTime = 0;
+        fTxUpdateScheduled = false;
+
+        lock.unlock();
+        UpdateBlockTemplate();
+        lock.lock();
+    }
+}
+
+void CBlockTemplateNotifier::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    std::lock_guard<std::mutex> lock(cs);
+    ++nEvents;
+    cond.notify_all();
+    if (!fInitialDownload) {
+        ScheduleUpdate(0);
+    }
+}
+
+void CBlockTemplateNotifier::TransactionAddedToMempool(const CTransactionRef& tx, int64_t nAcceptTime)
+{
+    std::lock_guard<std::mutex> lock(cs);
+    if (nTxWaiters > 0) {
+        ++nEvents;
+        cond.notify_all();
+    }
+    ScheduleTxUpdate();
+}
+
 void BlockAssembler::resetBlock()
 {
     inBlock.clear();
@@ -114,9 +407,13 @@ void BlockAssembler::resetBlock()
     // These counters do not include coinbase tx
     nBlockTx = 0;
     nFees = 0;
+
+    fBlockFull = false;
+    fSelectionIncomplete = false;
+    vDeferredTx.clear();
 }
 
-std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn)
+std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, CBlockTemplateSelection* selection)
 {
     int64_t nTimeStart = GetTimeMicros();
 
@@ -154,6 +451,7 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
                        ? nMedianTimePast
                        : pblock->GetBlockTime();
 
+    std::vector<uint256> vQcTxHashes;
     if (fDIP0003Active_context) {
         for (auto& p : chainparams.GetConsensus().llmqs) {
             CTransactionRef qcTx;
@@ -163,13 +461,21 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
                 pblocktemplate->vTxSigOps.emplace_back(0);
                 nBlockSize += qcTx->GetTotalSize();
                 ++nBlockTx;
+                vQcTxHashes.emplace_back(qcTx->GetHash());
             }
         }
     }
 
     int nPackagesSelected = 0;
     int nDescendantsUpdated = 0;
-    addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    bool fUpdatedSelection = selection && UpdateFromSelection(*selection, pindexPrev, vQcTxHashes);
+    if (!fUpdatedSelection) {
+        size_t nFirstTx = pblock->vtx.size();
+        addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+        if (selection) {
+            StoreSelection(*selection, pindexPrev, vQcTxHashes, nFirstTx);
+        }
+    }
 
     int64_t nTime1 = GetTimeMicros();
 
@@ -238,11 +544,15 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
     CValidationState state;
     if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
+        if (selection) {
+            LOCK(selection->cs);
+            selection->Invalidate();
+        }
         throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
     }
     int64_t nTime2 = GetTimeMicros();
 
-    LogPrint(BCLog::BENCHMARK, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
+    LogPrint(BCLog::BENCHMARK, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants%s), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, fUpdatedSelection ? ", updated previous selection" : "", 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
 
     return std::move(pblocktemplate);
 }
@@ -441,6 +751,7 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
         }
 
         if (!TestPackage(packageSize, packageSigOps)) {
+            fBlockFull = true;
             if (fUsingModified) {
                 // Since we always look at the best entry in mapModifiedTx,
                 // we must erase failed entries so that we can consider the
@@ -468,6 +779,12 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
 
         // Test if all tx's are Final and safe
         if (!TestPackageTransactions(ancestors)) {
+            if (ancestors.size() == 1) {
+                // Only depends on txs in the block, so it can be retried on its own when updating the selection
+                vDeferredTx.emplace_back(iter->GetSharedTx());
+            } else {
+                fSelectionIncomplete = true;
+            }
             if (fUsingModified) {
                 mapModifiedTx.get<ancestor_score>().erase(modit);
                 failedTx.insert(iter);
@@ -495,6 +812,141 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
     }
 }
 
+bool BlockAssembler::AddSingleTx(CTxMemPool::txiter iter, CBlockTemplateSelection& selection)
+{
+    for (CTxMemPool::txiter parent : mempool.GetMemPoolParents(iter)) {
+        if (!selection.setSelected.count(parent->GetTx().GetHash())) {
+            // This might make an unselected parent worth mining
+            return false;
+        }
+    }
+
+    // All ancestors are in the block, so the tx forms a package on its own
+    if (iter->GetModifiedFee() < blockMinFeeRate.GetFee(iter->GetTxSize())) {
+        // Only a child could make it worth mining, and that child depends on an unselected tx
+        return true;
+    }
+
+    CTxMemPool::setEntries package;
+    package.insert(iter);
+    if (!TestPackageTransactions(package)) {
+        selection.vDeferred.emplace_back(iter->GetSharedTx());
+        return true;
+    }
+
+    if (fBlockFull || !TestPackage(iter->GetTxSize(), iter->GetSigOpCount())) {
+        // It competes with the selected packages for the remaining space
+        return false;
+    }
+
+    AddToBlock(iter);
+    selection.vSelected.push_back({iter->GetSharedTx(), iter->GetFee(), iter->GetSigOpCount()});
+    selection.setSelected.insert(iter->GetTx().GetHash());
+    return true;
+}
+
+// Instead of running package selection again, this takes the transactions selected for the previous template and
+// appends the transactions added to the mempool since then. This gives the same set of transactions as a full
+// selection as long as the block isn't full and every new transaction only depends on selected ones, in which case
+// it forms a package on its own. Everything else makes the caller fall back to addPackageTxs().
+bool BlockAssembler::UpdateFromSelection(CBlockTemplateSelection& selection, const CBlockIndex* pindexPrev, const std::vector<uint256>& vQcTxHashes)
+{
+    AssertLockHeld(mempool.cs);
+    LOCK(selection.cs);
+
+    if (!selection.fValid ||
+            selection.fIncomplete ||
+            selection.hashPrevBlock != pindexPrev->GetBlockHash() ||
+            selection.nBlockMaxSize != nBlockMaxSize ||
+            selection.blockMinFeeRate != blockMinFeeRate ||
+            selection.vQcTxHashes != vQcTxHashes) {
+        selection.Invalidate();
+        return false;
+    }
+
+    // CTxMemPool::clear() doesn't notify about the removed txs
+    for (const auto& s : selection.vSelected) {
+        if (!mempool.mapTx.count(s.tx->GetHash())) {
+            selection.Invalidate();
+            return false;
+        }
+    }
+
+    const size_t nFirstTx = pblock->vtx.size();
+    const uint64_t nBlockSizeBefore = nBlockSize;
+    const uint64_t nBlockTxBefore = nBlockTx;
+    const unsigned int nBlockSigOpsBefore = nBlockSigOps;
+
+    for (const auto& s : selection.vSelected) {
+        pblock->vtx.emplace_back(s.tx);
+        pblocktemplate->vTxFees.emplace_back(s.nFee);
+        pblocktemplate->vTxSigOps.emplace_back(s.nSigOps);
+    }
+    nBlockSize = selection.nBlockSize;
+    nBlockTx = selection.nBlockTx;
+    nBlockSigOps = selection.nBlockSigOps;
+    nFees = selection.nFees;
+    fBlockFull = selection.fBlockFull;
+
+    // Deferred txs first, they were seen before the new ones
+    std::vector<CTransactionRef> vCandidates;
+    vCandidates.swap(selection.vDeferred);
+    vCandidates.insert(vCandidates.end(), selection.vAdded.begin(), selection.vAdded.end());
+    selection.vAdded.clear();
+    selection.setAdded.clear();
+    selection.nAddedSize = 0;
+
+    for (const auto& tx : vCandidates) {
+        CTxMemPool::txiter it = mempool.mapTx.find(tx->GetHash());
+        if (it == mempool.mapTx.end() || selection.setSelected.count(tx->GetHash())) {
+            continue;
+        }
+        if (!AddSingleTx(it, selection)) {
+            selection.Invalidate();
+            pblock->vtx.resize(nFirstTx);
+            pblocktemplate->vTxFees.resize(nFirstTx);
+            pblocktemplate->vTxSigOps.resize(nFirstTx);
+            nBlockSize = nBlockSizeBefore;
+            nBlockTx = nBlockTxBefore;
+            nBlockSigOps = nBlockSigOpsBefore;
+            nFees = 0;
+            fBlockFull = false;
+            inBlock.clear();
+            return false;
+        }
+    }
+
+    selection.nBlockSize = nBlockSize;
+    selection.nBlockTx = nBlockTx;
+    selection.nBlockSigOps = nBlockSigOps;
+    selection.nFees = nFees;
+    selection.nIncrementalUpdates++;
+    return true;
+}
+
+void BlockAssembler::StoreSelection(CBlockTemplateSelection& selection, const CBlockIndex* pindexPrev, const std::vector<uint256>& vQcTxHashes, size_t nFirstTx)
+{
+    LOCK(selection.cs);
+    selection.Invalidate();
+
+    selection.hashPrevBlock = pindexPrev->GetBlockHash();
+    selection.nBlockMaxSize = nBlockMaxSize;
+    selection.blockMinFeeRate = blockMinFeeRate;
+    selection.vQcTxHashes = vQcTxHashes;
+    for (size_t i = nFirstTx; i < pblock->vtx.size(); i++) {
+        selection.vSelected.push_back({pblock->vtx[i], pblocktemplate->vTxFees[i], pblocktemplate->vTxSigOps[i]});
+        selection.setSelected.insert(pblock->vtx[i]->GetHash());
+    }
+    selection.nBlockSize = nBlockSize;
+    selection.nBlockTx = nBlockTx;
+    selection.nBlockSigOps = nBlockSigOps;
+    selection.nFees = nFees;
+    selection.fBlockFull = fBlockFull;
+    selection.fIncomplete = fSelectionIncomplete;
+    selection.vDeferred = std::move(vDeferredTx);
+    selection.fValid = true;
+}
+
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
@@ -8,9 +8,14 @@
 
 #include "primitives/block.h"
 #include "txmempool.h"
+#include "validationinterface.h"
 
 #include <stdint.h>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
 #include "boost/multi_index_container.hpp"
 #include "boost/multi_index/ordered_index.hpp"
 
@@ -131,6 +136,77 @@ struct update_for_parent_inclusion
     CTxMemPool::txiter iter;
 };
 
+/**
+ * The transactions selected for the last block template, kept up to date with the mempool through its
+ * notifications. As long as the tip doesn't change, BlockAssembler::CreateNewBlock() applies the mempool changes
+ * since the last template to this selection instead of running package selection over the whole mempool again.
+ * Changes which could alter the choice between packages (a selected tx is removed, a new tx depends on an
+ * unselected one, fees are prioritised or the block is already full) invalidate the selection, so that the next
+ * template does a full selection again.
+ */
+class CBlockTemplateSelection
+{
+    friend class BlockAssembler;
+
+private:
+    static const size_t MAX_PENDING_TXS = 10000;
+
+    struct SelectedTx {
+        CTransactionRef tx;
+        CAmount nFee;
+        int64_t nSigOps;
+    };
+
+    mutable CCriticalSection cs;
+
+    // Parameters the selection was made for
+    bool fValid{false};
+    uint256 hashPrevBlock;
+    unsigned int nBlockMaxSize{0};
+    CFeeRate blockMinFeeRate;
+    std::vector<uint256> vQcTxHashes;
+
+    // Selected transactions, in block order, and the state of the block after adding them
+    std::vector<SelectedTx> vSelected;
+    std::unordered_set<uint256, SaltedTxidHasher> setSelected;
+    uint64_t nBlockSize{0};
+    uint64_t nBlockTx{0};
+    unsigned int nBlockSigOps{0};
+    CAmount nFees{0};
+    // Some package didn't fit anymore, so new transactions might displace selected ones
+    bool fBlockFull{false};
+    // Some package with unselected ancestors failed TestPackageTransactions and could be selected later
+    bool fIncomplete{false};
+    // Transactions which only depend on selected ones, but failed TestPackageTransactions (e.g. not yet safe in
+    // regard to ChainLocks). They are retried on every update
+    std::vector<CTransactionRef> vDeferred;
+
+    // Transactions added to the mempool since the last template
+    std::vector<CTransactionRef> vAdded;
+    std::unordered_set<uint256, SaltedTxidHasher> setAdded;
+    uint64_t nAddedSize{0};
+
+    uint64_t nIncrementalUpdates{0};
+
+    CTxMemPool& pool;
+    boost::signals2::scoped_connection connAdded;
+    boost::signals2::scoped_connection connRemoved;
+    boost::signals2::scoped_connection connPrioritised;
+
+    void NotifyEntryAdded(CTransactionRef tx);
+    void NotifyEntryRemoved(CTransactionRef tx, MemPoolRemovalReason reason);
+    void NotifyEntryPrioritised(CTransactionRef tx);
+    void Invalidate();
+
+public:
+    explicit CBlockTemplateSelection(CTxMemPool& pool);
+
+    /** Returns false if the next template will certainly need a full package selection */
+    bool CanUpdate() const;
+    /** Number of templates which were built by updating this selection */
+    uint64_t GetIncrementalUpdates() const;
+};
+
 /** Generate a new block, without valid proof-of-work */
 class BlockAssembler
 {
@@ -150,6 +226,9 @@ private:
     unsigned int nBlockSigOps;
     CAmount nFees;
     CTxMemPool::setEntries inBlock;
+    bool fBlockFull;
+    bool fSelectionIncomplete;
+    std::vector<CTransactionRef> vDeferredTx;
 
     // Chain context for the block
     int nHeight;
@@ -166,8 +245,10 @@ public:
     BlockAssembler(const CChainParams& params);
     BlockAssembler(const CChainParams& params, const Options& options);
 
-    /** Construct a new block template with coinbase to scriptPubKeyIn */
-    std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn);
+    /** Construct a new block template with coinbase to scriptPubKeyIn. If selection is given, the transactions
+     *  selected for the previous template are reused and updated when possible, and the transactions selected for
+     *  this template are stored in it */
+    std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, CBlockTemplateSelection* selection = nullptr);
 
 private:
     // utility functions
@@ -201,8 +282,89 @@ private:
       * state updated assuming given transactions are inBlock. Returns number
       * of updated descendants. */
     int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx);
+
+    // Methods for reusing the selection of a previous template
+    /** Add the transactions of selection to the block and update it with the mempool changes since it was made.
+      * Returns false (and invalidates selection) if a full package selection is needed instead. */
+    bool UpdateFromSelection(CBlockTemplateSelection& selection, const CBlockIndex* pindexPrev, const std::vector<uint256>& vQcTxHashes);
+    /** Try to add a transaction which only depends on transactions in the block, on its own */
+    bool AddSingleTx(CTxMemPool::txiter iter, CBlockTemplateSelection& selection);
+    /** Store the transactions selected by addPackageTxs(), starting at vtx[nFirstTx], in selection */
+    void StoreSelection(CBlockTemplateSelection& selection, const CBlockIndex* pindexPrev, const std::vector<uint256>& vQcTxHashes, size_t nFirstTx);
 };
 
+/**
+ * Owns the block template handed out by getblocktemplate. It is built at most once per chain tip and mempool
+ * update and shared by all callers. If publishing is enabled, templates are also built in the background and
+ * published through CValidationInterface::NewBlockTemplate, both on a dedicated thread and without cs_main held.
+ * Long polling clients wait here for a tip or mempool change instead of polling for one.
+ */
+class CBlockTemplateNotifier : public CValidationInterface
+{
+private:
+    CTxMemPool& mempool;
+    // Lets us update the previous template with new mempool txs instead of doing a full package selection, so
+    // such updates don't need to wait for the 5 seconds
+    CBlockTemplateSelection selection;
+
+    // The current template, guarded by cs_main
+    std::shared_ptr<const CBlockTemplate> pblocktemplate;
+    const CBlockIndex* pindexPrev{nullptr};
+    unsigned int nTransactionsUpdated{0};
+    int64_t nTimeStart{0};
+
+    std::mutex cs;
+    std::condition_variable cond;
+    // Build and publish new templates on updateThread (for ZMQ subscribers)
+    bool fPublish{false};
+    std::thread updateThread;
+    std::condition_variable condUpdate;
+    // Time (in ms) at which updateThread builds a new template, 0 if there's nothing to do
+    int64_t nUpdateTime{0};
+    // The latest new template, waiting to be published by updateThread
+    std::shared_ptr<const CBlockTemplate> pblocktemplateToPublish;
+    bool fTxUpdateScheduled{false};
+    bool fInterrupted{false};
+    // Long polling clients waiting for mempool changes
+    int nTxWaiters{0};
+    // Bumped for every wake up of the waiting clients
+    uint64_t nEvents{0};
+
+    bool ScheduleUpdate(int64_t nDelayMillis);
+    void ScheduleTxUpdate();
+    void UpdateBlockTemplate();
+    void ThreadUpdate();
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    void TransactionAddedToMempool(const CTransactionRef& tx, int64_t nAcceptTime) override;
+
+public:
+    explicit CBlockTemplateNotifier(CTxMemPool& pool);
+    ~CBlockTemplateNotifier();
+
+    /** Starts the thread which builds and publishes new templates after every tip or mempool change if fPublish is set */
+    void Start(bool fPublish);
+    /** Wakes up and returns all waiting clients, and makes new ones return immediately */
+    void Interrupt();
+    /** Interrupts and waits for the publishing thread to exit */
+    void Stop();
+
+    /**
+     * Returns the current template, after building a new one if the tip changed, or if the mempool changed and
+     * the template is older than 5 seconds or can be cheaply updated. Returns nullptr if it can't be built.
+     */
+    std::shared_ptr<const CBlockTemplate> GetBlockTemplate(const CBlockIndex*& pindexPrevRet, unsigned int& nTransactionsUpdatedRet);
+
+    /**
+     * Waits until the tip isn't hashWatchedChain anymore, or until a minute has passed (BIP22) and the mempool was
+     * updated since nTransactionsUpdatedLast. Returns false if interrupted.
+     */
+    bool WaitForNewTemplate(const uint256& hashWatchedChain, unsigned int nTransactionsUpdatedLast);
+};
+
+extern std::unique_ptr<CBlockTemplateNotifier> g_blockTemplateNotifier;
+
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
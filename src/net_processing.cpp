@@ -10,6 +10,7 @@
 #include "blockencodings.h"
 #include "chainparams.h"
 #include "consensus/validation.h"
+#include "ctpl.h"
 #include "hash.h"
 #include "init.h"
 #include "validation.h"
@@ -133,6 +134,42 @@ namespace {
     std::unique_ptr<CRollingBloomFilter> recentRejects;
     uint256 hashRecentRejectsChainTip;
 
+    /**
+     * Threads verifying the signatures of received transactions before they are
+     * passed to AcceptToMemoryPool, so that most of the work is done without
+     * cs_main and outside of the message handler thread. nullptr if there is
+     * no script check concurrency.
+     */
+    std::unique_ptr<ctpl::thread_pool> txPreValidationPool;
+    std::atomic<int> nTxPreValidationQueued{0};
+
+    /** A received transaction, waiting for pre-validation before it is accepted */
+    struct PendingTx {
+        std::string strCommand;
+        CTransactionRef tx;
+        CPrivateSendBroadcastTx dstx;
+        int nInvType;
+        std::atomic<bool> fPreValidated{false};
+    };
+
+    /**
+     * Received transactions per peer, accepted in the order they arrived once
+     * the first one is pre-validated. Protected by cs_pendingTxs.
+     */
+    CCriticalSection cs_pendingTxs;
+    std::map<NodeId, std::deque<std::shared_ptr<PendingTx>>> mapPendingTxs;
+    /** Number of pending transactions per hash, these count as already had. Protected by cs_pendingTxs. */
+    std::map<uint256, int> mapPendingTxHashes;
+
+    void ErasePendingTxHash(const uint256& hash)
+    {
+        AssertLockHeld(cs_pendingTxs);
+        auto it = mapPendingTxHashes.find(hash);
+        if (it != mapPendingTxHashes.end() && --it->second == 0) {
+            mapPendingTxHashes.erase(it);
+        }
+    }
+
     /** Blocks that are in flight, and that are in the queue to be downloaded. Protected by cs_main. */
     struct QueuedBlock {
         uint256 hash;
@@ -623,6 +660,17 @@ void PeerLogicValidation::FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTim
 
     mapNodeState.erase(nodeid);
 
+    {
+        LOCK(cs_pendingTxs);
+        auto it = mapPendingTxs.find(nodeid);
+        if (it != mapPendingTxs.end()) {
+            for (const auto& pendingTx : it->second) {
+                ErasePendingTxHash(pendingTx->tx->GetHash());
+            }
+            mapPendingTxs.erase(it);
+        }
+    }
+
     if (mapNodeState.empty()) {
         // Do a consistency check after the last peer is removed.
         assert(mapBlocksInFlight.empty());
@@ -835,6 +883,11 @@ PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, CScheduler &schedu
     // Initialize global variables that cannot be constructed at startup.
     recentRejects.reset(new CRollingBloomFilter(120000, 0.000001));
 
+    if (nScriptCheckThreads) {
+        txPreValidationPool.reset(new ctpl::thread_pool(std::min(nScriptCheckThreads, MAX_TX_PREVALIDATION_THREADS)));
+        RenameThreadPool(*txPreValidationPool, "genix-txprecheck");
+    }
+
     const Consensus::Params& consensusParams = Params().GetConsensus();
     // Stale tip checking and peer eviction are on two different timers, but we
     // don't want them to get out of sync due to drift in the scheduler, so we
@@ -844,6 +897,19 @@ PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, CScheduler &schedu
     scheduler.scheduleEvery(std::bind(&PeerLogicValidation::CheckForStaleTipAndEvictPeers, this, consensusParams), EXTRA_PEER_CHECK_INTERVAL * 1000);
 }
 
+PeerLogicValidation::~PeerLogicValidation()
+{
+    if (txPreValidationPool) {
+        txPreValidationPool->clear_queue();
+        txPreValidationPool->stop(true);
+        txPreValidationPool.reset();
+        nTxPreValidationQueued = 0;
+    }
+    LOCK(cs_pendingTxs);
+    mapPendingTxs.clear();
+    mapPendingTxHashes.clear();
+}
+
 void PeerLogicValidation::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const std::vector<CTransactionRef>& vtxConflicted) {
     LOCK2(cs_main, g_cs_orphans);
 
@@ -1030,6 +1096,12 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
                 if (mapOrphanTransactions.count(inv.hash)) return true;
             }
 
+            {
+                // Received, but still being pre-validated
+                LOCK(cs_pendingTxs);
+                if (mapPendingTxHashes.count(inv.hash)) return true;
+            }
+
             // When we receive an islock for a previously rejected transaction, we have to
             // drop the first-seen tx (which such a locked transaction was conflicting with)
             // and re-request the locked transaction (which did not make it into the mempool
@@ -1735,6 +1807,160 @@ void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_se
     }
 }
 
+/**
+ * Try to accept a transaction received from pfrom to the mempool, relaying it
+ * on success and keeping it as orphan if inputs are missing.
+ */
+static void AcceptTxFromPeer(CNode* pfrom, const std::string& strCommand, const CTransactionRef& ptx, const CPrivateSendBroadcastTx& dstx, int nInvType, CConnman* connman)
+{
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    const CTransaction& tx = *ptx;
+    CInv inv(nInvType, tx.GetHash());
+
+    LOCK2(cs_main, g_cs_orphans);
+
+    bool fMissingInputs = false;
+    CValidationState state;
+
+    if (!AlreadyHave(inv) && AcceptToMemoryPool(mempool, state, ptx, true, &fMissingInputs)) {
+        // Process custom txes, this changes AlreadyHave to "true"
+        if (nInvType == MSG_DSTX) {
+            LogPrint(BCLog::PRIVATESEND, "DSTX -- Masternode transaction accepted, txid=%s, peer=%d\n",
+                    tx.GetHash().ToString(), pfrom->GetId());
+            CPrivateSend::AddDSTX(dstx);
+        }
+
+        mempool.check(pcoinsTip);
+        connman->RelayTransaction(tx);
+        for (unsigned int i = 0; i < tx.vout.size(); i++) {
+            auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(inv.hash, i));
+            if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
+                for (const auto& elem : it_by_prev->second) {
+                    pfrom->orphan_work_set.insert(elem->first);
+                }
+            }
+        }
+
+        pfrom->nLastTXTime = GetTime();
+
+        LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPool: peer=%d: accepted %s (poolsz %u txn, %u kB)\n",
+            pfrom->GetId(),
+            tx.GetHash().ToString(),
+            mempool.size(), mempool.DynamicMemoryUsage() / 1000);
+
+        // Recursively process any orphan transactions that depended on this one
+        ProcessOrphanTx(connman, pfrom->orphan_work_set);
+    }
+    else if (fMissingInputs)
+    {
+        bool fRejectedParents = false; // It may be the case that the orphans parents have all been rejected
+        for (const CTxIn& txin : tx.vin) {
+            if (recentRejects->contains(txin.prevout.hash)) {
+                fRejectedParents = true;
+                break;
+            }
+        }
+        if (!fRejectedParents) {
+            for (const CTxIn& txin : tx.vin) {
+                CInv _inv(MSG_TX, txin.prevout.hash);
+                pfrom->AddInventoryKnown(_inv);
+                if (!AlreadyHave(_inv)) pfrom->AskFor(_inv);
+                // We don't know if the previous tx was a regular or a mixing one, try both
+                CInv _inv2(MSG_DSTX, txin.prevout.hash);
+                pfrom->AddInventoryKnown(_inv2);
+                if (!AlreadyHave(_inv2)) pfrom->AskFor(_inv2);
+            }
+            AddOrphanTx(ptx, pfrom->GetId());
+
+            // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
+            unsigned int nMaxOrphanTxSize = (unsigned int)std::max((int64_t)0, gArgs.GetArg("-maxorphantxsize", DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE)) * 1000000;
+            unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTxSize);
+            if (nEvicted > 0) {
+                LogPrint(BCLog::MEMPOOL, "mapOrphan overflow, removed %u tx\n", nEvicted);
+            }
+        } else {
+            LogPrint(BCLog::MEMPOOL, "not keeping orphan with rejected parents %s\n",tx.GetHash().ToString());
+            // We will continue to reject this tx since it has rejected
+            // parents so avoid re-requesting it from other peers.
+            recentRejects->insert(tx.GetHash());
+        }
+    } else {
+        if (!state.CorruptionPossible()) {
+            assert(recentRejects);
+            recentRejects->insert(tx.GetHash());
+            if (RecursiveDynamicUsage(*ptx) < 100000) {
+                AddToCompactExtraTransactions(ptx);
+            }
+        }
+
+        if (pfrom->fWhitelisted && gArgs.GetBoolArg("-whitelistforcerelay", DEFAULT_WHITELISTFORCERELAY)) {
+            // Always relay transactions received from whitelisted peers, even
+            // if they were already in the mempool or rejected from it due
+            // to policy, allowing the node to function as a gateway for
+            // nodes hidden behind it.
+            //
+            // Never relay transactions that we would assign a non-zero DoS
+            // score for, as we expect peers to do the same with us in that
+            // case.
+            int nDoS = 0;
+            if (!state.IsInvalid(nDoS) || nDoS == 0) {
+                LogPrintf("Force relaying tx %s from whitelisted peer=%d\n", tx.GetHash().ToString(), pfrom->GetId());
+                connman->RelayTransaction(tx);
+            } else {
+                LogPrintf("Not relaying invalid transaction %s from whitelisted peer=%d (%s)\n", tx.GetHash().ToString(), pfrom->GetId(), FormatStateMessage(state));
+            }
+        }
+    }
+
+    int nDoS = 0;
+    if (state.IsInvalid(nDoS))
+    {
+        LogPrint(BCLog::MEMPOOLREJ, "%s from peer=%d was not accepted: %s\n", tx.GetHash().ToString(),
+            pfrom->GetId(),
+            FormatStateMessage(state));
+        if (state.GetRejectCode() > 0 && state.GetRejectCode() < REJECT_INTERNAL) // Never send AcceptToMemoryPool's internal codes over P2P
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::REJECT, strCommand, (unsigned char)state.GetRejectCode(),
+                               state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash));
+        if (nDoS > 0) {
+            Misbehaving(pfrom->GetId(), nDoS);
+        }
+    }
+}
+
+/**
+ * Accept the oldest transaction received from pfrom if it finished pre-validation.
+ * Returns true while transactions of pfrom are still pending, fReadyRet tells if the
+ * next one can be accepted right away.
+ */
+static bool ProcessPendingTx(CNode* pfrom, CConnman* connman, bool& fReadyRet)
+{
+    std::shared_ptr<PendingTx> pendingTx;
+    bool fPending;
+    fReadyRet = false;
+    {
+        LOCK(cs_pendingTxs);
+        auto it = mapPendingTxs.find(pfrom->GetId());
+        if (it == mapPendingTxs.end()) {
+            return false;
+        }
+        if (!it->second.front()->fPreValidated) {
+            return true;
+        }
+        pendingTx = std::move(it->second.front());
+        it->second.pop_front();
+        ErasePendingTxHash(pendingTx->tx->GetHash());
+        if (it->second.empty()) {
+            mapPendingTxs.erase(it);
+            fPending = false;
+        } else {
+            fPending = true;
+            fReadyRet = it->second.front()->fPreValidated;
+        }
+    }
+    AcceptTxFromPeer(pfrom, pendingTx->strCommand, pendingTx->tx, pendingTx->dstx, pendingTx->nInvType, connman);
+    return fPending;
+}
+
 bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc)
 {
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->GetId());
@@ -2497,114 +2723,44 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             mmetaman.DisallowMixing(dmn->proTxHash);
         }
 
-        LOCK2(cs_main, g_cs_orphans);
-
-        bool fMissingInputs = false;
-        CValidationState state;
-
-        if (!AlreadyHave(inv) && AcceptToMemoryPool(mempool, state, ptx, true, &fMissingInputs)) {
-            // Process custom txes, this changes AlreadyHave to "true"
-            if (nInvType == MSG_DSTX) {
-                LogPrint(BCLog::PRIVATESEND, "DSTX -- Masternode transaction accepted, txid=%s, peer=%d\n",
-                        tx.GetHash().ToString(), pfrom->GetId());
-                CPrivateSend::AddDSTX(dstx);
+        bool fPreValidate = false;
+        if (txPreValidationPool) {
+            // Known transactions aren't worth pre-validating, AcceptTxFromPeer only does the
+            // relay and DoS handling for them
+            LOCK(cs_main);
+            fPreValidate = !AlreadyHave(inv);
+        }
+        if (fPreValidate) {
+            auto pendingTx = std::make_shared<PendingTx>();
+            pendingTx->strCommand = strCommand;
+            pendingTx->tx = ptx;
+            pendingTx->dstx = dstx;
+            pendingTx->nInvType = nInvType;
+            {
+                LOCK(cs_pendingTxs);
+                mapPendingTxs[pfrom->GetId()].push_back(pendingTx);
+                mapPendingTxHashes[tx.GetHash()]++;
             }
-
-            mempool.check(pcoinsTip);
-            connman->RelayTransaction(tx);
-            for (unsigned int i = 0; i < tx.vout.size(); i++) {
-                auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(inv.hash, i));
-                if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
-                    for (const auto& elem : it_by_prev->second) {
-                        pfrom->orphan_work_set.insert(elem->first);
+            if (nTxPreValidationQueued < MAX_TX_PREVALIDATION_QUEUE) {
+                nTxPreValidationQueued++;
+                txPreValidationPool->push([pendingTx, connman](int) {
+                    try {
+                        PreValidateTransaction(mempool, *pendingTx->tx);
+                    } catch (const std::exception& e) {
+                        LogPrintf("%s: pre-validation of %s failed: %s\n", __func__, pendingTx->tx->GetHash().ToString(), e.what());
                     }
-                }
-            }
-
-            pfrom->nLastTXTime = GetTime();
-
-            LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPool: peer=%d: accepted %s (poolsz %u txn, %u kB)\n",
-                pfrom->GetId(),
-                tx.GetHash().ToString(),
-                mempool.size(), mempool.DynamicMemoryUsage() / 1000);
-
-            // Recursively process any orphan transactions that depended on this one
-            ProcessOrphanTx(connman, pfrom->orphan_work_set);
-        }
-        else if (fMissingInputs)
-        {
-            bool fRejectedParents = false; // It may be the case that the orphans parents have all been rejected
-            for (const CTxIn& txin : tx.vin) {
-                if (recentRejects->contains(txin.prevout.hash)) {
-                    fRejectedParents = true;
-                    break;
-                }
-            }
-            if (!fRejectedParents) {
-                for (const CTxIn& txin : tx.vin) {
-                    CInv _inv(MSG_TX, txin.prevout.hash);
-                    pfrom->AddInventoryKnown(_inv);
-                    if (!AlreadyHave(_inv)) pfrom->AskFor(_inv);
-                    // We don't know if the previous tx was a regular or a mixing one, try both
-                    CInv _inv2(MSG_DSTX, txin.prevout.hash);
-                    pfrom->AddInventoryKnown(_inv2);
-                    if (!AlreadyHave(_inv2)) pfrom->AskFor(_inv2);
-                }
-                AddOrphanTx(ptx, pfrom->GetId());
-
-                // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
-                unsigned int nMaxOrphanTxSize = (unsigned int)std::max((int64_t)0, gArgs.GetArg("-maxorphantxsize", DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE)) * 1000000;
-                unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTxSize);
-                if (nEvicted > 0) {
-                    LogPrint(BCLog::MEMPOOL, "mapOrphan overflow, removed %u tx\n", nEvicted);
-                }
+                    pendingTx->fPreValidated = true;
+                    nTxPreValidationQueued--;
+                    connman->WakeMessageHandler();
+                });
             } else {
-                LogPrint(BCLog::MEMPOOL, "not keeping orphan with rejected parents %s\n",tx.GetHash().ToString());
-                // We will continue to reject this tx since it has rejected
-                // parents so avoid re-requesting it from other peers.
-                recentRejects->insert(tx.GetHash());
-            }
-        } else {
-            if (!state.CorruptionPossible()) {
-                assert(recentRejects);
-                recentRejects->insert(tx.GetHash());
-                if (RecursiveDynamicUsage(*ptx) < 100000) {
-                    AddToCompactExtraTransactions(ptx);
-                }
-            }
-
-            if (pfrom->fWhitelisted && gArgs.GetBoolArg("-whitelistforcerelay", DEFAULT_WHITELISTFORCERELAY)) {
-                // Always relay transactions received from whitelisted peers, even
-                // if they were already in the mempool or rejected from it due
-                // to policy, allowing the node to function as a gateway for
-                // nodes hidden behind it.
-                //
-                // Never relay transactions that we would assign a non-zero DoS
-                // score for, as we expect peers to do the same with us in that
-                // case.
-                int nDoS = 0;
-                if (!state.IsInvalid(nDoS) || nDoS == 0) {
-                    LogPrintf("Force relaying tx %s from whitelisted peer=%d\n", tx.GetHash().ToString(), pfrom->GetId());
-                    connman->RelayTransaction(tx);
-                } else {
-                    LogPrintf("Not relaying invalid transaction %s from whitelisted peer=%d (%s)\n", tx.GetHash().ToString(), pfrom->GetId(), FormatStateMessage(state));
-                }
+                // Too busy, AcceptToMemoryPool will do all checks itself
+                pendingTx->fPreValidated = true;
             }
+            return true;
         }
 
-        int nDoS = 0;
-        if (state.IsInvalid(nDoS))
-        {
-            LogPrint(BCLog::MEMPOOLREJ, "%s from peer=%d was not accepted: %s\n", tx.GetHash().ToString(),
-                pfrom->GetId(),
-                FormatStateMessage(state));
-            if (state.GetRejectCode() > 0 && state.GetRejectCode() < REJECT_INTERNAL) // Never send AcceptToMemoryPool's internal codes over P2P
-                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::REJECT, strCommand, (unsigned char)state.GetRejectCode(),
-                                   state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash));
-            if (nDoS > 0) {
-                Misbehaving(pfrom->GetId(), nDoS);
-            }
-        }
+        AcceptTxFromPeer(pfrom, strCommand, ptx, dstx, nInvType, connman);
         return true;
     }
 
@@ -3139,10 +3295,11 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
         LOCK(cs_main);
 
-        CSimplifiedMNListDiff mnListDiff;
+        CSerializedNetMsg msg;
+        msg.command = NetMsgType::MNLISTDIFF;
         std::string strError;
-        if (BuildSimplifiedMNListDiff(cmd.baseBlockHash, cmd.blockHash, mnListDiff, strError)) {
-            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNLISTDIFF, mnListDiff));
+        if (BuildSimplifiedMNListDiffSerialized(cmd.baseBlockHash, cmd.blockHash, pfrom->GetSendVersion(), msg.data, strError)) {
+            connman->PushMessage(pfrom, std::move(msg));
         } else {
             LogPrint(BCLog::NET, "getmnlistdiff failed for baseBlockHash=%s, blockHash=%s. error=%s\n", cmd.baseBlockHash.ToString(), cmd.blockHash.ToString(), strError);
             Misbehaving(pfrom->GetId(), 1);
@@ -3252,12 +3409,16 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         ProcessOrphanTx(connman, pfrom->orphan_work_set);
     }
 
+    bool fPendingTxReady;
+    bool fPendingTxs = ProcessPendingTx(pfrom, connman, fPendingTxReady);
+
     if (pfrom->fDisconnect)
         return false;
 
     // this maintains the order of responses
     if (!pfrom->vRecvGetData.empty()) return true;
     if (!pfrom->orphan_work_set.empty()) return true;
+    if (fPendingTxReady) return true;
 
     // Don't bother if send buffer is too full to respond anyway
     if (pfrom->fPauseSend)
@@ -3268,6 +3429,14 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         LOCK(pfrom->cs_vProcessMsg);
         if (pfrom->vProcessMsg.empty())
             return false;
+        // Later messages must not overtake the peer's pending transactions, e.g. a cmpctblock or
+        // an islock referring to them. More transactions just queue up behind them. The
+        // pre-validation pool wakes us up when the next one is ready
+        if (fPendingTxs) {
+            const std::string strNextCommand = pfrom->vProcessMsg.front().hdr.GetCommand();
+            if (strNextCommand != NetMsgType::TX && strNextCommand != NetMsgType::DSTX && strNextCommand != NetMsgType::LEGACYTXLOCKREQUEST)
+                return false;
+        }
         // Just take one message
         msgs.splice(msgs.begin(), pfrom->vProcessMsg, pfrom->vProcessMsg.begin());
         pfrom->nProcessQueueSize -= msgs.front().vRecv.size() + CMessageHeader::HEADER_SIZE;
@@ -36,6 +36,10 @@ static constexpr int64_t STALE_CHECK_INTERVAL = 150; // 2.5 minutes (~block inte
 static constexpr int64_t EXTRA_PEER_CHECK_INTERVAL = 45;
 /** Minimum time an outbound-peer-eviction candidate must be connected for, in order to evict, in seconds */
 static constexpr int64_t MINIMUM_CONNECT_TIME = 30;
+/** Maximum number of threads verifying the signatures of received transactions */
+static constexpr int MAX_TX_PREVALIDATION_THREADS = 4;
+/** Maximum number of received transactions waiting for pre-validation, beyond that they are validated directly */
+static constexpr int MAX_TX_PREVALIDATION_QUEUE = 1000;
 
 class PeerLogicValidation : public CValidationInterface, public NetEventsInterface {
 private:
@@ -43,6 +47,7 @@ private:
 
 public:
     explicit PeerLogicValidation(CConnman* connmanIn, CScheduler &scheduler);
+    ~PeerLogicValidation();
 
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted) override;
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
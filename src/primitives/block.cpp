@@ -11,12 +11,119 @@
 #include "utilstrencodings.h"
 #include "crypto/common.h"
 
+#include <string.h>
+
+static_assert(sizeof(int32_t) + 2 * sizeof(uint256) + 3 * sizeof(uint32_t) == CBlockHeader::HEADER_SIZE,
+              "header fields must be exactly HEADER_SIZE bytes");
+
 uint256 CBlockHeader::GetHash() const
 {
-    std::vector<unsigned char> vch(80);
-    CVectorWriter ss(SER_NETWORK, PROTOCOL_VERSION, vch, 0);
-    ss << *this;
-    return HashX16R(BEGIN(nVersion), END(nNonce), hashPrevBlock);
+    // The header fields are laid out contiguously, nVersion to nNonce is the 80 byte
+    // serialized header on little endian hosts.
+    const char* pbegin = BEGIN(nVersion);
+    const char* pend = END(nNonce);
+    assert(pend - pbegin == (ptrdiff_t)HEADER_SIZE);
+
+    HeaderDigest digest = GetHeaderDigest();
+    HeaderDigest cachedDigest;
+    uint256 hash;
+    if (ReadHashCache(cachedDigest, hash) && cachedDigest == digest) {
+        return hash;
+    }
+
+    hash = HashX16R(pbegin, pend, hashPrevBlock);
+    WriteHashCache(true, digest, hash);
+    return hash;
+}
+
+bool CBlockHeader::HasCachedHash() const
+{
+    HeaderDigest cachedDigest;
+    uint256 hash;
+    return ReadHashCache(cachedDigest, hash) && cachedDigest == GetHeaderDigest();
+}
+
+void CBlockHeader::SetCachedHash(const uint256& hash) const
+{
+    WriteHashCache(true, GetHeaderDigest(), hash);
+}
+
+CBlockHeader::HeaderDigest CBlockHeader::GetHeaderDigest() const
+{
+    unsigned char buf[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write((const unsigned char*)BEGIN(nVersion), HEADER_SIZE).Finalize(buf);
+    HeaderDigest digest;
+    memcpy(digest.data(), buf, sizeof(digest));
+    return digest;
+}
+
+bool CBlockHeader::ReadHashCache(HeaderDigest& digest, uint256& hash) const
+{
+    uint32_t nSeq = nHashCacheSeq.load(std::memory_order_acquire);
+    if (nSeq & 1) {
+        return false;
+    }
+    if (!fHashCached.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    uint64_t words[4];
+    for (size_t i = 0; i < digest.size(); i++) {
+        digest[i] = hashedHeaderDigest[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < 4; i++) {
+        words[i] = hashCached[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (nHashCacheSeq.load(std::memory_order_relaxed) != nSeq) {
+        return false;
+    }
+    memcpy(hash.begin(), words, sizeof(words));
+    return true;
+}
+
+void CBlockHeader::WriteHashCache(bool fCached, const HeaderDigest& digest, const uint256& hash) const
+{
+    // Concurrent writers can only race here for the same header, in which case they would
+    // store identical values, so the loser just leaves it to the winner. Mutating a header
+    // which is shared between threads is not supported, with or without this cache.
+    uint32_t nSeq = nHashCacheSeq.load(std::memory_order_relaxed);
+    if ((nSeq & 1) || !nHashCacheSeq.compare_exchange_strong(nSeq, nSeq + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    uint64_t words[4];
+    memcpy(words, hash.begin(), sizeof(words));
+    fHashCached.store(fCached, std::memory_order_relaxed);
+    for (size_t i = 0; i < digest.size(); i++) {
+        hashedHeaderDigest[i].store(digest[i], std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < 4; i++) {
+        hashCached[i].store(words[i], std::memory_order_relaxed);
+    }
+    nHashCacheSeq.store(nSeq + 2, std::memory_order_release);
+}
+
+void CBlockHeader::CopyHashCache(const CBlockHeader& other)
+{
+    if (this == &other) {
+        return;
+    }
+    // other has the same header fields now, so its digest is valid for this header as well
+    HeaderDigest digest;
+    uint256 hash;
+    if (other.ReadHashCache(digest, hash)) {
+        WriteHashCache(true, digest, hash);
+    } else {
+        WriteHashCache(false, HeaderDigest(), uint256());
+    }
+}
+
+void CacheBlockHeaderHashes(const CBlockHeader* pbegin, const CBlockHeader* pend)
+{
+    for (const CBlockHeader* it = pbegin; it != pend; ++it) {
+        it->GetHash();
+    }
 }
 
 std::string CBlock::ToString() const
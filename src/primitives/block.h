@@ -10,6 +10,9 @@
 #include "serialize.h"
 #include "uint256.h"
 
+#include <array>
+#include <atomic>
+
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
  * requirements.  When they solve the proof-of-work, they broadcast the block
@@ -20,6 +23,8 @@
 class CBlockHeader
 {
 public:
+    static const size_t HEADER_SIZE = 80;
+
     // header
     int32_t nVersion;
     uint256 hashPrevBlock;
@@ -28,11 +33,44 @@ public:
     uint32_t nBits;
     uint32_t nNonce;
 
-    CBlockHeader()
+private:
+    // memory only
+    // X16R is expensive, so GetHash() remembers a digest of the header it hashed last and
+    // the resulting hash. The header fields are public and get mutated directly (e.g. when
+    // mining or deserializing), so the cache is validated against a digest of the current
+    // fields on every access instead of being invalidated by setters. A 128 bit digest is
+    // collision resistant enough and half the size of copying the 80 header bytes.
+    // Headers are shared between threads (e.g. a CBlock being validated and relayed), so
+    // the cache is a seqlock: nHashCacheSeq is odd while a writer updates the other fields,
+    // which are atomics accessed with relaxed ordering.
+    mutable std::atomic<uint32_t> nHashCacheSeq;
+    mutable std::atomic<bool> fHashCached;
+    mutable std::atomic<uint64_t> hashedHeaderDigest[2];
+    mutable std::atomic<uint64_t> hashCached[4];
+
+public:
+    CBlockHeader() : nHashCacheSeq(0), fHashCached(false)
     {
         SetNull();
     }
 
+    CBlockHeader(const CBlockHeader& other) : nHashCacheSeq(0), fHashCached(false)
+    {
+        *this = other;
+    }
+
+    CBlockHeader& operator=(const CBlockHeader& other)
+    {
+        nVersion       = other.nVersion;
+        hashPrevBlock  = other.hashPrevBlock;
+        hashMerkleRoot = other.hashMerkleRoot;
+        nTime          = other.nTime;
+        nBits          = other.nBits;
+        nNonce         = other.nNonce;
+        CopyHashCache(other);
+        return *this;
+    }
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -62,10 +100,29 @@ public:
 
     uint256 GetHash() const;
 
+    /**
+     * Seed the hash cache with an already known hash of the current header fields,
+     * e.g. from a CBlockIndex. The caller is responsible for the hash being correct.
+     */
+    void SetCachedHash(const uint256& hash) const;
+
+    /** Whether GetHash() can be answered from the cache, without computing X16R */
+    bool HasCachedHash() const;
+
     int64_t GetBlockTime() const
     {
         return (int64_t)nTime;
     }
+
+private:
+    typedef std::array<uint64_t, 2> HeaderDigest;
+
+    HeaderDigest GetHeaderDigest() const;
+    /** Read a consistent snapshot of the cache, returns false if it is empty or being written */
+    bool ReadHashCache(HeaderDigest& digest, uint256& hash) const;
+    /** Replace the cache, unless another thread is writing it at the same time */
+    void WriteHashCache(bool fCached, const HeaderDigest& digest, const uint256& hash) const;
+    void CopyHashCache(const CBlockHeader& other);
 };
 
 
@@ -106,20 +163,22 @@ public:
 
     CBlockHeader GetBlockHeader() const
     {
-        CBlockHeader block;
-        block.nVersion       = nVersion;
-        block.hashPrevBlock  = hashPrevBlock;
-        block.hashMerkleRoot = hashMerkleRoot;
-        block.nTime          = nTime;
-        block.nBits          = nBits;
-        block.nNonce         = nNonce;
-        return block;
+        // copies the header fields together with the cached hash
+        return CBlockHeader(*this);
     }
 
     std::string ToString() const;
 };
 
 
+/** Fill the hash cache of all headers which don't have a valid cached hash yet */
+void CacheBlockHeaderHashes(const CBlockHeader* pbegin, const CBlockHeader* pend);
+inline void CacheBlockHeaderHashes(const std::vector<CBlockHeader>& headers)
+{
+    CacheBlockHeaderHashes(headers.data(), headers.data() + headers.size());
+}
+
+
 /** Describes a place in the block chain to another node such that if the
  * other node doesn't have the same branch, it can find a recent common trunk.
  * The further back it is, the further before the fork it may be.
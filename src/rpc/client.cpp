@@ -38,6 +38,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
 #endif // ENABLE_MINER
     { "getnetworkhashps", 0, "nblocks" },
     { "getnetworkhashps", 1, "height" },
+#if ENABLE_X16R_STATS
+    { "getpowstats", 0, "reset" },
+#endif // ENABLE_X16R_STATS
     { "sendtoaddress", 1, "amount" },
     { "sendtoaddress", 4, "subtractfeefromamount" },
     { "sendtoaddress", 5, "use_is" },
@@ -12,6 +12,7 @@
 #include "consensus/params.h"
 #include "consensus/validation.h"
 #include "core_io.h"
+#include "hash.h"
 #include "init.h"
 #include "validation.h"
 #include "miner.h"
@@ -236,6 +237,61 @@ UniValue getmininginfo(const JSONRPCRequest& request)
 }
 
 
+#if ENABLE_X16R_STATS
+UniValue getpowstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            "getpowstats ( reset )\n"
+            "\nReturns statistics about the X16R algorithms computed by this node since startup or the last reset,\n"
+            "e.g. while validating headers and blocks.\n"
+            "\nArguments:\n"
+            "1. reset       (boolean, optional, default=false) Reset the statistics after returning them\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"algo\": {            (string) The name of the algorithm, e.g. blake or groestl\n"
+            "    \"hits\": n,         (numeric) The number of times the algorithm was run\n"
+            "    \"bytes\": n,        (numeric) The total number of bytes hashed\n"
+            "    \"ticks\": n,        (numeric) The time spent in the algorithm, in CPU cycles if available, otherwise nanoseconds\n"
+            "    \"ticksperhit\": n,  (numeric) The average time per run\n"
+            "    \"share\": x.xxx     (numeric) The fraction of the total X16R time spent in the algorithm\n"
+            "  }, ...\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getpowstats", "")
+            + HelpExampleRpc("getpowstats", "true")
+        );
+
+    bool fReset = false;
+    if (!request.params[0].isNull()) {
+        fReset = request.params[0].get_bool();
+    }
+
+    std::array<X16RAlgoStats, 16> stats = GetX16RStats();
+    if (fReset) {
+        ResetX16RStats();
+    }
+
+    uint64_t nTotalTicks = 0;
+    for (const auto& s : stats) {
+        nTotalTicks += s.nTicks;
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    for (int algo = 0; algo < 16; algo++) {
+        const X16RAlgoStats& s = stats[algo];
+        UniValue algoObj(UniValue::VOBJ);
+        algoObj.push_back(Pair("hits", s.nHits));
+        algoObj.push_back(Pair("bytes", s.nBytes));
+        algoObj.push_back(Pair("ticks", s.nTicks));
+        algoObj.push_back(Pair("ticksperhit", s.nHits ? s.nTicks / s.nHits : 0));
+        algoObj.push_back(Pair("share", nTotalTicks ? (double)s.nTicks / nTotalTicks : 0.0));
+        obj.push_back(Pair(GetX16RAlgoName(algo), algoObj));
+    }
+    return obj;
+}
+#endif // ENABLE_X16R_STATS
+
 // NOTE: Unlike wallet RPC (which use BTC values), mining RPCs follow GBT (BIP 22) in using satoshi amounts
 UniValue prioritisetransaction(const JSONRPCRequest& request)
 {
@@ -293,6 +349,17 @@ std::string gbt_vb_name(const Consensus::DeploymentPos pos) {
     return s;
 }
 
+/** The last getblocktemplate result and what it was built from */
+struct BlockTemplateResultCache
+{
+    std::shared_ptr<const CBlockTemplate> pblocktemplate;
+    uint32_t nTime{0};
+    uint32_t nBits{0};
+    std::set<std::string> setClientRules;
+    int64_t nMaxVersionPreVB{-1};
+    UniValue result;
+};
+
 UniValue getblocktemplate(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() > 1)
@@ -478,13 +545,15 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
         && CSuperblock::IsValidBlockHeight(chainActive.Height() + 1))
             throw JSONRPCError(RPC_CLIENT_IN_INITIAL_DOWNLOAD, "Genix Core is syncing with network...");
 
+    if (!g_blockTemplateNotifier)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Error: Block templates are not available");
+
     static unsigned int nTransactionsUpdatedLast;
 
     if (!lpval.isNull())
     {
         // Wait to respond until either the best block changes, OR a minute has passed and there are more transactions
         uint256 hashWatchedChain;
-        boost::system_time checktxtime;
         unsigned int nTransactionsUpdatedLastLP;
 
         if (lpval.isStr())
@@ -504,21 +573,7 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
 
         // Release the wallet and main lock while waiting
         LEAVE_CRITICAL_SECTION(cs_main);
-        {
-            checktxtime = boost::get_system_time() + boost::posix_time::minutes(1);
-
-            boost::unique_lock<boost::mutex> lock(csBestBlock);
-            while (chainActive.Tip()->GetBlockHash() == hashWatchedChain && IsRPCRunning())
-            {
-                if (!cvBlockChange.timed_wait(lock, checktxtime))
-                {
-                    // Timeout: Check transactions for update
-                    if (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLastLP)
-                        break;
-                    checktxtime += boost::posix_time::seconds(10);
-                }
-            }
-        }
+        g_blockTemplateNotifier->WaitForNewTemplate(hashWatchedChain, nTransactionsUpdatedLastLP);
         ENTER_CRITICAL_SECTION(cs_main);
 
         if (!IsRPCRunning())
@@ -526,36 +581,25 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
         // TODO: Maybe recheck connections/IBD and (if something wrong) send an expires-immediately template to stop miners?
     }
 
-    // Update block
-    static CBlockIndex* pindexPrev;
-    static int64_t nStart;
-    static std::unique_ptr<CBlockTemplate> pblocktemplate;
-    if (pindexPrev != chainActive.Tip() ||
-        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5))
-    {
-        // Clear pindexPrev so future calls make a new block, despite any failures from here on
-        pindexPrev = nullptr;
-
-        // Store the chainActive.Tip() used before CreateNewBlock, to avoid races
-        nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
-        CBlockIndex* pindexPrevNew = chainActive.Tip();
-        nStart = GetTime();
-
-        // Create new block
-        CScript scriptDummy = CScript() << OP_TRUE;
-        pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptDummy);
-        if (!pblocktemplate)
-            throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
-
-        // Need to update only after we know CreateNewBlock succeeded
-        pindexPrev = pindexPrevNew;
-    }
-    CBlock* pblock = &pblocktemplate->block; // pointer for convenience
+    // Get the template, which is shared by all clients and only rebuilt after the tip or the mempool changed
+    const CBlockIndex* pindexPrev;
+    std::shared_ptr<const CBlockTemplate> pblocktemplate = g_blockTemplateNotifier->GetBlockTemplate(pindexPrev, nTransactionsUpdatedLast);
+    if (!pblocktemplate)
+        throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
+    const CBlock* pblock = &pblocktemplate->block; // pointer for convenience
     const Consensus::Params& consensusParams = Params().GetConsensus();
 
-    // Update nTime
-    UpdateTime(pblock, consensusParams, pindexPrev);
-    pblock->nNonce = 0;
+    // Update nTime, on a copy of the header as the template itself is shared
+    CBlockHeader header = pblock->GetBlockHeader();
+    UpdateTime(&header, consensusParams, pindexPrev);
+
+    // Clients asking for the same template within the same second (like all long polling clients after a new
+    // block) get the same result, so only build it once
+    static BlockTemplateResultCache resultCache;
+    if (resultCache.pblocktemplate == pblocktemplate && resultCache.nTime == header.nTime && resultCache.nBits == header.nBits &&
+        resultCache.setClientRules == setClientRules && resultCache.nMaxVersionPreVB == nMaxVersionPreVB) {
+        return resultCache.result;
+    }
 
     UniValue aCaps(UniValue::VARR); aCaps.push_back("proposal");
 
@@ -594,7 +638,7 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
     UniValue aux(UniValue::VOBJ);
     aux.push_back(Pair("flags", HexStr(COINBASE_FLAGS.begin(), COINBASE_FLAGS.end())));
 
-    arith_uint256 hashTarget = arith_uint256().SetCompact(pblock->nBits);
+    arith_uint256 hashTarget = arith_uint256().SetCompact(header.nBits);
 
     UniValue aMutable(UniValue::VARR);
     aMutable.push_back("time");
@@ -616,7 +660,7 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
                 break;
             case THRESHOLD_LOCKED_IN:
                 // Ensure bit is set in block version
-                pblock->nVersion |= VersionBitsMask(consensusParams, pos);
+                header.nVersion |= VersionBitsMask(consensusParams, pos);
                 // FALL THROUGH to get vbavailable set...
             case THRESHOLD_STARTED:
             {
@@ -625,7 +669,7 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
                 if (setClientRules.find(vbinfo.name) == setClientRules.end()) {
                     if (!vbinfo.gbt_force) {
                         // If the client doesn't support this, don't indicate it in the [default] version
-                        pblock->nVersion &= ~VersionBitsMask(consensusParams, pos);
+                        header.nVersion &= ~VersionBitsMask(consensusParams, pos);
                     }
                 }
                 break;
@@ -646,7 +690,7 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
             }
         }
     }
-    result.push_back(Pair("version", pblock->nVersion));
+    result.push_back(Pair("version", header.nVersion));
     result.push_back(Pair("rules", aRules));
     result.push_back(Pair("vbavailable", vbavailable));
     result.push_back(Pair("vbrequired", int(0)));
@@ -663,15 +707,15 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
     result.push_back(Pair("transactions", transactions));
     result.push_back(Pair("coinbaseaux", aux));
     result.push_back(Pair("coinbasevalue", (int64_t)pblock->vtx[0]->GetValueOut()));
-    result.push_back(Pair("longpollid", chainActive.Tip()->GetBlockHash().GetHex() + i64tostr(nTransactionsUpdatedLast)));
+    result.push_back(Pair("longpollid", pindexPrev->GetBlockHash().GetHex() + i64tostr(nTransactionsUpdatedLast)));
     result.push_back(Pair("target", hashTarget.GetHex()));
     result.push_back(Pair("mintime", (int64_t)pindexPrev->GetMedianTimePast()+1));
     result.push_back(Pair("mutable", aMutable));
     result.push_back(Pair("noncerange", "00000000ffffffff"));
     result.push_back(Pair("sigoplimit", (int64_t)MaxBlockSigOps(fDIP0001ActiveAtTip)));
     result.push_back(Pair("sizelimit", (int64_t)MaxBlockSize(fDIP0001ActiveAtTip)));
-    result.push_back(Pair("curtime", pblock->GetBlockTime()));
-    result.push_back(Pair("bits", strprintf("%08x", pblock->nBits)));
+    result.push_back(Pair("curtime", header.GetBlockTime()));
+    result.push_back(Pair("bits", strprintf("%08x", header.nBits)));
     result.push_back(Pair("previousbits", strprintf("%08x", pblocktemplate->nPrevBits)));
     result.push_back(Pair("height", (int64_t)(pindexPrev->nHeight+1)));
 
@@ -711,6 +755,13 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
 
     result.push_back(Pair("coinbase_payload", HexStr(pblock->vtx[0]->vExtraPayload)));
 
+    resultCache.pblocktemplate = pblocktemplate;
+    resultCache.nTime = header.nTime;
+    resultCache.nBits = header.nBits;
+    resultCache.setClientRules = setClientRules;
+    resultCache.nMaxVersionPreVB = nMaxVersionPreVB;
+    resultCache.result = result;
+
     return result;
 }
 
@@ -995,6 +1046,9 @@ static const CRPCCommand commands[] =
   //  --------------------- ------------------------  -----------------------  ----------
     { "mining",             "getnetworkhashps",       &getnetworkhashps,       true,  {"nblocks","height"} },
     { "mining",             "getmininginfo",          &getmininginfo,          true,  {} },
+#if ENABLE_X16R_STATS
+    { "mining",             "getpowstats",            &getpowstats,            true,  {"reset"} },
+#endif // ENABLE_X16R_STATS
     { "mining",             "prioritisetransaction",  &prioritisetransaction,  true,  {"txid","fee_delta"} },
     { "mining",             "getblocktemplate",       &getblocktemplate,       true,  {"template_request"} },
     { "mining",             "submitblock",            &submitblock,            true,  {"hexdata","dummy"} },
@@ -46,6 +46,49 @@ BOOST_AUTO_TEST_CASE(bls_sig_tests)
     BOOST_CHECK(sig2.VerifyInsecure(sk2.GetPublicKey(), msgHash1));
 }
 
+BOOST_AUTO_TEST_CASE(bls_sig_cache_tests)
+{
+    CBLSSecretKey sk1, sk2;
+    sk1.MakeNewKey();
+    sk2.MakeNewKey();
+
+    uint256 msgHash1 = uint256S("0000000000000000000000000000000000000000000000000000000000000001");
+    uint256 msgHash2 = uint256S("0000000000000000000000000000000000000000000000000000000000000002");
+
+    // repeated verification is served from the cache and must not leak into other keys/messages
+    auto sig1 = sk1.Sign(msgHash1);
+    uint64_t nHits = GetBLSSigCacheHits();
+    BOOST_CHECK(sig1.VerifyInsecure(sk1.GetPublicKey(), msgHash1));
+    BOOST_CHECK_EQUAL(GetBLSSigCacheHits(), nHits);
+    for (int i = 0; i < 2; i++) {
+        BOOST_CHECK(sig1.VerifyInsecure(sk1.GetPublicKey(), msgHash1));
+        BOOST_CHECK_EQUAL(GetBLSSigCacheHits(), nHits + i + 1);
+        BOOST_CHECK(!sig1.VerifyInsecure(sk2.GetPublicKey(), msgHash1));
+        BOOST_CHECK(!sig1.VerifyInsecure(sk1.GetPublicKey(), msgHash2));
+        BOOST_CHECK_EQUAL(GetBLSSigCacheHits(), nHits + i + 1);
+    }
+
+    // secure aggregation, valid and invalid key sets
+    auto sigAgg = CBLSSignature::AggregateSecure({sk1.Sign(msgHash2), sk2.Sign(msgHash2)}, {sk1.GetPublicKey(), sk2.GetPublicKey()}, msgHash2);
+    nHits = GetBLSSigCacheHits();
+    BOOST_CHECK(sigAgg.VerifySecureAggregated({sk1.GetPublicKey(), sk2.GetPublicKey()}, msgHash2));
+    BOOST_CHECK_EQUAL(GetBLSSigCacheHits(), nHits);
+    for (int i = 0; i < 2; i++) {
+        BOOST_CHECK(sigAgg.VerifySecureAggregated({sk1.GetPublicKey(), sk2.GetPublicKey()}, msgHash2));
+        BOOST_CHECK_EQUAL(GetBLSSigCacheHits(), nHits + i + 1);
+        BOOST_CHECK(!sigAgg.VerifySecureAggregated({sk1.GetPublicKey()}, msgHash2));
+        BOOST_CHECK(!sigAgg.VerifySecureAggregated({sk1.GetPublicKey(), sk2.GetPublicKey()}, msgHash1));
+        BOOST_CHECK_EQUAL(GetBLSSigCacheHits(), nHits + i + 1);
+    }
+
+    // the insecure and secure entries of the same sig, key and message don't collide
+    auto sig2 = sk2.Sign(msgHash1);
+    nHits = GetBLSSigCacheHits();
+    BOOST_CHECK(sig2.VerifyInsecure(sk2.GetPublicKey(), msgHash1));
+    BOOST_CHECK(!sig2.VerifySecureAggregated({sk2.GetPublicKey()}, msgHash1));
+    BOOST_CHECK_EQUAL(GetBLSSigCacheHits(), nHits);
+}
+
 struct Message
 {
     uint32_t sourceId;
@@ -152,6 +195,67 @@ BOOST_AUTO_TEST_CASE(batch_verifier_tests)
     // last message invalid from one source
     AddMessage(msgs, 1, 7, 1, false);
     Verify(msgs);
+
+    msgs.clear();
+    // many messages from the same source with a few invalid ones in between, found by bisection
+    for (uint32_t i = 0; i < 37; i++) {
+        AddMessage(msgs, 1, i, i, i != 3 && i != 4 && i != 30);
+    }
+    AddMessage(msgs, 2, 100, 100, true);
+    Verify(msgs);
+}
+
+static void VerifyPartitioned(std::vector<Message>& vec, ctpl::thread_pool* pool, bool secureVerification, bool perMessageFallback)
+{
+    CBLSPartitionedBatchVerifier<uint32_t, uint32_t, uint32_t> batchVerifier(secureVerification, perMessageFallback);
+
+    std::set<uint32_t> expectedBadMessages;
+    std::set<uint32_t> expectedBadSources;
+    for (auto& m : vec) {
+        if (!m.valid) {
+            expectedBadMessages.emplace(m.msgId);
+            expectedBadSources.emplace(m.sourceId);
+        }
+
+        batchVerifier.PushMessage(m.msgId % 3, m.sourceId, m.msgId, m.msgHash, m.sig, m.pk);
+    }
+
+    batchVerifier.Verify(pool);
+
+    BOOST_CHECK(batchVerifier.badSources == expectedBadSources);
+
+    if (perMessageFallback) {
+        BOOST_CHECK(batchVerifier.badMessages == expectedBadMessages);
+    } else {
+        BOOST_CHECK(batchVerifier.badMessages.empty());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(partitioned_batch_verifier_tests)
+{
+    ctpl::thread_pool pool(2);
+
+    std::vector<Message> msgs;
+    for (uint32_t i = 0; i < 20; i++) {
+        AddMessage(msgs, i % 4, i, i, true);
+    }
+    for (bool secure : {false, true}) {
+        for (bool fallback : {false, true}) {
+            VerifyPartitioned(msgs, nullptr, secure, fallback);
+            VerifyPartitioned(msgs, &pool, secure, fallback);
+        }
+    }
+
+    AddMessage(msgs, 1, 20, 20, false);
+    AddMessage(msgs, 2, 21, 5, false);
+    for (bool secure : {false, true}) {
+        for (bool fallback : {false, true}) {
+            VerifyPartitioned(msgs, nullptr, secure, fallback);
+            VerifyPartitioned(msgs, &pool, secure, fallback);
+        }
+    }
+
+    pool.stop(true);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
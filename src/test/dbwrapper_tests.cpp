@@ -319,4 +319,97 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering)
 
 
 
+BOOST_AUTO_TEST_CASE(dbwrapper_transaction)
+{
+    typedef CDBTransaction<CDBWrapper, CDBBatch> RootTransaction;
+    typedef CDBTransaction<RootTransaction, RootTransaction> CurTransaction;
+
+    fs::path ph = fs::temp_directory_path() / fs::unique_path();
+    CDBWrapper dbw(ph, (1 << 20), true, false, true);
+    CDBBatch batch(dbw);
+    RootTransaction rootTx(dbw, batch);
+    CurTransaction curTx(rootTx, rootTx);
+
+    // even keys are on disk
+    for (uint32_t x = 0; x < 100; x += 2) {
+        BOOST_CHECK(dbw.Write(std::make_pair('t', x), x));
+    }
+
+    size_t emptyUsage = curTx.GetMemoryUsage();
+
+    // odd keys are written in reverse order, every 4th key is erased and keys 10-19 are overwritten
+    for (uint32_t x = 99; x < 100; x -= 2) {
+        curTx.Write(std::make_pair('t', x), x);
+    }
+    for (uint32_t x = 0; x < 100; x += 4) {
+        curTx.Erase(std::make_pair('t', x));
+    }
+    for (uint32_t x = 10; x < 20; x++) {
+        curTx.Write(std::make_pair('t', x), x * 1000);
+    }
+    BOOST_CHECK(curTx.GetMemoryUsage() > emptyUsage);
+
+    auto expected = [](uint32_t x, uint32_t& value) {
+        value = (x >= 10 && x < 20) ? x * 1000 : x;
+        return (x >= 10 && x < 20) || x % 4 != 0;
+    };
+
+    auto check = [&](CurTransaction& tx) {
+        for (uint32_t x = 0; x < 100; x++) {
+            uint32_t value, expectedValue;
+            bool exists = expected(x, expectedValue);
+            BOOST_CHECK_EQUAL(tx.Exists(std::make_pair('t', x)), exists);
+            BOOST_CHECK_EQUAL(tx.Read(std::make_pair('t', x), value), exists);
+            if (exists) {
+                BOOST_CHECK_EQUAL(value, expectedValue);
+            }
+        }
+
+        // the iterator merges the transaction with its parents in key order
+        auto it = tx.NewIteratorUniquePtr();
+        it->Seek(std::make_pair('t', (uint32_t)0));
+        for (uint32_t x = 0; x < 100; x++) {
+            uint32_t expectedValue;
+            if (!expected(x, expectedValue)) {
+                continue;
+            }
+            std::pair<char, uint32_t> key;
+            uint32_t value;
+            BOOST_CHECK(it->Valid());
+            if (!it->Valid()) {
+                break;
+            }
+            BOOST_CHECK(it->GetKey(key));
+            BOOST_CHECK(it->GetValue(value));
+            BOOST_CHECK_EQUAL(key.second, x);
+            BOOST_CHECK_EQUAL(value, expectedValue);
+            it->Next();
+        }
+        BOOST_CHECK(!it->Valid());
+    };
+
+    check(curTx);
+
+    // reading a value with a different type than it was written with
+    uint64_t wrongType;
+    BOOST_CHECK_THROW(curTx.Read(std::make_pair('t', (uint32_t)11), wrongType), std::runtime_error);
+
+    curTx.Commit();
+    BOOST_CHECK(curTx.IsClean());
+    BOOST_CHECK(!rootTx.IsClean());
+    check(curTx);
+
+    rootTx.Commit();
+    BOOST_CHECK(rootTx.IsClean());
+    dbw.WriteBatch(batch);
+    check(curTx);
+
+    // the arena and indexes are kept for reuse
+    BOOST_CHECK(curTx.GetMemoryUsage() > 0);
+    curTx.Write(std::make_pair('t', (uint32_t)1), (uint32_t)5);
+    curTx.Clear();
+    BOOST_CHECK(curTx.IsClean());
+    check(curTx);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
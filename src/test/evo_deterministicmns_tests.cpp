@@ -4,10 +4,12 @@
 
 #include "test/test_genix.h"
 
+#include "arith_uint256.h"
 #include "script/interpreter.h"
 #include "script/standard.h"
 #include "script/sign.h"
 #include "validation.h"
+#include "validationinterface.h"
 #include "base58.h"
 #include "netbase.h"
 #include "messagesigner.h"
@@ -239,6 +241,19 @@ static bool CheckTransactionSignature(const CMutableTransaction& tx)
     return true;
 }
 
+/** Remembers why ConnectBlock accepted or rejected a block */
+struct BlockCheckedListener : public CValidationInterface
+{
+    uint256 hashBlock;
+    std::string strRejectReason;
+
+    void BlockChecked(const CBlock& block, const CValidationState& state) override
+    {
+        hashBlock = block.GetHash();
+        strRejectReason = state.GetRejectReason();
+    }
+};
+
 BOOST_AUTO_TEST_SUITE(evo_dip3_activation_tests)
 
 BOOST_FIXTURE_TEST_CASE(dip3_activation, TestChainDIP3BeforeActivationSetup)
@@ -376,6 +391,53 @@ BOOST_FIXTURE_TEST_CASE(dip3_protx, TestChainDIP3Setup)
     auto dmn = deterministicMNManager->GetListAtChainTip().GetMN(dmnHashes[0]);
     BOOST_ASSERT(dmn != nullptr && dmn->pdmnState->addr.GetPort() == 1000);
 
+    // operator sigs are verified in parallel to the script checks, check that the right keys are picked up
+    {
+        CBLSSecretKey wrongOperatorKey;
+        wrongOperatorKey.MakeNewKey();
+        CBlock block;
+        block.vtx.emplace_back(MakeTransactionRef(CreateProUpServTx(utxos, dmnHashes[1], operatorKeys[dmnHashes[1]], 1001, CScript(), coinbaseKey)));
+        block.vtx.emplace_back(MakeTransactionRef(CreateProUpServTx(utxos, dmnHashes[2], wrongOperatorKey, 1002, CScript(), coinbaseKey)));
+        block.vtx.emplace_back(MakeTransactionRef(CreateProUpRevTx(utxos, dmnHashes[3], operatorKeys[dmnHashes[3]], coinbaseKey)));
+
+        std::vector<CSpecialTxSigCheck> vChecks;
+        std::vector<bool> vSigsChecked;
+        {
+            LOCK(cs_main);
+            GetSpecialTxSigChecks(block, chainActive.Tip(), vChecks, vSigsChecked);
+        }
+        BOOST_ASSERT(vChecks.size() == 3 && vSigsChecked.size() == 3);
+        BOOST_CHECK(vSigsChecked[0] && vSigsChecked[1] && vSigsChecked[2]);
+        BOOST_CHECK(vChecks[0]());
+        BOOST_CHECK(!vChecks[1]());
+        BOOST_CHECK(vChecks[2]());
+    }
+
+    // a block with a bad operator sig fails the parallel special tx checks in ConnectBlock, which then
+    // lets ProcessSpecialTxsInBlock report the reason
+    {
+        BOOST_REQUIRE(nScriptCheckThreads > 1);
+        CBLSSecretKey wrongOperatorKey;
+        wrongOperatorKey.MakeNewKey();
+        auto badTx = CreateProUpServTx(utxos, dmnHashes[1], wrongOperatorKey, 1003, CScript(), coinbaseKey);
+
+        BlockCheckedListener listener;
+        RegisterValidationInterface(&listener);
+        CBlock block = CreateAndProcessBlock({badTx}, coinbaseKey);
+        UnregisterValidationInterface(&listener);
+
+        BOOST_CHECK(listener.hashBlock == block.GetHash());
+        BOOST_CHECK_EQUAL(listener.strRejectReason, "bad-protx-sig");
+        BOOST_CHECK_EQUAL(chainActive.Height(), nHeight);
+        {
+            LOCK(cs_main);
+            BOOST_REQUIRE(mapBlockIndex.count(block.GetHash()));
+            BOOST_CHECK(mapBlockIndex[block.GetHash()]->nStatus & BLOCK_FAILED_VALID);
+        }
+        dmn = deterministicMNManager->GetListAtChainTip().GetMN(dmnHashes[1]);
+        BOOST_ASSERT(dmn != nullptr && dmn->pdmnState->addr.GetPort() != 1003);
+    }
+
     // test ProUpRevTx
     tx = CreateProUpRevTx(utxos, dmnHashes[0], operatorKeys[dmnHashes[0]], coinbaseKey);
     CreateAndProcessBlock({tx}, coinbaseKey);
@@ -452,4 +514,166 @@ BOOST_FIXTURE_TEST_CASE(dip3_protx, TestChainDIP3Setup)
 
     const_cast<Consensus::Params&>(Params().GetConsensus()).DIP0003EnforcementHeight = DIP0003EnforcementHeightBackup;
 }
+
+static uint256 MNListCacheHash(int nHeight)
+{
+    return ArithToUint256(arith_uint256(nHeight + 1));
+}
+
+static void AddToMNListCache(CDeterministicMNListCache& cache, int nHeight, size_t nCost)
+{
+    cache.Add(CDeterministicMNList(MNListCacheHash(nHeight), nHeight, 0), nCost);
+}
+
+BOOST_FIXTURE_TEST_CASE(dip3_list_cache, BasicTestingSetup)
+{
+    const int LISTS_CACHE_SIZE = CDeterministicMNListCache::LISTS_CACHE_SIZE;
+
+    // insert and lookup
+    {
+        CDeterministicMNListCache cache(1000);
+        CDeterministicMNList mnList;
+        BOOST_CHECK(!cache.Get(MNListCacheHash(1), mnList));
+        AddToMNListCache(cache, 1, 10);
+        AddToMNListCache(cache, 2, 20);
+        BOOST_CHECK(cache.Get(MNListCacheHash(1), mnList));
+        BOOST_CHECK(mnList.GetBlockHash() == MNListCacheHash(1));
+        BOOST_CHECK_EQUAL(mnList.GetHeight(), 1);
+        BOOST_CHECK_EQUAL(cache.GetCount(), 2);
+        BOOST_CHECK_EQUAL(cache.GetSize(), 30);
+
+        // adding a list twice does not charge it twice
+        AddToMNListCache(cache, 2, 20);
+        BOOST_CHECK_EQUAL(cache.GetCount(), 2);
+        BOOST_CHECK_EQUAL(cache.GetSize(), 30);
+
+        cache.Erase(MNListCacheHash(1));
+        BOOST_CHECK(!cache.Get(MNListCacheHash(1), mnList));
+        BOOST_CHECK_EQUAL(cache.GetCount(), 1);
+        BOOST_CHECK_EQUAL(cache.GetSize(), 20);
+        BOOST_CHECK(!cache.IsFull());
+    }
+
+    // cleanup by height keeps the recent lists and the checkpoints of older ones
+    {
+        const int nTipHeight = 2000;
+        CDeterministicMNListCache cache(1000000);
+        size_t nExpected = 0;
+        for (int nHeight = 0; nHeight <= nTipHeight; nHeight++) {
+            AddToMNListCache(cache, nHeight, 1);
+            if (nHeight + LISTS_CACHE_SIZE >= nTipHeight || CDeterministicMNListCache::IsCheckpoint(nHeight, nTipHeight)) {
+                nExpected++;
+            }
+        }
+        cache.Cleanup(nTipHeight);
+        BOOST_CHECK_EQUAL(cache.GetCount(), nExpected);
+        BOOST_CHECK_EQUAL(cache.GetSize(), nExpected);
+        BOOST_CHECK(nExpected < (size_t)nTipHeight);
+
+        CDeterministicMNList mnList;
+        for (int nHeight = nTipHeight - LISTS_CACHE_SIZE; nHeight <= nTipHeight; nHeight++) {
+            BOOST_CHECK(cache.Get(MNListCacheHash(nHeight), mnList));
+        }
+        // just past the always kept range every second list is a checkpoint
+        BOOST_CHECK(cache.Get(MNListCacheHash(nTipHeight - LISTS_CACHE_SIZE - 2), mnList));
+        BOOST_CHECK(!cache.Get(MNListCacheHash(nTipHeight - LISTS_CACHE_SIZE - 1), mnList));
+        BOOST_CHECK(cache.Get(MNListCacheHash(0), mnList));
+        BOOST_CHECK(!cache.Get(MNListCacheHash(1), mnList));
+    }
+
+    // eviction at the bound only touches old lists, least recently used first
+    {
+        const int nTipHeight = 10000;
+        CDeterministicMNListCache cache(1500);
+        // multiples of 512 stay checkpoints at any distance
+        for (int i = 1; i <= 17; i++) {
+            AddToMNListCache(cache, i * 512, 100);
+        }
+        for (int nHeight = nTipHeight - 500; nHeight <= nTipHeight; nHeight++) {
+            AddToMNListCache(cache, nHeight, 1);
+        }
+        CDeterministicMNList mnList;
+        for (int i = 1; i <= 3; i++) {
+            BOOST_CHECK(cache.Get(MNListCacheHash(i * 512), mnList));
+        }
+        BOOST_CHECK(cache.IsFull());
+
+        cache.Cleanup(nTipHeight);
+        BOOST_CHECK(!cache.IsFull());
+        BOOST_CHECK(cache.GetSize() <= 1500 / 4 * 3);
+        for (int nHeight = nTipHeight - 500; nHeight <= nTipHeight; nHeight++) {
+            BOOST_CHECK(cache.Get(MNListCacheHash(nHeight), mnList));
+        }
+        // the 11 least recently used old lists are evicted
+        for (int i = 1; i <= 17; i++) {
+            bool fEvicted = i >= 4 && i <= 14;
+            BOOST_CHECK_EQUAL(cache.Get(MNListCacheHash(i * 512), mnList), !fEvicted);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(dip3_list_snapshot, BasicTestingSetup)
+{
+    CDeterministicMNList mnList(InsecureRand256(), 1000, 150);
+    for (int i = 0; i < 100; i++) {
+        auto dmn = std::make_shared<CDeterministicMN>();
+        dmn->proTxHash = InsecureRand256();
+        dmn->internalId = i * 3 + InsecureRandRange(3);
+        dmn->collateralOutpoint = COutPoint((i % 2) ? dmn->proTxHash : InsecureRand256(), i % 5);
+        dmn->nOperatorReward = i;
+
+        auto state = std::make_shared<CDeterministicMNState>();
+        state->nRegisteredHeight = i;
+        state->nLastPaidHeight = (i % 7) ? 900 - i : 0;
+        state->nPoSePenalty = i % 10;
+        state->nPoSeBanHeight = (i % 3) ? -1 : 800 + i;
+        if (i % 4 == 1) {
+            state->UpdateConfirmedHash(dmn->proTxHash, InsecureRand256());
+        } else if (i % 4 == 2) {
+            // not derived from proTxHash/confirmedHash, must be stored as is
+            state->confirmedHash = InsecureRand256();
+            state->confirmedHashWithProRegTxHash = InsecureRand256();
+        }
+        GetRandBytes(state->keyIDOwner.begin(), state->keyIDOwner.size());
+        GetRandBytes(state->keyIDVoting.begin(), state->keyIDVoting.size());
+        if (i % 3) {
+            CBLSSecretKey sk;
+            sk.MakeNewKey();
+            state->pubKeyOperator.Set(sk.GetPublicKey());
+            state->addr = LookupNumeric("1.1.1.1", 1000 + i);
+        }
+        state->scriptPayout = GetScriptForDestination(state->keyIDOwner);
+        dmn->pdmnState = state;
+        mnList.AddMN(dmn);
+    }
+
+    CDataStream ssSnapshot(SER_DISK, CLIENT_VERSION);
+    ssSnapshot << CDeterministicMNListSnapshot(mnList);
+    size_t snapshotSize = ssSnapshot.size();
+
+    CDeterministicMNListSnapshot snapshot;
+    ssSnapshot >> snapshot;
+    BOOST_CHECK(ssSnapshot.empty());
+
+    // the full format must be identical after a round trip through the snapshot format
+    CDataStream ss1(SER_DISK, CLIENT_VERSION);
+    CDataStream ss2(SER_DISK, CLIENT_VERSION);
+    ss1 << mnList;
+    ss2 << snapshot.mnList;
+    BOOST_CHECK(ss1.str() == ss2.str());
+    BOOST_CHECK(snapshotSize < ss1.size());
+
+    mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+        auto dmn2 = snapshot.mnList.GetMNByInternalId(dmn->internalId);
+        BOOST_ASSERT(dmn2 != nullptr);
+        BOOST_CHECK(dmn2->proTxHash == dmn->proTxHash);
+        BOOST_CHECK(snapshot.mnList.GetMNByCollateral(dmn->collateralOutpoint) == dmn2);
+    });
+
+    // unknown versions are rejected
+    CDataStream ssBad(SER_DISK, CLIENT_VERSION);
+    ssBad << CDeterministicMNListSnapshot(mnList);
+    ssBad[0] = (char)(CDeterministicMNList::SNAPSHOT_VERSION + 1);
+    BOOST_CHECK_THROW(ssBad >> snapshot, std::ios_base::failure);
+}
 BOOST_AUTO_TEST_SUITE_END()
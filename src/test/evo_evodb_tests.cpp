@@ -0,0 +1,101 @@
+// Copyright (c) 2018-2021 The Genix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "test/test_genix.h"
+
+#include "evo/evodb.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(evo_evodb_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(evodb_snapshot)
+{
+    CEvoDB db(1 << 20, true, true);
+
+    {
+        auto committer = db.BeginTransaction();
+        db.Write(std::string("a"), 1);
+        db.Write(std::string("b"), 2);
+        committer->Commit();
+    }
+    db.CommitRootTransaction();
+
+    auto snapshot1 = db.GetSnapshot();
+    int v;
+    BOOST_CHECK(snapshot1->Read(std::string("a"), v) && v == 1);
+    BOOST_CHECK(snapshot1->Exists(std::string("b")));
+
+    // a transaction in flight is not visible to readers of the committed state
+    auto committer = db.BeginTransaction();
+    db.Write(std::string("a"), 3);
+    db.Erase(std::string("b"));
+    db.Write(std::string("c"), 4);
+    BOOST_CHECK(db.Read(std::string("a"), v) && v == 3);
+    BOOST_CHECK(db.GetSnapshot()->Read(std::string("a"), v) && v == 1);
+    BOOST_CHECK(db.GetSnapshot()->Exists(std::string("b")));
+    BOOST_CHECK(!db.GetSnapshot()->Exists(std::string("c")));
+    BOOST_CHECK(db.ReadImmutable(std::string("c"), v) && v == 4);
+
+    // once committed, new snapshots see it through the overlay while old ones keep their view
+    committer->Commit();
+    auto snapshot2 = db.GetSnapshot();
+    BOOST_CHECK(snapshot2->Read(std::string("a"), v) && v == 3);
+    BOOST_CHECK(!snapshot2->Exists(std::string("b")));
+    BOOST_CHECK(snapshot2->Read(std::string("c"), v) && v == 4);
+    BOOST_CHECK(snapshot1->Read(std::string("a"), v) && v == 1);
+    BOOST_CHECK(snapshot1->Exists(std::string("b")));
+
+    // flushing to disk doesn't change what the snapshots see
+    db.CommitRootTransaction();
+    auto snapshot3 = db.GetSnapshot();
+    BOOST_CHECK(snapshot3->Read(std::string("a"), v) && v == 3);
+    BOOST_CHECK(!snapshot3->Exists(std::string("b")));
+    BOOST_CHECK(snapshot2->Read(std::string("c"), v) && v == 4);
+    BOOST_CHECK(snapshot1->Read(std::string("a"), v) && v == 1);
+    BOOST_CHECK(!snapshot1->Exists(std::string("c")));
+}
+
+BOOST_AUTO_TEST_CASE(evodb_commit_serialized)
+{
+    CEvoDB db(1 << 20, true, true);
+    std::vector<unsigned char> big(10000, 7);
+
+    size_t nUsageBefore = db.GetMemoryUsage();
+    {
+        auto committer = db.BeginTransaction();
+        db.Write(std::string("a"), 1);
+        db.Write(std::string("big"), big);
+        committer->Commit();
+    }
+    // the committed values are shared by the root transaction and the snapshot overlay and only accounted once
+    size_t nUsage = db.GetMemoryUsage() - nUsageBefore;
+    BOOST_CHECK(nUsage >= big.size() && nUsage < big.size() * 2);
+
+    // the root transaction hands out the serialized values, both directly and through iterators
+    int v;
+    std::vector<unsigned char> big2;
+    BOOST_CHECK(db.Read(std::string("a"), v) && v == 1);
+    BOOST_CHECK(db.Read(std::string("big"), big2) && big2 == big);
+    BOOST_CHECK(db.GetSnapshot()->Read(std::string("big"), big2) && big2 == big);
+    {
+        auto it = db.GetCurTransaction().NewIteratorUniquePtr();
+        it->Seek(std::string("a"));
+        std::string key;
+        BOOST_CHECK(it->Valid() && it->GetKey(key) && key == "a" && it->GetValue(v) && v == 1);
+    }
+
+    // overwriting them in a later block works as before
+    {
+        auto committer = db.BeginTransaction();
+        db.Write(std::string("a"), 2);
+        db.Erase(std::string("big"));
+        committer->Commit();
+    }
+    db.CommitRootTransaction();
+    BOOST_CHECK(db.GetRawDB().Read(std::string("a"), v) && v == 2);
+    BOOST_CHECK(!db.GetRawDB().Exists(std::string("big")));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
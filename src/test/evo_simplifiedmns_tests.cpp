@@ -4,7 +4,9 @@
 
 #include "test/test_genix.h"
 
+#include "arith_uint256.h"
 #include "bls/bls.h"
+#include "consensus/merkle.h"
 #include "evo/simplifiedmns.h"
 #include "netbase.h"
 
@@ -70,4 +72,60 @@ BOOST_AUTO_TEST_CASE(simplifiedmns_merkleroots)
 
     BOOST_CHECK(expectedMerkleRoot == calculatedMerkleRoot);
 }
+
+BOOST_AUTO_TEST_CASE(simplifiedmns_merkletree_incremental)
+{
+    std::map<uint256, uint256> entries;
+    CSimplifiedMNListMerkleTree tree;
+    BOOST_CHECK(tree.GetRoot().IsNull());
+
+    for (int round = 0; round < 200; round++) {
+        std::set<uint256> toRemove;
+        std::map<uint256, uint256> toSet;
+
+        // mostly updates, some additions and removals, and sometimes nothing at all
+        int nChanges = InsecureRandRange(8);
+        for (int i = 0; i < nChanges; i++) {
+            int type = InsecureRandRange(4);
+            if (type == 0 && !entries.empty()) {
+                auto it = std::next(entries.begin(), InsecureRandRange(entries.size()));
+                if (!toSet.count(it->first)) {
+                    toRemove.emplace(it->first);
+                }
+            } else if (type == 1 || entries.empty()) {
+                toSet.emplace(InsecureRand256(), InsecureRand256());
+            } else {
+                auto it = std::next(entries.begin(), InsecureRandRange(entries.size()));
+                if (!toRemove.count(it->first)) {
+                    toSet[it->first] = InsecureRand256();
+                }
+            }
+        }
+        for (const auto& h : toRemove) {
+            entries.erase(h);
+        }
+        for (const auto& p : toSet) {
+            entries[p.first] = p.second;
+        }
+        tree.Update(toRemove, toSet);
+
+        std::vector<uint256> leaves;
+        for (const auto& p : entries) {
+            leaves.emplace_back(p.second);
+        }
+        bool mutated1, mutated2;
+        uint256 expectedRoot = ComputeMerkleRoot(leaves, &mutated1);
+        BOOST_CHECK_EQUAL(tree.Size(), entries.size());
+        BOOST_CHECK(tree.GetRoot(&mutated2) == expectedRoot);
+        BOOST_CHECK_EQUAL(mutated1, mutated2);
+    }
+
+    // two identical neighbours are detected as mutation, same as in ComputeMerkleRoot
+    tree.Clear();
+    uint256 h = InsecureRand256();
+    tree.Update({}, {{ArithToUint256(1), h}, {ArithToUint256(2), h}, {ArithToUint256(3), InsecureRand256()}});
+    bool mutated = false;
+    tree.GetRoot(&mutated);
+    BOOST_CHECK(mutated);
+}
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "hash.h"
+#include "primitives/block.h"
 #include "utilstrencodings.h"
 #include "test/test_genix.h"
 
@@ -149,4 +150,151 @@ BOOST_AUTO_TEST_CASE(siphash)
     BOOST_CHECK_EQUAL(SipHashUint256(1, 2, ss.GetHash()), 0x79751e980c2a0a35ULL);
 }
 
+BOOST_AUTO_TEST_CASE(blockheader_hash_cache)
+{
+    CBlockHeader header;
+    header.nVersion = 4;
+    header.hashPrevBlock = uint256S("0123456789abcdeffedcba987654321000112233445566778899aabbccddeeff");
+    header.hashMerkleRoot = uint256S("00112233445566778899aabbccddeeff0123456789abcdeffedcba9876543210");
+    header.nTime = 1540000000;
+    header.nBits = 0x1e0ffff0;
+
+    uint256 hash = header.GetHash();
+    BOOST_CHECK(hash == HashX16R(BEGIN(header.nVersion), END(header.nNonce), header.hashPrevBlock));
+    BOOST_CHECK(header.GetHash() == hash);
+
+    // mutating any field must invalidate the cached hash
+    header.nNonce++;
+    uint256 hash2 = header.GetHash();
+    BOOST_CHECK(hash2 != hash);
+    BOOST_CHECK(hash2 == HashX16R(BEGIN(header.nVersion), END(header.nNonce), header.hashPrevBlock));
+    header.nNonce--;
+    BOOST_CHECK(header.GetHash() == hash);
+
+    // copies carry the cache, but stay independent
+    CBlock block(header);
+    BOOST_CHECK(block.GetHash() == hash);
+    BOOST_CHECK(block.GetBlockHeader().GetHash() == hash);
+    block.nTime++;
+    BOOST_CHECK(block.GetHash() != hash);
+    BOOST_CHECK(header.GetHash() == hash);
+
+    // a wrongly seeded hash sticks only as long as the header is unchanged
+    header.SetCachedHash(uint256());
+    BOOST_CHECK(header.GetHash() == uint256());
+    header.nNonce++;
+    BOOST_CHECK(header.GetHash() == hash2);
+
+    block.SetNull();
+    BOOST_CHECK(block.GetHash() == HashX16R(BEGIN(block.nVersion), END(block.nNonce), block.hashPrevBlock));
+}
+
+BOOST_AUTO_TEST_CASE(blockheader_hash_cache_concurrent)
+{
+    // threads computing, reading and copying the cached hash of a shared header at the
+    // same time must all see the right hash
+    for (int i = 0; i < 10; i++) {
+        CBlockHeader header;
+        header.hashPrevBlock = InsecureRand256();
+        header.nNonce = InsecureRand32();
+        const uint256 hash = HashX16R(BEGIN(header.nVersion), END(header.nNonce), header.hashPrevBlock);
+
+        std::atomic<int> nFailures{0};
+        boost::thread_group threads;
+        for (int j = 0; j < 4; j++) {
+            threads.create_thread([&] {
+                for (int k = 0; k < 5; k++) {
+                    CBlockHeader copy(header);
+                    if (header.GetHash() != hash || copy.GetHash() != hash) {
+                        nFailures++;
+                    }
+                }
+            });
+        }
+        threads.join_all();
+        BOOST_CHECK_EQUAL(nFailures.load(), 0);
+        BOOST_CHECK(header.HasCachedHash());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(blockheader_hash_cache_batch)
+{
+    std::vector<CBlockHeader> vHeaders(10);
+    for (auto& header : vHeaders) {
+        header.hashPrevBlock = InsecureRand256();
+        header.nNonce = InsecureRand32();
+    }
+    CacheBlockHeaderHashes(vHeaders);
+    for (const auto& header : vHeaders) {
+        BOOST_CHECK(header.HasCachedHash());
+        BOOST_CHECK(header.GetHash() == HashX16R(BEGIN(header.nVersion), END(header.nNonce), header.hashPrevBlock));
+    }
+}
+
+#if ENABLE_X16R_STATS
+BOOST_AUTO_TEST_CASE(x16r_stats)
+{
+    ResetX16RStats();
+    uint256 prevBlockHash = uint256S("fedcba9876543210fedcba9876543210fedcba9876543210fedcba9876543210");
+    std::vector<unsigned char> data(CBlockHeader::HEADER_SIZE);
+    HashX16R(data.begin(), data.end(), prevBlockHash);
+
+    // the last 16 nibbles of prevBlockHash select every algorithm exactly once
+    std::array<X16RAlgoStats, 16> stats = GetX16RStats();
+    uint64_t nBytes = 0;
+    for (int algo = 0; algo < 16; algo++) {
+        BOOST_CHECK_EQUAL(stats[algo].nHits, 1);
+        nBytes += stats[algo].nBytes;
+    }
+    BOOST_CHECK_EQUAL(nBytes, CBlockHeader::HEADER_SIZE + 15 * 64);
+    BOOST_CHECK_EQUAL(GetX16RAlgoName(GetHashSelection(prevBlockHash, 0)), std::string("sha512"));
+
+    ResetX16RStats();
+    BOOST_CHECK_EQUAL(GetX16RStats()[0].nHits, 0);
+}
+#endif // ENABLE_X16R_STATS
+
+/** X16R built directly from the sph reference implementations, for checking the accelerated ones */
+static uint256 RefHashX16R(const unsigned char* data, size_t len, const uint256& prevBlockHash)
+{
+    uint512 hash[16];
+    for (int i = 0; i < 16; i++) {
+        const void* in = i == 0 ? (const void*)data : (const void*)&hash[i - 1];
+        size_t inLen = i == 0 ? len : 64;
+        switch (GetHashSelection(prevBlockHash, i)) {
+        case 0: { sph_blake512_context c; sph_blake512_init(&c); sph_blake512(&c, in, inLen); sph_blake512_close(&c, &hash[i]); break; }
+        case 1: { sph_bmw512_context c; sph_bmw512_init(&c); sph_bmw512(&c, in, inLen); sph_bmw512_close(&c, &hash[i]); break; }
+        case 2: { sph_groestl512_context c; sph_groestl512_init(&c); sph_groestl512(&c, in, inLen); sph_groestl512_close(&c, &hash[i]); break; }
+        case 3: { sph_jh512_context c; sph_jh512_init(&c); sph_jh512(&c, in, inLen); sph_jh512_close(&c, &hash[i]); break; }
+        case 4: { sph_keccak512_context c; sph_keccak512_init(&c); sph_keccak512(&c, in, inLen); sph_keccak512_close(&c, &hash[i]); break; }
+        case 5: { sph_skein512_context c; sph_skein512_init(&c); sph_skein512(&c, in, inLen); sph_skein512_close(&c, &hash[i]); break; }
+        case 6: { sph_luffa512_context c; sph_luffa512_init(&c); sph_luffa512(&c, in, inLen); sph_luffa512_close(&c, &hash[i]); break; }
+        case 7: { sph_cubehash512_context c; sph_cubehash512_init(&c); sph_cubehash512(&c, in, inLen); sph_cubehash512_close(&c, &hash[i]); break; }
+        case 8: { sph_shavite512_context c; sph_shavite512_init(&c); sph_shavite512(&c, in, inLen); sph_shavite512_close(&c, &hash[i]); break; }
+        case 9: { sph_simd512_context c; sph_simd512_init(&c); sph_simd512(&c, in, inLen); sph_simd512_close(&c, &hash[i]); break; }
+        case 10: { sph_echo512_context c; sph_echo512_init(&c); sph_echo512(&c, in, inLen); sph_echo512_close(&c, &hash[i]); break; }
+        case 11: { sph_hamsi512_context c; sph_hamsi512_init(&c); sph_hamsi512(&c, in, inLen); sph_hamsi512_close(&c, &hash[i]); break; }
+        case 12: { sph_fugue512_context c; sph_fugue512_init(&c); sph_fugue512(&c, in, inLen); sph_fugue512_close(&c, &hash[i]); break; }
+        case 13: { sph_shabal512_context c; sph_shabal512_init(&c); sph_shabal512(&c, in, inLen); sph_shabal512_close(&c, &hash[i]); break; }
+        case 14: { sph_whirlpool_context c; sph_whirlpool_init(&c); sph_whirlpool(&c, in, inLen); sph_whirlpool_close(&c, &hash[i]); break; }
+        case 15: { sph_sha512_context c; sph_sha512_init(&c); sph_sha512(&c, in, inLen); sph_sha512_close(&c, &hash[i]); break; }
+        }
+    }
+    return hash[15].trim256();
+}
+
+BOOST_AUTO_TEST_CASE(x16r_implementations)
+{
+    // BasicTestingSetup ran X16RAutoDetect, so this uses the accelerated implementations if available
+    BOOST_TEST_MESSAGE("X16R implementation: " << X16RAutoDetect());
+    for (int i = 0; i < 200; i++) {
+        std::vector<unsigned char> data(i % 10 == 0 ? InsecureRandRange(300) : CBlockHeader::HEADER_SIZE);
+        for (auto& c : data) {
+            c = InsecureRandBits(8);
+        }
+        uint256 prevBlockHash = InsecureRand256();
+        BOOST_CHECK(HashX16R(data.begin(), data.end(), prevBlockHash) == RefHashX16R(data.data(), data.size(), prevBlockHash));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,226 @@
+// Copyright (c) 2018-2021 The Genix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "test/test_genix.h"
+
+#include "llmq/quorums_signing.h"
+#include "llmq/quorums_signing_shares.h"
+#include "streams.h"
+#include "version.h"
+
+#include <atomic>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+using namespace llmq;
+
+// CSigSharesInv as it was serialized before it was packed into words
+struct LegacySigSharesInv
+{
+    uint32_t sessionId{(uint32_t)-1};
+    std::vector<bool> inv;
+
+    ADD_SERIALIZE_METHODS
+
+    template<typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        uint64_t invSize = inv.size();
+
+        READWRITE(VARINT(sessionId));
+        READWRITE(COMPACTSIZE(invSize));
+        READWRITE(AUTOBITSET(inv, (size_t)invSize));
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(llmq_sigshares_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(sigsharesinv_bits)
+{
+    CSigSharesInv inv;
+    BOOST_CHECK(!inv.IsInitialized());
+    inv.Init(400);
+    BOOST_CHECK(inv.IsInitialized());
+    BOOST_CHECK_EQUAL(inv.Size(), 400);
+    BOOST_CHECK_EQUAL(inv.CountSet(), 0);
+
+    inv.Set(0, true);
+    inv.Set(63, true);
+    inv.Set(64, true);
+    inv.Set(399, true);
+    BOOST_CHECK(inv.IsSet(63) && inv.IsSet(64) && !inv.IsSet(65));
+    BOOST_CHECK_EQUAL(inv.CountSet(), 4);
+    BOOST_CHECK_EQUAL(inv.ToString(), "(0,63,64,399)");
+
+    CSigSharesInv inv2;
+    inv2.Init(400);
+    inv2.Set(64, true);
+    inv2.Set(200, true);
+
+    CSigSharesInv merged = inv;
+    merged.Merge(inv2);
+    BOOST_CHECK_EQUAL(merged.ToString(), "(0,63,64,200,399)");
+
+    merged.AndNot(inv2);
+    BOOST_CHECK_EQUAL(merged.ToString(), "(0,63,399)");
+
+    merged.SetAll(true);
+    BOOST_CHECK_EQUAL(merged.CountSet(), 400);
+    merged.Set(10, false);
+    BOOST_CHECK_EQUAL(merged.CountSet(), 399);
+    merged.SetAll(false);
+    BOOST_CHECK_EQUAL(merged.CountSet(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(sigsharesinv_serialization)
+{
+    // sparse invs are serialized as varints, dense ones as fixed bitsets
+    for (size_t step : {1, 2, 3, 50, 399}) {
+        LegacySigSharesInv legacy;
+        legacy.sessionId = (uint32_t)step;
+        legacy.inv.resize(400);
+
+        CSigSharesInv inv;
+        inv.sessionId = (uint32_t)step;
+        inv.Init(400);
+
+        for (size_t i = 0; i < 400; i += step) {
+            legacy.inv[i] = true;
+            inv.Set((uint16_t)i, true);
+        }
+
+        CDataStream ss1(SER_NETWORK, PROTOCOL_VERSION);
+        CDataStream ss2(SER_NETWORK, PROTOCOL_VERSION);
+        ss1 << legacy;
+        ss2 << inv;
+        BOOST_CHECK(ss1.str() == ss2.str());
+
+        CSigSharesInv inv2;
+        ss1 >> inv2;
+        BOOST_CHECK_EQUAL(inv2.sessionId, inv.sessionId);
+        BOOST_CHECK_EQUAL(inv2.Size(), inv.Size());
+        BOOST_CHECK_EQUAL(inv2.ToString(), inv.ToString());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sigsharemap)
+{
+    uint256 signHash1 = InsecureRand256();
+    uint256 signHash2 = InsecureRand256();
+
+    SigShareMap<int64_t> map;
+    BOOST_CHECK(map.Empty());
+    BOOST_CHECK(map.Add(std::make_pair(signHash1, (uint16_t)5), 5));
+    BOOST_CHECK(!map.Add(std::make_pair(signHash1, (uint16_t)5), 6));
+    BOOST_CHECK(map.Add(std::make_pair(signHash1, (uint16_t)1), 1));
+    BOOST_CHECK(map.Add(std::make_pair(signHash2, (uint16_t)300), 300));
+    BOOST_CHECK_EQUAL(map.Size(), 3);
+    BOOST_CHECK_EQUAL(map.CountForSignHash(signHash1), 2);
+    BOOST_CHECK_EQUAL(*map.Get(std::make_pair(signHash1, (uint16_t)5)), 5);
+    BOOST_CHECK(!map.Get(std::make_pair(signHash1, (uint16_t)2)));
+    BOOST_CHECK(!map.Has(std::make_pair(signHash2, (uint16_t)301)));
+
+    std::vector<uint16_t> members;
+    map.ForEachForSignHash(signHash1, [&](uint16_t quorumMember, int64_t v) {
+        BOOST_CHECK_EQUAL(quorumMember, v);
+        members.emplace_back(quorumMember);
+    });
+    BOOST_CHECK(members == std::vector<uint16_t>({1, 5}));
+
+    map.EraseIf([&](const SigShareKey& k, int64_t v) {
+        return v == 1;
+    });
+    BOOST_CHECK_EQUAL(map.CountForSignHash(signHash1), 1);
+    map.Erase(std::make_pair(signHash1, (uint16_t)5));
+    BOOST_CHECK_EQUAL(map.CountForSignHash(signHash1), 0);
+    map.EraseAllForSignHash(signHash2);
+    BOOST_CHECK(map.Empty());
+
+    ConcurrentSigShareMap<int64_t> cmap;
+    for (uint16_t i = 0; i < 100; i++) {
+        BOOST_CHECK(cmap.Add(std::make_pair(i % 2 ? signHash1 : signHash2, i), i));
+    }
+    BOOST_CHECK_EQUAL(cmap.CountForSignHash(signHash1), 50);
+    int64_t v;
+    BOOST_CHECK(cmap.Get(std::make_pair(signHash2, (uint16_t)42), v) && v == 42);
+    BOOST_CHECK(!cmap.Get(std::make_pair(signHash2, (uint16_t)43), v));
+    size_t count = 0;
+    cmap.ForEach([&](const SigShareKey& k, int64_t) {
+        count++;
+    });
+    BOOST_CHECK_EQUAL(count, 100);
+    cmap.EraseAllForSignHash(signHash1);
+    BOOST_CHECK(!cmap.Has(std::make_pair(signHash1, (uint16_t)1)));
+    BOOST_CHECK(cmap.Has(std::make_pair(signHash2, (uint16_t)0)));
+
+    // only the members which were added are visited, in ascending order
+    SigShareMap<int64_t> sparseMap;
+    BOOST_CHECK(sparseMap.Add(std::make_pair(signHash1, (uint16_t)399), 399));
+    BOOST_CHECK(sparseMap.Add(std::make_pair(signHash1, (uint16_t)7), 7));
+    BOOST_CHECK_EQUAL(*sparseMap.GetFirst(), 7);
+    members.clear();
+    sparseMap.ForEachForSignHash(signHash1, [&](uint16_t quorumMember, int64_t v) {
+        members.emplace_back(quorumMember);
+    });
+    BOOST_CHECK(members == std::vector<uint16_t>({7, 399}));
+}
+
+// Mimics CSigSharesManager: shares are added together with per session bookkeeping and a cleanup scans and removes
+// whole sessions, all with one lock held. No session may end up with bookkeeping but no shares or vice versa
+BOOST_AUTO_TEST_CASE(sigsharemap_concurrent)
+{
+    const int SESSION_COUNT = 64;
+    const int THREAD_COUNT = 4;
+
+    std::vector<uint256> signHashes;
+    for (int i = 0; i < SESSION_COUNT; i++) {
+        signHashes.emplace_back(InsecureRand256());
+    }
+
+    CCriticalSection cs;
+    ConcurrentSigShareMap<int64_t> cmap;
+    std::unordered_map<uint256, int64_t, StaticSaltedHasher> timeSeenForSessions;
+    std::atomic<bool> fStop{false};
+
+    boost::thread_group threads;
+    for (int t = 0; t < THREAD_COUNT; t++) {
+        threads.create_thread([&, t]() {
+            FastRandomContext rnd;
+            for (int i = 0; i < 20000; i++) {
+                auto& signHash = signHashes[rnd.randrange(SESSION_COUNT)];
+                uint16_t quorumMember = (uint16_t)rnd.randrange(400);
+                LOCK(cs);
+                if (cmap.Add(std::make_pair(signHash, quorumMember), t)) {
+                    timeSeenForSessions[signHash] = i;
+                }
+            }
+        });
+    }
+    boost::thread cleanupThread([&]() {
+        while (!fStop) {
+            LOCK(cs);
+            std::unordered_set<uint256, StaticSaltedHasher> sessions;
+            cmap.ForEach([&](const SigShareKey& k, int64_t) {
+                if (k.first.GetCheapHash() % 2) {
+                    sessions.emplace(k.first);
+                }
+            });
+            for (auto& signHash : sessions) {
+                cmap.EraseAllForSignHash(signHash);
+                timeSeenForSessions.erase(signHash);
+            }
+        }
+    });
+    threads.join_all();
+    fStop = true;
+    cleanupThread.join();
+
+    LOCK(cs);
+    for (auto& signHash : signHashes) {
+        BOOST_CHECK_EQUAL(cmap.CountForSignHash(signHash) != 0, timeSeenForSessions.count(signHash) != 0);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,83 @@
+// Copyright (c) 2018-2021 The Genix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "test/test_genix.h"
+
+#include "llmq/quorums_utils.h"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace llmq;
+
+static CQuorumMembersCPtr MakeQuorumMembers(size_t count)
+{
+    std::vector<CDeterministicMNCPtr> members;
+    for (size_t i = 0; i < count; i++) {
+        auto dmn = std::make_shared<CDeterministicMN>();
+        dmn->proTxHash = InsecureRand256();
+        dmn->internalId = i;
+        members.emplace_back(dmn);
+    }
+    return std::make_shared<const CQuorumMembers>(std::move(members));
+}
+
+static CQuorumMembersCache::QuorumKey MakeKey(uint8_t n)
+{
+    return CQuorumMembersCache::QuorumKey(Consensus::LLMQ_50_60, uint256S(strprintf("%02x", n)));
+}
+
+BOOST_FIXTURE_TEST_SUITE(llmq_utils_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(quorum_members_index)
+{
+    auto quorumMembers = MakeQuorumMembers(10);
+    for (size_t i = 0; i < quorumMembers->members.size(); i++) {
+        BOOST_CHECK_EQUAL(quorumMembers->GetMemberIndex(quorumMembers->members[i]->proTxHash), (int)i);
+    }
+    BOOST_CHECK_EQUAL(quorumMembers->GetMemberIndex(InsecureRand256()), -1);
+}
+
+BOOST_AUTO_TEST_CASE(quorum_members_cache)
+{
+    CQuorumMembersCache cache(3);
+    std::vector<CQuorumMembersCPtr> vMembers;
+    for (uint8_t i = 0; i < 4; i++) {
+        vMembers.emplace_back(MakeQuorumMembers(5));
+    }
+
+    CQuorumMembersCPtr ret;
+    BOOST_CHECK(!cache.Get(MakeKey(0), ret));
+
+    for (uint8_t i = 0; i < 3; i++) {
+        cache.Add(MakeKey(i), vMembers[i]);
+    }
+    BOOST_CHECK_EQUAL(cache.Size(), 3);
+    BOOST_CHECK(cache.Get(MakeKey(1), ret));
+    BOOST_CHECK(ret == vMembers[1]);
+
+    // adding an existing quorum keeps the first entry
+    cache.Add(MakeKey(1), vMembers[3]);
+    BOOST_CHECK(cache.Get(MakeKey(1), ret));
+    BOOST_CHECK(ret == vMembers[1]);
+    BOOST_CHECK_EQUAL(cache.Size(), 3);
+
+    // quorum 0 is the least recently used one now, quorum 1 and 2 were looked up or added after it
+    BOOST_CHECK(cache.Get(MakeKey(2), ret));
+    cache.Add(MakeKey(3), vMembers[3]);
+    BOOST_CHECK_EQUAL(cache.Size(), 3);
+    BOOST_CHECK(!cache.Get(MakeKey(0), ret));
+    for (uint8_t i = 1; i < 4; i++) {
+        BOOST_CHECK(cache.Get(MakeKey(i), ret));
+        BOOST_CHECK(ret == vMembers[i]);
+    }
+
+    // looking up quorum 1 again protects it from the next eviction
+    BOOST_CHECK(cache.Get(MakeKey(1), ret));
+    cache.Add(MakeKey(0), vMembers[0]);
+    BOOST_CHECK(!cache.Get(MakeKey(2), ret));
+    BOOST_CHECK(cache.Get(MakeKey(1), ret));
+    BOOST_CHECK(cache.Get(MakeKey(0), ret));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,153 @@
+// Copyright (c) 2018-2019 The Genix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "consensus/validation.h"
+#include "fs.h"
+#include "script/sign.h"
+#include "streams.h"
+#include "txmempool.h"
+#include "util.h"
+#include "validation.h"
+#include "test/test_genix.h"
+
+#include <boost/test/unit_test.hpp>
+
+struct MempoolPersistSetup : public TestChain100Setup
+{
+    CScript scriptPubKey;
+    // a parent with two outputs, a child and grandchild spending the first and a child spending the second
+    std::vector<CTransactionRef> txs;
+    uint256 hashUnknownTx;
+
+    MempoolPersistSetup()
+    {
+        scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+        txs.push_back(Spend(COutPoint(coinbaseTxns[0].GetHash(), 0), 11 * CENT, 2));
+        txs.push_back(Spend(COutPoint(txs[0]->GetHash(), 0), 10 * CENT));
+        txs.push_back(Spend(COutPoint(txs[1]->GetHash(), 0), 9 * CENT));
+        txs.push_back(Spend(COutPoint(txs[0]->GetHash(), 1), 10 * CENT));
+        hashUnknownTx = GetRandHash();
+    }
+
+    CTransactionRef Spend(const COutPoint& prevout, CAmount nValue, size_t nOutputs = 1)
+    {
+        CMutableTransaction tx;
+        tx.nVersion = 1;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = prevout;
+        tx.vout.resize(nOutputs);
+        for (auto& txout : tx.vout) {
+            txout.nValue = nValue;
+            txout.scriptPubKey = scriptPubKey;
+        }
+
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        tx.vin[0].scriptSig = CScript() << vchSig;
+        return MakeTransactionRef(tx);
+    }
+
+    void FillMempool()
+    {
+        LOCK(cs_main);
+        for (const auto& tx : txs) {
+            CValidationState state;
+            BOOST_CHECK(AcceptToMemoryPool(mempool, state, tx, false, nullptr, true, 0));
+        }
+        mempool.PrioritiseTransaction(txs[3]->GetHash(), 1000);
+        mempool.PrioritiseTransaction(hashUnknownTx, 2000);
+    }
+
+    void ClearMempool()
+    {
+        mempool.clear();
+        for (const auto& tx : txs) {
+            mempool.ClearPrioritisation(tx->GetHash());
+        }
+        mempool.ClearPrioritisation(hashUnknownTx);
+    }
+
+    CAmount GetDelta(const uint256& hash)
+    {
+        CAmount nDelta = 0;
+        mempool.ApplyDelta(hash, nDelta);
+        return nDelta;
+    }
+
+    void CheckMempoolRestored()
+    {
+        BOOST_CHECK_EQUAL(mempool.size(), txs.size());
+        for (const auto& tx : txs) {
+            BOOST_CHECK(mempool.exists(tx->GetHash()));
+        }
+        BOOST_CHECK_EQUAL(GetDelta(txs[3]->GetHash()), 1000);
+        BOOST_CHECK_EQUAL(GetDelta(hashUnknownTx), 2000);
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(mempool_persist_tests, MempoolPersistSetup)
+
+BOOST_AUTO_TEST_CASE(mempool_persist_roundtrip)
+{
+    FillMempool();
+    DumpMempool();
+    ClearMempool();
+    BOOST_CHECK_EQUAL(mempool.size(), 0);
+
+    // the child and grandchild are accepted in the batches after their parent's
+    BOOST_CHECK(LoadMempool());
+    CheckMempoolRestored();
+    ClearMempool();
+}
+
+BOOST_AUTO_TEST_CASE(mempool_persist_checksum)
+{
+    FillMempool();
+    DumpMempool();
+    ClearMempool();
+
+    // flip a bit in the first transaction
+    fs::path path = GetDataDir() / "mempool.dat";
+    FILE* file = fsbridge::fopen(path, "r+b");
+    BOOST_REQUIRE(file);
+    BOOST_CHECK_EQUAL(fseek(file, 20, SEEK_SET), 0);
+    int c = fgetc(file);
+    BOOST_CHECK_EQUAL(fseek(file, 20, SEEK_SET), 0);
+    fputc(c ^ 1, file);
+    fclose(file);
+
+    BOOST_CHECK(!LoadMempool());
+    BOOST_CHECK_EQUAL(mempool.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(mempool_persist_v1)
+{
+    FillMempool();
+    std::vector<TxMempoolInfo> vinfo = mempool.infoAll();
+    std::map<uint256, CAmount> mapDeltas;
+    mapDeltas.emplace(hashUnknownTx, 2000);
+    ClearMempool();
+
+    // files written before the fee, size and sigops were stored are still loaded
+    {
+        CAutoFile file(fsbridge::fopen(GetDataDir() / "mempool.dat", "wb"), SER_DISK, CLIENT_VERSION);
+        BOOST_REQUIRE(!file.IsNull());
+        file << (uint64_t)1;
+        file << (uint64_t)vinfo.size();
+        for (const auto& info : vinfo) {
+            file << *info.tx;
+            file << (int64_t)info.nTime;
+            file << (int64_t)info.nFeeDelta;
+        }
+        file << mapDeltas;
+    }
+
+    BOOST_CHECK(LoadMempool());
+    CheckMempoolRestored();
+    ClearMempool();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "arith_uint256.h"
 #include "txmempool.h"
 #include "util.h"
 
@@ -580,4 +581,79 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     SetMockTime(0);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolAddressSpentIndexTest)
+{
+    CMempoolAddressIndex addressIndex;
+    CMempoolSpentIndex spentIndex;
+    uint160 hotAddress(std::vector<unsigned char>(20, 0x01));
+    uint160 otherAddress(std::vector<unsigned char>(20, 0x02));
+
+    // Enough txs to move the deltas of the hot address out of the pool
+    std::vector<CTransaction> txs;
+    for (unsigned int i = 0; i < 2000; i++) {
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        mtx.vin[0].prevout = COutPoint(ArithToUint256(arith_uint256(i + 1)), i % 3);
+        mtx.vout.resize(1);
+        mtx.vout[0].nValue = i;
+        txs.emplace_back(mtx);
+        const uint256& txhash = txs.back().GetHash();
+
+        std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>> deltas;
+        deltas.emplace_back(CMempoolAddressDeltaKey(1, hotAddress, txhash, 0, 0), CMempoolAddressDelta(i, i));
+        if (i % 2 == 0) {
+            deltas.emplace_back(CMempoolAddressDeltaKey(2, otherAddress, txhash, 0, 1), CMempoolAddressDelta(i, -1, mtx.vin[0].prevout.hash, mtx.vin[0].prevout.n));
+            deltas.emplace_back(CMempoolAddressDeltaKey(2, otherAddress, txhash, 1, 0), CMempoolAddressDelta(i, 1));
+        }
+        addressIndex.AddTx(txhash, deltas);
+
+        std::vector<std::pair<CSpentIndexKey, CSpentIndexValue>> spent;
+        spent.emplace_back(CSpentIndexKey(mtx.vin[0].prevout.hash, mtx.vin[0].prevout.n), CSpentIndexValue(txhash, 0, -1, i, 1, hotAddress));
+        spentIndex.AddTx(spent);
+    }
+
+    std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>> results;
+    addressIndex.GetDeltas(hotAddress, 1, results);
+    BOOST_CHECK_EQUAL(results.size(), 2000);
+    BOOST_CHECK(std::is_sorted(results.begin(), results.end(), [](const std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>& a, const std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>& b) {
+        return CMempoolAddressDeltaKeyCompare()(a.first, b.first);
+    }));
+    results.clear();
+    addressIndex.GetDeltas(hotAddress, 2, results);
+    BOOST_CHECK(results.empty());
+    addressIndex.GetDeltas(otherAddress, 2, results);
+    BOOST_CHECK_EQUAL(results.size(), 2000);
+    BOOST_CHECK(results[0].first.txhash == results[1].first.txhash);
+    BOOST_CHECK(results[0].first.spending == 1 && results[0].second.amount == -1);
+    BOOST_CHECK(results[0].second.prevhash != uint256() && results[1].second.prevhash == uint256());
+    BOOST_CHECK(addressIndex.DynamicMemoryUsage() > 0);
+
+    CSpentIndexValue value;
+    BOOST_CHECK(spentIndex.Get(CSpentIndexKey(txs[10].vin[0].prevout.hash, txs[10].vin[0].prevout.n), value));
+    BOOST_CHECK(value.txid == txs[10].GetHash() && value.satoshis == 10);
+    BOOST_CHECK(!spentIndex.Get(CSpentIndexKey(txs[10].vin[0].prevout.hash, txs[10].vin[0].prevout.n + 1), value));
+
+    // Remove all but the last tx, the index then only knows about that one
+    for (size_t i = 0; i + 1 < txs.size(); i++) {
+        addressIndex.RemoveTx(txs[i].GetHash());
+        spentIndex.RemoveTx(txs[i]);
+    }
+    results.clear();
+    addressIndex.GetDeltas(hotAddress, 1, results);
+    BOOST_CHECK_EQUAL(results.size(), 1);
+    BOOST_CHECK(results[0].first.txhash == txs.back().GetHash() && results[0].second.amount == 1999);
+    results.clear();
+    addressIndex.GetDeltas(otherAddress, 2, results);
+    BOOST_CHECK(results.empty());
+    BOOST_CHECK(!spentIndex.Get(CSpentIndexKey(txs[10].vin[0].prevout.hash, txs[10].vin[0].prevout.n), value));
+    BOOST_CHECK(spentIndex.Get(CSpentIndexKey(txs.back().vin[0].prevout.hash, txs.back().vin[0].prevout.n), value));
+
+    addressIndex.RemoveTx(txs.back().GetHash());
+    spentIndex.RemoveTx(txs.back());
+    results.clear();
+    addressIndex.GetDeltas(hotAddress, 1, results);
+    BOOST_CHECK(results.empty());
+    BOOST_CHECK(!spentIndex.Get(CSpentIndexKey(txs.back().vin[0].prevout.hash, txs.back().vin[0].prevout.n), value));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
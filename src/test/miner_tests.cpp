@@ -21,7 +21,10 @@
 
 #include "test/test_genix.h"
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 #include <boost/test/unit_test.hpp>
 
@@ -196,6 +199,164 @@ void TestPackageSelection(const CChainParams& chainparams, CScript scriptPubKey,
     BOOST_CHECK(pblocktemplate->block.vtx[8]->GetHash() == hashLowFeeTx2);
 }
 
+// Test that templates built by updating a CBlockTemplateSelection contain the
+// same transactions as templates built from scratch.
+void TestIncrementalSelection(const CChainParams& chainparams, CScript scriptPubKey, std::vector<CTransactionRef>& txFirst)
+{
+    mempool.clear();
+    CBlockTemplateSelection selection(mempool);
+    TestMemPoolEntryHelper entry;
+
+    auto createAndCompare = [&]() {
+        std::unique_ptr<CBlockTemplate> pblocktemplate = AssemblerForTest(chainparams).CreateNewBlock(scriptPubKey, &selection);
+        std::unique_ptr<CBlockTemplate> pfreshtemplate = AssemblerForTest(chainparams).CreateNewBlock(scriptPubKey);
+        std::set<uint256> txs, freshTxs;
+        for (size_t i = 1; i < pblocktemplate->block.vtx.size(); ++i) {
+            txs.insert(pblocktemplate->block.vtx[i]->GetHash());
+        }
+        for (size_t i = 1; i < pfreshtemplate->block.vtx.size(); ++i) {
+            freshTxs.insert(pfreshtemplate->block.vtx[i]->GetHash());
+        }
+        BOOST_CHECK(txs == freshTxs);
+        BOOST_CHECK_EQUAL(pblocktemplate->vTxFees[0], pfreshtemplate->vTxFees[0]);
+        return pblocktemplate;
+    };
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vin[0].prevout.hash = txFirst[3]->GetHash();
+    tx.vin[0].prevout.n = 0;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 5000000000LL - 10000;
+    uint256 hashParentTx = tx.GetHash();
+    mempool.addUnchecked(hashParentTx, entry.Fee(10000).Time(GetTime()).SpendsCoinbase(true).FromTx(tx));
+
+    // The first template does a full selection
+    std::unique_ptr<CBlockTemplate> pblocktemplate = createAndCompare();
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 2);
+    BOOST_CHECK_EQUAL(selection.GetIncrementalUpdates(), 0);
+    BOOST_CHECK(selection.CanUpdate());
+
+    // A child of a selected tx is appended
+    tx.vin[0].prevout.hash = hashParentTx;
+    tx.vout[0].nValue -= 20000;
+    uint256 hashChildTx = tx.GetHash();
+    mempool.addUnchecked(hashChildTx, entry.Fee(20000).SpendsCoinbase(false).FromTx(tx));
+    BOOST_CHECK(selection.CanUpdate());
+    pblocktemplate = createAndCompare();
+    BOOST_CHECK_EQUAL(selection.GetIncrementalUpdates(), 1);
+    BOOST_CHECK(pblocktemplate->block.vtx[2]->GetHash() == hashChildTx);
+
+    // A free tx isn't selected on its own
+    tx.vin[0].prevout.hash = hashChildTx;
+    uint256 hashFreeTx = tx.GetHash();
+    mempool.addUnchecked(hashFreeTx, entry.Fee(0).FromTx(tx));
+    pblocktemplate = createAndCompare();
+    BOOST_CHECK_EQUAL(selection.GetIncrementalUpdates(), 2);
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 3);
+
+    // But a child paying for it needs a full selection
+    tx.vin[0].prevout.hash = hashFreeTx;
+    tx.vout[0].nValue -= 50000;
+    uint256 hashHighFeeTx = tx.GetHash();
+    mempool.addUnchecked(hashHighFeeTx, entry.Fee(50000).FromTx(tx));
+    BOOST_CHECK(!selection.CanUpdate());
+    pblocktemplate = createAndCompare();
+    BOOST_CHECK_EQUAL(selection.GetIncrementalUpdates(), 2);
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 5);
+
+    // Prioritising and removing txs also needs a full selection
+    mempool.PrioritiseTransaction(hashHighFeeTx, -50000);
+    pblocktemplate = createAndCompare();
+    BOOST_CHECK_EQUAL(selection.GetIncrementalUpdates(), 2);
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 3);
+
+    mempool.removeRecursive(*pblocktemplate->block.vtx[2]);
+    pblocktemplate = createAndCompare();
+    BOOST_CHECK_EQUAL(selection.GetIncrementalUpdates(), 2);
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 2);
+
+    // clear() doesn't notify about the removed txs
+    mempool.clear();
+    pblocktemplate = createAndCompare();
+    BOOST_CHECK_EQUAL(selection.GetIncrementalUpdates(), 2);
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 1);
+}
+
+struct BlockTemplateListener : public CValidationInterface
+{
+    std::mutex cs;
+    std::condition_variable cond;
+    std::shared_ptr<const CBlockTemplate> pblocktemplate;
+    std::thread::id threadId;
+
+    void NewBlockTemplate(const std::shared_ptr<const CBlockTemplate>& pblocktemplateIn) override
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        pblocktemplate = pblocktemplateIn;
+        threadId = std::this_thread::get_id();
+        cond.notify_all();
+    }
+};
+
+void TestBlockTemplateNotifier(std::vector<CTransactionRef>& txFirst)
+{
+    mempool.clear();
+    CBlockTemplateNotifier notifier(mempool);
+    TestMemPoolEntryHelper entry;
+    const CBlockIndex* pindexPrev;
+    unsigned int nTransactionsUpdated;
+
+    // The template is shared until the tip or the mempool changes
+    std::shared_ptr<const CBlockTemplate> pblocktemplate = notifier.GetBlockTemplate(pindexPrev, nTransactionsUpdated);
+    BOOST_CHECK(pblocktemplate);
+    BOOST_CHECK(pindexPrev == chainActive.Tip());
+    BOOST_CHECK_EQUAL(nTransactionsUpdated, mempool.GetTransactionsUpdated());
+    BOOST_CHECK(notifier.GetBlockTemplate(pindexPrev, nTransactionsUpdated) == pblocktemplate);
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vin[0].prevout.hash = txFirst[3]->GetHash();
+    tx.vin[0].prevout.n = 0;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 5000000000LL - 10000;
+    mempool.addUnchecked(tx.GetHash(), entry.Fee(10000).Time(GetTime()).SpendsCoinbase(true).FromTx(tx));
+
+    // The previous selection can be updated, so there's no need to wait 5 seconds for a new template
+    std::shared_ptr<const CBlockTemplate> pnewtemplate = notifier.GetBlockTemplate(pindexPrev, nTransactionsUpdated);
+    BOOST_CHECK(pnewtemplate && pnewtemplate != pblocktemplate);
+    BOOST_CHECK_EQUAL(pnewtemplate->block.vtx.size(), 2);
+    BOOST_CHECK_EQUAL(nTransactionsUpdated, mempool.GetTransactionsUpdated());
+    BOOST_CHECK(notifier.GetBlockTemplate(pindexPrev, nTransactionsUpdated) == pnewtemplate);
+
+    // New templates are published on the notifier's own thread instead of the caller's, which holds cs_main
+    {
+        BlockTemplateListener listener;
+        RegisterValidationInterface(&listener);
+        CBlockTemplateNotifier publisher(mempool);
+        publisher.Start(true);
+        std::shared_ptr<const CBlockTemplate> ppublished = publisher.GetBlockTemplate(pindexPrev, nTransactionsUpdated);
+        BOOST_CHECK(ppublished);
+        {
+            std::unique_lock<std::mutex> lock(listener.cs);
+            BOOST_CHECK(listener.cond.wait_for(lock, std::chrono::seconds(10), [&]{ return listener.pblocktemplate != nullptr; }));
+            BOOST_CHECK(listener.pblocktemplate == ppublished);
+            BOOST_CHECK(listener.threadId != std::this_thread::get_id());
+        }
+        publisher.Stop();
+        UnregisterValidationInterface(&listener);
+    }
+
+    // Waiting for a template on top of another tip returns right away, and so does waiting after an interrupt
+    BOOST_CHECK(notifier.WaitForNewTemplate(uint256(), nTransactionsUpdated));
+    notifier.Interrupt();
+    BOOST_CHECK(!notifier.WaitForNewTemplate(chainActive.Tip()->GetBlockHash(), nTransactionsUpdated));
+
+    mempool.clear();
+}
+
 // NOTE: These tests rely on CreateNewBlock doing its own self-validation!
 BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
 {
@@ -527,6 +688,8 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     mempool.clear();
 
     TestPackageSelection(chainparams, scriptPubKey, txFirst);
+    TestIncrementalSelection(chainparams, scriptPubKey, txFirst);
+    TestBlockTemplateNotifier(txFirst);
 
     fCheckpointsEnabled = true;
 }
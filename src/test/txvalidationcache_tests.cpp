@@ -296,4 +296,57 @@ BOOST_FIXTURE_TEST_CASE(checkinputs_test, TestChain100Setup)
     // TODO: add tests for remaining script flags
 }
 
+BOOST_FIXTURE_TEST_CASE(tx_prevalidation, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    auto sign = [&](CMutableTransaction& tx) {
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        tx.vin[0].scriptSig = CScript() << vchSig;
+    };
+
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout.hash = coinbaseTxns[0].GetHash();
+    spend.vin[0].prevout.n = 0;
+    spend.vout.resize(1);
+    spend.vout[0].nValue = 11*CENT;
+    spend.vout[0].scriptPubKey = scriptPubKey;
+    sign(spend);
+
+    // The signature doesn't commit to a different output value
+    CMutableTransaction badSpend = spend;
+    badSpend.vout[0].nValue = 12*CENT;
+    BOOST_CHECK(!PreValidateTransaction(mempool, badSpend));
+    BOOST_CHECK(PreValidateTransaction(mempool, spend));
+
+    // Nonstandard transactions are rejected although their signatures are valid
+    CMutableTransaction nonStandardSpend = spend;
+    nonStandardSpend.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    sign(nonStandardSpend);
+    BOOST_CHECK(!PreValidateTransaction(mempool, nonStandardSpend));
+
+    CMutableTransaction child;
+    child.nVersion = 1;
+    child.vin.resize(1);
+    child.vin[0].prevout.hash = spend.GetHash();
+    child.vin[0].prevout.n = 0;
+    child.vout.resize(1);
+    child.vout[0].nValue = 10*CENT;
+    child.vout[0].scriptPubKey = scriptPubKey;
+    sign(child);
+
+    // Inputs from the mempool are found as well
+    BOOST_CHECK(!PreValidateTransaction(mempool, child));
+    BOOST_CHECK(ToMemPool(spend));
+    BOOST_CHECK(PreValidateTransaction(mempool, child));
+    BOOST_CHECK(ToMemPool(child));
+    BOOST_CHECK_EQUAL(mempool.size(), 2);
+    mempool.clear();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
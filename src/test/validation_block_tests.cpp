@@ -0,0 +1,157 @@
+// Copyright (c) 2018-2019 The Genix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "arith_uint256.h"
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "pow.h"
+#include "random.h"
+#include "streams.h"
+#include "utiltime.h"
+#include "validation.h"
+#include "versionbits.h"
+#include "test/test_genix.h"
+
+#include <boost/test/unit_test.hpp>
+
+struct RegtestingSetup : public TestingSetup {
+    RegtestingSetup() : TestingSetup(CBaseChainParams::REGTEST) {}
+};
+
+BOOST_FIXTURE_TEST_SUITE(validation_block_tests, RegtestingSetup)
+
+/**
+ * Mine a chain of headers on top of the tip. They are spaced more than 2 hours apart, so
+ * regtest allows the minimum difficulty for all of them.
+ */
+static std::vector<CBlockHeader> MineHeaders(size_t nCount)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    std::vector<CBlockHeader> vHeaders(nCount);
+    uint256 hashPrev;
+    int64_t nTime;
+    {
+        LOCK(cs_main);
+        hashPrev = chainActive.Tip()->GetBlockHash();
+        nTime = chainActive.Tip()->GetBlockTime();
+    }
+    for (CBlockHeader& header : vHeaders) {
+        header.nVersion = VERSIONBITS_TOP_BITS;
+        header.hashPrevBlock = hashPrev;
+        header.hashMerkleRoot = InsecureRand256();
+        nTime += 2 * 60 * 60 + 1;
+        header.nTime = nTime;
+        header.nBits = UintToArith256(params.powLimit).GetCompact();
+        while (!CheckProofOfWork(header.GetHash(), header.nBits, params)) {
+            header.nNonce++;
+        }
+        hashPrev = header.GetHash();
+    }
+    SetMockTime(nTime);
+    return vHeaders;
+}
+
+/** Round trip through serialization, like headers received from a peer, so that no hashes are cached */
+static std::vector<CBlockHeader> Received(const std::vector<CBlockHeader>& vHeaders)
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << vHeaders;
+    std::vector<CBlockHeader> vReceived;
+    stream >> vReceived;
+    return vReceived;
+}
+
+static bool HaveHeader(const CBlockHeader& header)
+{
+    LOCK(cs_main);
+    return mapBlockIndex.count(header.GetHash()) != 0;
+}
+
+// more headers than fit into one slice of the parallel PoW checks
+static const size_t HEADERS_COUNT = 200;
+
+BOOST_AUTO_TEST_CASE(processnewblockheaders_valid)
+{
+    std::vector<CBlockHeader> vHeaders = Received(MineHeaders(HEADERS_COUNT));
+
+    CValidationState state;
+    const CBlockIndex* pindexLast = nullptr;
+    CBlockHeader firstInvalid;
+    BOOST_CHECK(ProcessNewBlockHeaders(vHeaders, state, Params(), &pindexLast, &firstInvalid));
+    BOOST_CHECK(state.IsValid());
+    BOOST_CHECK(firstInvalid.IsNull());
+    BOOST_REQUIRE(pindexLast != nullptr);
+    BOOST_CHECK(pindexLast->GetBlockHash() == vHeaders.back().GetHash());
+    BOOST_CHECK_EQUAL(pindexLast->nHeight, (int)HEADERS_COUNT);
+    for (const CBlockHeader& header : vHeaders) {
+        BOOST_CHECK(HaveHeader(header));
+    }
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_CASE(processnewblockheaders_invalid_pow)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    std::vector<CBlockHeader> vHeaders = MineHeaders(HEADERS_COUNT);
+    // break the PoW of a header in the middle of the second slice
+    const size_t nInvalid = 100;
+    do {
+        vHeaders[nInvalid].nNonce++;
+    } while (CheckProofOfWork(vHeaders[nInvalid].GetHash(), vHeaders[nInvalid].nBits, params));
+    vHeaders = Received(vHeaders);
+
+    CValidationState state;
+    const CBlockIndex* pindexLast = nullptr;
+    CBlockHeader firstInvalid;
+    BOOST_CHECK(!ProcessNewBlockHeaders(vHeaders, state, Params(), &pindexLast, &firstInvalid));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "high-hash");
+    BOOST_CHECK(firstInvalid.GetHash() == vHeaders[nInvalid].GetHash());
+
+    // the headers before the invalid one are accepted, none after it
+    BOOST_REQUIRE(pindexLast != nullptr);
+    BOOST_CHECK(pindexLast->GetBlockHash() == vHeaders[nInvalid - 1].GetHash());
+    BOOST_CHECK(HaveHeader(vHeaders[nInvalid - 1]));
+    BOOST_CHECK(!HaveHeader(vHeaders[nInvalid]));
+
+    // the PoW checks stopped at the invalid header, its successors in the slice were not hashed
+    for (size_t i = nInvalid + 1; i < 128; i++) {
+        BOOST_CHECK(!vHeaders[i].HasCachedHash());
+    }
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_CASE(processnewblockheaders_noncontiguous)
+{
+    std::vector<CBlockHeader> vHeaders = MineHeaders(HEADERS_COUNT);
+    // drop a header in the middle, its successor doesn't connect anymore
+    const size_t nGap = 150;
+    const CBlockHeader missing = vHeaders[nGap];
+    vHeaders.erase(vHeaders.begin() + nGap);
+    vHeaders = Received(vHeaders);
+
+    CValidationState state;
+    const CBlockIndex* pindexLast = nullptr;
+    CBlockHeader firstInvalid;
+    BOOST_CHECK(!ProcessNewBlockHeaders(vHeaders, state, Params(), &pindexLast, &firstInvalid));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "prev-blk-not-found");
+    BOOST_CHECK(firstInvalid.GetHash() == vHeaders[nGap].GetHash());
+
+    BOOST_REQUIRE(pindexLast != nullptr);
+    BOOST_CHECK(pindexLast->GetBlockHash() == vHeaders[nGap - 1].GetHash());
+    BOOST_CHECK(!HaveHeader(missing));
+    BOOST_CHECK(!HaveHeader(vHeaders[nGap]));
+
+    // once the missing header is known, the rest of the batch connects
+    state = CValidationState();
+    BOOST_CHECK(ProcessNewBlockHeaders({missing}, state, Params(), &pindexLast, &firstInvalid));
+    BOOST_CHECK(ProcessNewBlockHeaders(std::vector<CBlockHeader>(vHeaders.begin() + nGap, vHeaders.end()), state, Params(), &pindexLast, &firstInvalid));
+    BOOST_CHECK(pindexLast->GetBlockHash() == vHeaders.back().GetHash());
+    BOOST_CHECK_EQUAL(pindexLast->nHeight, (int)HEADERS_COUNT);
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
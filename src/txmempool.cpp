@@ -470,11 +470,276 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     return true;
 }
 
+CMempoolAddressIndex::CMempoolAddressIndex() :
+    k0(GetRand(std::numeric_limits<uint64_t>::max())),
+    k1(GetRand(std::numeric_limits<uint64_t>::max()))
+{
+    std::fill(std::begin(freeLists), std::end(freeLists), nullptr);
+}
+
+CMempoolAddressIndex::~CMempoolAddressIndex()
+{
+    Clear();
+}
+
+uint32_t CMempoolAddressIndex::Hash(const uint160& hash, uint8_t type) const
+{
+    return (uint32_t)CSipHasher(k0, k1).Write(type).Write(hash.begin(), hash.size()).Finalize();
+}
+
+size_t CMempoolAddressIndex::FindSlot(const uint160& hash, uint8_t type, uint32_t nHash) const
+{
+    return table.Find(nHash, [&](uint32_t i) {
+        const Address& address = addresses[i];
+        return address.nHash == nHash && address.type == type && address.hash == hash;
+    });
+}
+
+CMempoolAddressIndex::Delta* CMempoolAddressIndex::AllocateDeltas(uint8_t sizeClass)
+{
+    size_t nBytes = sizeof(Delta) << sizeClass;
+    if (sizeClass > MAX_POOLED_CLASS) {
+        nLargeUsage += memusage::MallocUsage(nBytes);
+        return static_cast<Delta*>(::operator new(nBytes));
+    }
+    void* p = freeLists[sizeClass];
+    if (p) {
+        // freed arrays keep the next pointer of their free list in their first bytes
+        memcpy(&freeLists[sizeClass], p, sizeof(void*));
+        return static_cast<Delta*>(p);
+    }
+    if (chunkUsed + nBytes > CHUNK_SIZE) {
+        chunks.emplace_back(new char[CHUNK_SIZE]);
+        chunkUsed = 0;
+    }
+    p = chunks.back().get() + chunkUsed;
+    chunkUsed += nBytes;
+    return static_cast<Delta*>(p);
+}
+
+void CMempoolAddressIndex::FreeDeltas(Delta* deltas, uint8_t sizeClass)
+{
+    if (sizeClass > MAX_POOLED_CLASS) {
+        nLargeUsage -= memusage::MallocUsage(sizeof(Delta) << sizeClass);
+        ::operator delete(deltas);
+        return;
+    }
+    memcpy(static_cast<void*>(deltas), &freeLists[sizeClass], sizeof(void*));
+    freeLists[sizeClass] = deltas;
+}
+
+void CMempoolAddressIndex::ResizeDeltas(Address& address, uint8_t sizeClass)
+{
+    Delta* deltas = AllocateDeltas(sizeClass);
+    std::uninitialized_copy(address.deltas, address.deltas + address.count, deltas);
+    FreeDeltas(address.deltas, address.sizeClass);
+    address.deltas = deltas;
+    address.sizeClass = sizeClass;
+}
+
+void CMempoolAddressIndex::EraseAddress(size_t slot)
+{
+    uint32_t i = table.Get(slot);
+    FreeDeltas(addresses[i].deltas, addresses[i].sizeClass);
+    table.Erase(slot, [&](uint32_t j) { return addresses[j].nHash; });
+
+    // move the last address into the gap
+    uint32_t last = addresses.size() - 1;
+    if (i != last) {
+        table.Set(table.Find(addresses[last].nHash, [&](uint32_t j) { return j == last; }), i);
+        addresses[i] = addresses[last];
+    }
+    addresses.pop_back();
+}
+
+void CMempoolAddressIndex::AddTx(const uint256& txhash, const std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>>& vDeltas)
+{
+    if (vDeltas.empty() || mapTxAddresses.count(txhash)) {
+        return;
+    }
+
+    TxAddresses txAddresses;
+    txAddresses.reserve(vDeltas.size());
+    for (const auto& p : vDeltas) {
+        const CMempoolAddressDeltaKey& key = p.first;
+        const CMempoolAddressDelta& delta = p.second;
+        uint8_t type = (uint8_t)key.type;
+        uint32_t nHash = Hash(key.addressBytes, type);
+
+        size_t slot = FindSlot(key.addressBytes, type, nHash);
+        if (table.IsEmpty(slot)) {
+            table.Grow(addresses.size(), [&](uint32_t i) { return addresses[i].nHash; });
+            slot = FindSlot(key.addressBytes, type, nHash);
+            table.Set(slot, addresses.size());
+            addresses.push_back(Address{key.addressBytes, type, 0, nHash, 0, AllocateDeltas(0)});
+        }
+
+        Address& address = addresses[table.Get(slot)];
+        if (address.count == (uint32_t{1} << address.sizeClass)) {
+            ResizeDeltas(address, address.sizeClass + 1);
+        }
+        new (&address.deltas[address.count++]) Delta{key.txhash, delta.prevhash, delta.time, delta.amount, key.index, delta.prevout, key.spending != 0};
+        txAddresses.emplace_back(key.addressBytes, type);
+    }
+
+    std::sort(txAddresses.begin(), txAddresses.end());
+    txAddresses.erase(std::unique(txAddresses.begin(), txAddresses.end()), txAddresses.end());
+    txAddresses.shrink_to_fit();
+    nTxAddressesUsage += memusage::DynamicUsage(txAddresses);
+    mapTxAddresses.emplace(txhash, std::move(txAddresses));
+}
+
+void CMempoolAddressIndex::RemoveTx(const uint256& txhash)
+{
+    auto it = mapTxAddresses.find(txhash);
+    if (it == mapTxAddresses.end()) {
+        return;
+    }
+
+    for (const auto& p : it->second) {
+        size_t slot = FindSlot(p.first, p.second, Hash(p.first, p.second));
+        if (table.IsEmpty(slot)) {
+            continue;
+        }
+        Address& address = addresses[table.Get(slot)];
+        Delta* end = std::remove_if(address.deltas, address.deltas + address.count, [&](const Delta& delta) { return delta.txhash == txhash; });
+        address.count = end - address.deltas;
+        if (address.count == 0) {
+            EraseAddress(slot);
+        } else if (address.sizeClass > 0 && address.count <= (uint32_t{1} << address.sizeClass) / 4) {
+            ResizeDeltas(address, address.sizeClass - 1);
+        }
+    }
+
+    nTxAddressesUsage -= memusage::DynamicUsage(it->second);
+    mapTxAddresses.erase(it);
+    if (mapTxAddresses.empty()) {
+        // give back the memory of the pool and the table
+        Clear();
+    }
+}
+
+void CMempoolAddressIndex::GetDeltas(const uint160& hash, int type, std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>>& results) const
+{
+    size_t slot = FindSlot(hash, (uint8_t)type, Hash(hash, (uint8_t)type));
+    if (table.IsEmpty(slot)) {
+        return;
+    }
+
+    const Address& address = addresses[table.Get(slot)];
+    size_t nStart = results.size();
+    for (const Delta* delta = address.deltas; delta != address.deltas + address.count; ++delta) {
+        results.emplace_back(CMempoolAddressDeltaKey(type, hash, delta->txhash, delta->index, delta->spending),
+                             CMempoolAddressDelta(delta->time, delta->amount, delta->prevhash, delta->prevout));
+    }
+    std::sort(results.begin() + nStart, results.end(), [](const std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>& a, const std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>& b) {
+        return CMempoolAddressDeltaKeyCompare()(a.first, b.first);
+    });
+}
+
+void CMempoolAddressIndex::Clear()
+{
+    for (const Address& address : addresses) {
+        if (address.sizeClass > MAX_POOLED_CLASS) {
+            ::operator delete(address.deltas);
+        }
+    }
+    std::vector<Address>().swap(addresses);
+    table.Clear();
+    std::vector<std::unique_ptr<char[]>>().swap(chunks);
+    chunkUsed = CHUNK_SIZE;
+    std::fill(std::begin(freeLists), std::end(freeLists), nullptr);
+    nLargeUsage = 0;
+    mapTxAddresses.clear();
+    mapTxAddresses.rehash(0);
+    nTxAddressesUsage = 0;
+}
+
+size_t CMempoolAddressIndex::DynamicMemoryUsage() const
+{
+    return memusage::DynamicUsage(addresses) + table.DynamicMemoryUsage() +
+           memusage::DynamicUsage(chunks) + chunks.size() * memusage::MallocUsage(CHUNK_SIZE) + nLargeUsage +
+           memusage::DynamicUsage(mapTxAddresses) + nTxAddressesUsage;
+}
+
+size_t CMempoolSpentIndex::FindSlot(const CSpentIndexKey& key, uint32_t nHash) const
+{
+    return table.Find(nHash, [&](uint32_t i) {
+        const Entry& entry = entries[i];
+        return entry.nHash == nHash && entry.key.outputIndex == key.outputIndex && entry.key.txid == key.txid;
+    });
+}
+
+void CMempoolSpentIndex::AddTx(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue>>& vSpent)
+{
+    for (const auto& p : vSpent) {
+        uint32_t nHash = Hash(p.first);
+        table.Grow(entries.size(), [&](uint32_t i) { return entries[i].nHash; });
+        size_t slot = FindSlot(p.first, nHash);
+        if (!table.IsEmpty(slot)) {
+            continue;
+        }
+        table.Set(slot, entries.size());
+        entries.push_back(Entry{p.first, p.second, nHash});
+    }
+}
+
+void CMempoolSpentIndex::RemoveTx(const CTransaction& tx)
+{
+    if (entries.empty()) {
+        return;
+    }
+
+    const uint256& txhash = tx.GetHash();
+    for (const CTxIn& txin : tx.vin) {
+        CSpentIndexKey key(txin.prevout.hash, txin.prevout.n);
+        size_t slot = FindSlot(key, Hash(key));
+        if (table.IsEmpty(slot) || entries[table.Get(slot)].value.txid != txhash) {
+            continue;
+        }
+
+        uint32_t i = table.Get(slot);
+        table.Erase(slot, [&](uint32_t j) { return entries[j].nHash; });
+
+        // move the last entry into the gap
+        uint32_t last = entries.size() - 1;
+        if (i != last) {
+            table.Set(table.Find(entries[last].nHash, [&](uint32_t j) { return j == last; }), i);
+            entries[i] = entries[last];
+        }
+        entries.pop_back();
+    }
+    if (entries.empty()) {
+        Clear();
+    }
+}
+
+bool CMempoolSpentIndex::Get(const CSpentIndexKey& key, CSpentIndexValue& value) const
+{
+    size_t slot = FindSlot(key, Hash(key));
+    if (table.IsEmpty(slot)) {
+        return false;
+    }
+    value = entries[table.Get(slot)].value;
+    return true;
+}
+
+void CMempoolSpentIndex::Clear()
+{
+    std::vector<Entry>().swap(entries);
+    table.Clear();
+}
+
+size_t CMempoolSpentIndex::DynamicMemoryUsage() const
+{
+    return memusage::DynamicUsage(entries) + table.DynamicMemoryUsage();
+}
+
 void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view)
 {
     LOCK(cs);
     const CTransaction& tx = entry.GetTx();
-    std::vector<CMempoolAddressDeltaKey> inserted;
+    std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>> deltas;
 
     uint256 txhash = tx.GetHash();
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
@@ -485,20 +750,17 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
             std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22);
             CMempoolAddressDeltaKey key(2, uint160(hashBytes), txhash, j, 1);
             CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            deltas.emplace_back(key, delta);
         } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
             std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23);
             CMempoolAddressDeltaKey key(1, uint160(hashBytes), txhash, j, 1);
             CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            deltas.emplace_back(key, delta);
         } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
             uint160 hashBytes(Hash160(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.end()-1));
             CMempoolAddressDeltaKey key(1, hashBytes, txhash, j, 1);
             CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            deltas.emplace_back(key, delta);
         }
     }
 
@@ -507,24 +769,19 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
         if (out.scriptPubKey.IsPayToScriptHash()) {
             std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
             CMempoolAddressDeltaKey key(2, uint160(hashBytes), txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            deltas.emplace_back(key, CMempoolAddressDelta(entry.GetTime(), out.nValue));
         } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
             std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
-            std::pair<addressDeltaMap::iterator,bool> ret;
             CMempoolAddressDeltaKey key(1, uint160(hashBytes), txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            deltas.emplace_back(key, CMempoolAddressDelta(entry.GetTime(), out.nValue));
         } else if (out.scriptPubKey.IsPayToPublicKey()) {
             uint160 hashBytes(Hash160(out.scriptPubKey.begin()+1, out.scriptPubKey.end()-1));
-            std::pair<addressDeltaMap::iterator,bool> ret;
             CMempoolAddressDeltaKey key(1, hashBytes, txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            deltas.emplace_back(key, CMempoolAddressDelta(entry.GetTime(), out.nValue));
         }
     }
 
-    mapAddressInserted.insert(std::make_pair(txhash, inserted));
+    addressIndex.AddTx(txhash, deltas);
 }
 
 bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresses,
@@ -532,11 +789,7 @@ bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresse
 {
     LOCK(cs);
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        addressDeltaMap::iterator ait = mapAddress.lower_bound(CMempoolAddressDeltaKey((*it).second, (*it).first));
-        while (ait != mapAddress.end() && (*ait).first.addressBytes == (*it).first && (*ait).first.type == (*it).second) {
-            results.push_back(*ait);
-            ait++;
-        }
+        addressIndex.GetDeltas((*it).first, (*it).second, results);
     }
     return true;
 }
@@ -544,16 +797,7 @@ bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresse
 bool CTxMemPool::removeAddressIndex(const uint256 txhash)
 {
     LOCK(cs);
-    addressDeltaMapInserted::iterator it = mapAddressInserted.find(txhash);
-
-    if (it != mapAddressInserted.end()) {
-        std::vector<CMempoolAddressDeltaKey> keys = (*it).second;
-        for (std::vector<CMempoolAddressDeltaKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapAddress.erase(*mit);
-        }
-        mapAddressInserted.erase(it);
-    }
-
+    addressIndex.RemoveTx(txhash);
     return true;
 }
 
@@ -562,7 +806,7 @@ void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCac
     LOCK(cs);
 
     const CTransaction& tx = entry.GetTx();
-    std::vector<CSpentIndexKey> inserted;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue>> spent;
 
     uint256 txhash = tx.GetHash();
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
@@ -589,49 +833,39 @@ void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCac
         CSpentIndexKey key = CSpentIndexKey(input.prevout.hash, input.prevout.n);
         CSpentIndexValue value = CSpentIndexValue(txhash, j, -1, prevout.nValue, addressType, addressHash);
 
-        mapSpent.insert(std::make_pair(key, value));
-        inserted.push_back(key);
-
+        spent.emplace_back(key, value);
     }
 
-    mapSpentInserted.insert(make_pair(txhash, inserted));
+    spentIndex.AddTx(spent);
 }
 
 bool CTxMemPool::getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 {
     LOCK(cs);
-    mapSpentIndex::iterator it;
-
-    it = mapSpent.find(key);
-    if (it != mapSpent.end()) {
-        value = it->second;
-        return true;
-    }
-    return false;
+    return spentIndex.Get(key, value);
 }
 
-bool CTxMemPool::removeSpentIndex(const uint256 txhash)
+bool CTxMemPool::removeSpentIndex(const CTransaction &tx)
 {
     LOCK(cs);
-    mapSpentIndexInserted::iterator it = mapSpentInserted.find(txhash);
-
-    if (it != mapSpentInserted.end()) {
-        std::vector<CSpentIndexKey> keys = (*it).second;
-        for (std::vector<CSpentIndexKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapSpent.erase(*mit);
-        }
-        mapSpentInserted.erase(it);
-    }
-
+    spentIndex.RemoveTx(tx);
     return true;
 }
 
+size_t CTxMemPool::IndexesDynamicMemoryUsage() const
+{
+    LOCK(cs);
+    return addressIndex.DynamicMemoryUsage() + spentIndex.DynamicMemoryUsage();
+}
+
 void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 {
     NotifyEntryRemoved(it->GetSharedTx(), reason);
     const uint256 hash = it->GetTx().GetHash();
     for (const CTxIn& txin : it->GetTx().vin)
         mapNextTx.erase(txin.prevout);
+    removeAddressIndex(hash);
+    removeSpentIndex(it->GetTx());
 
     if (vTxHashes.size() > 1) {
         vTxHashes[it->vTxHashesIdx] = std::move(vTxHashes.back());
@@ -694,8 +928,6 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
     mapTx.erase(it);
     nTransactionsUpdated++;
     if (minerPolicyEstimator) {minerPolicyEstimator->removeTx(hash, false);}
-    removeAddressIndex(hash);
-    removeSpentIndex(hash);
 }
 
 // Calculates descendants of entry that are not already in setDescendants, and adds to
@@ -992,6 +1224,8 @@ void CTxMemPool::_clear()
     mapNextTx.clear();
     mapProTxAddresses.clear();
     mapProTxPubKeyIDs.clear();
+    addressIndex.Clear();
+    spentIndex.Clear();
     totalTxSize = 0;
     cachedInnerUsage = 0;
     lastRollingFeeUpdate = GetTime();
@@ -1196,7 +1430,8 @@ void CTxMemPool::queryHashes(std::vector<uint256>& vtxid)
 }
 
 static TxMempoolInfo GetInfo(CTxMemPool::indexed_transaction_set::const_iterator it) {
-    return TxMempoolInfo{it->GetSharedTx(), it->GetTime(), CFeeRate(it->GetFee(), it->GetTxSize()), it->GetModifiedFee() - it->GetFee()};
+    return TxMempoolInfo{it->GetSharedTx(), it->GetTime(), CFeeRate(it->GetFee(), it->GetTxSize()), it->GetModifiedFee() - it->GetFee(),
+                         it->GetFee(), it->GetTxSize(), it->GetSigOpCount()};
 }
 
 std::vector<TxMempoolInfo> CTxMemPool::infoAll() const
@@ -1344,6 +1579,7 @@ void CTxMemPool::PrioritiseTransaction(const uint256& hash, const CAmount& nFeeD
                 mapTx.modify(descendantIt, update_ancestor_state(0, nFeeDelta, 0, 0));
             }
             ++nTransactionsUpdated;
+            NotifyEntryPrioritised(it->GetSharedTx());
         }
     }
     LogPrintf("PrioritiseTransaction: %s feerate += %s\n", hash.ToString(), FormatMoney(nFeeDelta));
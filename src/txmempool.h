@@ -6,9 +6,11 @@
 #ifndef BITCOIN_TXMEMPOOL_H
 #define BITCOIN_TXMEMPOOL_H
 
+#include <limits>
 #include <memory>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 #include <string>
@@ -18,6 +20,7 @@
 #include "amount.h"
 #include "coins.h"
 #include "indirectmap.h"
+#include "memusage.h"
 #include "policy/feerate.h"
 #include "primitives/transaction.h"
 #include "sync.h"
@@ -319,6 +322,11 @@ struct TxMempoolInfo
 
     /** The fee delta. */
     int64_t nFeeDelta;
+
+    /** Fee, size and sigop count the transaction was accepted with. */
+    CAmount nFee;
+    size_t nTxSize;
+    unsigned int nSigOps;
 };
 
 /** Reason why a transaction was removed from the mempool,
@@ -347,6 +355,172 @@ public:
     }
 };
 
+/**
+ * Open addressing hash table of indexes into a vector of entries, which is what the mempool indexes below are made
+ * of. The entries store their own hash, the table only holds indexes. Erased slots are filled again by moving the
+ * following entries of the same cluster back, so there are no tombstones.
+ */
+class CMempoolIndexTable
+{
+private:
+    static const uint32_t EMPTY = std::numeric_limits<uint32_t>::max();
+
+    static const size_t MIN_SIZE = 16;
+
+    std::vector<uint32_t> table;
+    size_t mask;
+
+public:
+    CMempoolIndexTable() { Clear(); }
+
+    /** Returns the slot holding the index of the entry matching fnMatch, or the empty slot where it would go */
+    template<typename Match>
+    size_t Find(uint32_t nHash, Match fnMatch) const
+    {
+        size_t slot = nHash & mask;
+        while (table[slot] != EMPTY && !fnMatch(table[slot])) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    bool IsEmpty(size_t slot) const { return table[slot] == EMPTY; }
+    uint32_t Get(size_t slot) const { return table[slot]; }
+    void Set(size_t slot, uint32_t index) { table[slot] = index; }
+
+    /** Makes room for one more entry, keeping the load factor at most 1/2. The nEntries existing ones are rehashed if needed */
+    template<typename GetHash>
+    void Grow(size_t nEntries, GetHash fnGetHash)
+    {
+        if ((nEntries + 1) * 2 <= table.size()) {
+            return;
+        }
+        table.assign(table.size() * 2, uint32_t{EMPTY});
+        mask = table.size() - 1;
+        for (uint32_t i = 0; i < nEntries; i++) {
+            Set(Find(fnGetHash(i), [](uint32_t) { return false; }), i);
+        }
+    }
+
+    /** Empties slot and moves back entries which would otherwise not be found anymore */
+    template<typename GetHash>
+    void Erase(size_t slot, GetHash fnGetHash)
+    {
+        for (size_t next = (slot + 1) & mask; table[next] != EMPTY; next = (next + 1) & mask) {
+            // an entry can be moved back to slot unless its home slot lies cyclically in (slot, next]
+            size_t home = fnGetHash(table[next]) & mask;
+            if (slot <= next ? (home <= slot || home > next) : (home <= slot && home > next)) {
+                table[slot] = table[next];
+                slot = next;
+            }
+        }
+        table[slot] = EMPTY;
+    }
+
+    void Clear()
+    {
+        std::vector<uint32_t>(size_t{MIN_SIZE}, uint32_t{EMPTY}).swap(table);
+        mask = MIN_SIZE - 1;
+    }
+
+    size_t DynamicMemoryUsage() const { return memusage::DynamicUsage(table); }
+};
+
+/**
+ * The mempool part of the address index (-addressindex): the deltas of all mempool txs, by address.
+ *
+ * The deltas of each address are kept in one array, allocated from a pool with a free list per power of 2 size, so
+ * that adding and removing txs mostly doesn't allocate.
+ */
+class CMempoolAddressIndex
+{
+private:
+    // Arrays of up to 2^MAX_POOLED_CLASS deltas come from the pool, larger ones are allocated on their own
+    static const uint8_t MAX_POOLED_CLASS = 9;
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    struct Delta {
+        uint256 txhash;
+        uint256 prevhash;
+        int64_t time;
+        CAmount amount;
+        uint32_t index;
+        uint32_t prevout;
+        bool spending;
+    };
+
+    struct Address {
+        uint160 hash;
+        uint8_t type;
+        uint8_t sizeClass;
+        uint32_t nHash;
+        uint32_t count;
+        Delta* deltas;
+    };
+
+    const uint64_t k0, k1;
+    std::vector<Address> addresses;
+    CMempoolIndexTable table;
+
+    std::vector<std::unique_ptr<char[]>> chunks;
+    size_t chunkUsed{CHUNK_SIZE};
+    void* freeLists[MAX_POOLED_CLASS + 1];
+    size_t nLargeUsage{0};
+
+    // The addresses each tx has deltas for, to find them again when the tx is removed
+    typedef std::vector<std::pair<uint160, uint8_t>> TxAddresses;
+    std::unordered_map<uint256, TxAddresses, SaltedTxidHasher> mapTxAddresses;
+    size_t nTxAddressesUsage{0};
+
+    uint32_t Hash(const uint160& hash, uint8_t type) const;
+    size_t FindSlot(const uint160& hash, uint8_t type, uint32_t nHash) const;
+    Delta* AllocateDeltas(uint8_t sizeClass);
+    void FreeDeltas(Delta* deltas, uint8_t sizeClass);
+    void ResizeDeltas(Address& address, uint8_t sizeClass);
+    void EraseAddress(size_t slot);
+
+public:
+    CMempoolAddressIndex();
+    ~CMempoolAddressIndex();
+    CMempoolAddressIndex(const CMempoolAddressIndex&) = delete;
+    CMempoolAddressIndex& operator=(const CMempoolAddressIndex&) = delete;
+
+    /** Adds the deltas of a tx, which must all have been built for the same tx */
+    void AddTx(const uint256& txhash, const std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>>& vDeltas);
+    void RemoveTx(const uint256& txhash);
+    /** Appends the deltas of an address to results, ordered like CMempoolAddressDeltaKeyCompare */
+    void GetDeltas(const uint160& hash, int type, std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>>& results) const;
+    void Clear();
+
+    size_t DynamicMemoryUsage() const;
+};
+
+/** The mempool part of the spent index (-spentindex): the inputs of all mempool txs, by the outpoint they spend */
+class CMempoolSpentIndex
+{
+private:
+    struct Entry {
+        CSpentIndexKey key;
+        CSpentIndexValue value;
+        uint32_t nHash;
+    };
+
+    const SaltedOutpointHasher hasher;
+    std::vector<Entry> entries;
+    CMempoolIndexTable table;
+
+    uint32_t Hash(const CSpentIndexKey& key) const { return hasher(COutPoint(key.txid, key.outputIndex)); }
+    size_t FindSlot(const CSpentIndexKey& key, uint32_t nHash) const;
+
+public:
+    void AddTx(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue>>& vSpent);
+    void RemoveTx(const CTransaction& tx);
+    bool Get(const CSpentIndexKey& key, CSpentIndexValue& value) const;
+    void Clear();
+
+    size_t DynamicMemoryUsage() const;
+};
+
 /**
  * CTxMemPool stores valid-according-to-the-current-best-chain transactions
  * that may be included in the next block.
@@ -496,17 +670,8 @@ private:
     typedef std::map<txiter, TxLinks, CompareIteratorByHash> txlinksMap;
     txlinksMap mapLinks;
 
-    typedef std::map<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyCompare> addressDeltaMap;
-    addressDeltaMap mapAddress;
-
-    typedef std::map<uint256, std::vector<CMempoolAddressDeltaKey> > addressDeltaMapInserted;
-    addressDeltaMapInserted mapAddressInserted;
-
-    typedef std::map<CSpentIndexKey, CSpentIndexValue, CSpentIndexKeyCompare> mapSpentIndex;
-    mapSpentIndex mapSpent;
-
-    typedef std::map<uint256, std::vector<CSpentIndexKey> > mapSpentIndexInserted;
-    mapSpentIndexInserted mapSpentInserted;
+    CMempoolAddressIndex addressIndex;
+    CMempoolSpentIndex spentIndex;
 
     std::multimap<uint256, uint256> mapProTxRefs; // proTxHash -> transaction (all TXs that refer to an existing proTx)
     std::map<CService, uint256> mapProTxAddresses;
@@ -550,7 +715,10 @@ public:
 
     void addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view);
     bool getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
-    bool removeSpentIndex(const uint256 txhash);
+    bool removeSpentIndex(const CTransaction &tx);
+
+    /** Memory used by the address and spent indexes, which is not part of DynamicMemoryUsage() */
+    size_t IndexesDynamicMemoryUsage() const;
 
     void removeRecursive(const CTransaction &tx, MemPoolRemovalReason reason = MemPoolRemovalReason::UNKNOWN);
     void removeForReorg(const CCoinsViewCache *pcoins, unsigned int nMemPoolHeight, int flags);
@@ -667,6 +835,7 @@ public:
 
     boost::signals2::signal<void (CTransactionRef)> NotifyEntryAdded;
     boost::signals2::signal<void (CTransactionRef, MemPoolRemovalReason)> NotifyEntryRemoved;
+    boost::signals2::signal<void (CTransactionRef)> NotifyEntryPrioritised;
 
 private:
     /** UpdateForDescendants is used by UpdateTransactionsFromBlock to update
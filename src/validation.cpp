@@ -55,6 +55,7 @@
 
 #include <atomic>
 #include <sstream>
+#include <unordered_map>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/join.hpp>
@@ -811,6 +812,86 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, fLimitFree, pfMissingInputs, GetTime(), fOverrideMempoolLimit, nAbsurdFee, fDryRun);
 }
 
+bool PreValidateTransaction(CTxMemPool& pool, const CTransaction& tx)
+{
+    CValidationState state;
+    if (!CheckTransaction(tx, state) || tx.IsCoinBase()) {
+        return false;
+    }
+
+    // The policy checks of AcceptToMemoryPoolWorker which come before its signature checks, so that
+    // nonstandard transactions don't cost more than they do without pre-validation
+    std::string reason;
+    if (fRequireStandard && !IsStandardTx(tx, reason)) {
+        return false;
+    }
+
+    // Copy the spent outputs, taking cs_main only for those which can't be found elsewhere. Outputs of mempool txs
+    // only need pool.cs and outputs which were flushed to the coins db can be read from it directly. The output of an
+    // outpoint never changes, so it doesn't matter if the coin was spent in the meantime, AcceptToMemoryPool checks that
+    CCoinsView viewDummy;
+    CCoinsViewCache view(&viewDummy);
+    {
+        LOCK(pool.cs);
+        for (const auto& txin : tx.vin) {
+            CTransactionRef ptxPrev = pool.get(txin.prevout.hash);
+            if (ptxPrev && txin.prevout.n < ptxPrev->vout.size()) {
+                view.AddCoin(txin.prevout, Coin(ptxPrev->vout[txin.prevout.n], MEMPOOL_HEIGHT, false), true);
+            }
+        }
+    }
+    std::vector<COutPoint> vMissing;
+    for (const auto& txin : tx.vin) {
+        if (view.HaveCoinInCache(txin.prevout)) {
+            continue;
+        }
+        Coin coin;
+        if (pcoinsdbview && pcoinsdbview->GetCoin(txin.prevout, coin)) {
+            view.AddCoin(txin.prevout, std::move(coin), true);
+        } else {
+            vMissing.emplace_back(txin.prevout);
+        }
+    }
+    if (!vMissing.empty()) {
+        // created by blocks which weren't flushed yet
+        LOCK(cs_main);
+        for (const auto& prevout : vMissing) {
+            const Coin& coin = pcoinsTip->AccessCoin(prevout);
+            if (coin.IsSpent()) {
+                return false;
+            }
+            view.AddCoin(prevout, Coin(coin.out, coin.nHeight, coin.fCoinBase), true);
+        }
+    }
+
+    if (!view.HaveInputs(tx)) {
+        return false;
+    }
+    if (fRequireStandard && !AreInputsStandard(tx, view)) {
+        return false;
+    }
+    unsigned int nSigOps = GetTransactionSigOpCount(tx, view, STANDARD_SCRIPT_VERIFY_FLAGS);
+    unsigned int nSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+    if (nSigOps > MAX_STANDARD_TX_SIGOPS || (nBytesPerSigOp && nSigOps > nSize / nBytesPerSigOp)) {
+        return false;
+    }
+    std::vector<CTxOut> vSpent(tx.vin.size());
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        vSpent[i] = view.AccessCoin(tx.vin[i].prevout).out;
+    }
+
+    // Same flags as the first CheckInputs in AcceptToMemoryPoolWorker, the signature cache
+    // doesn't depend on them
+    PrecomputedTransactionData txdata(tx);
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        CScriptCheck check(vSpent[i].scriptPubKey, vSpent[i].nValue, tx, i, STANDARD_SCRIPT_VERIFY_FLAGS, true, &txdata);
+        if (!check()) {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes)
 {
     if (!fTimestampIndex)
@@ -1694,11 +1775,99 @@ void static FlushBlockFile(bool fFinalize = false)
 
 static bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigned int nAddSize);
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+/**
+ * The script, header and special tx check queues share the same worker threads, so that
+ * -par sets the number of verification threads for all of them.
+ */
+static CCheckQueueWorkers checkqueueworkers;
+
+static CCheckQueue<CScriptCheck> scriptcheckqueue(128, &checkqueueworkers);
 
 void ThreadScriptCheck() {
     RenameThread("genix-scriptch");
-    scriptcheckqueue.Thread();
+    checkqueueworkers.Thread();
+}
+
+/**
+ * Computes the X16R hashes of a slice of headers and checks their PoW, in order. The hashes
+ * end up in the header hash cache, so that AcceptBlockHeader doesn't need to compute them
+ * again while holding cs_main. A slice stops at its first header with an invalid PoW, and
+ * before any header behind the first invalid one found by any slice so far, as those will
+ * never be accepted.
+ */
+class CHeaderPoWCheck
+{
+private:
+    const CBlockHeader* pbegin;
+    const CBlockHeader* pend;
+    //! Position of pbegin in the batch
+    size_t nBegin;
+    const Consensus::Params* params;
+    //! Position of the first header with an invalid PoW in the batch, shared by all slices
+    std::atomic<size_t>* pnFirstInvalid;
+
+public:
+    CHeaderPoWCheck() : pbegin(nullptr), pend(nullptr), nBegin(0), params(nullptr), pnFirstInvalid(nullptr) {}
+    CHeaderPoWCheck(const CBlockHeader* pbeginIn, const CBlockHeader* pendIn, size_t nBeginIn, const Consensus::Params& paramsIn, std::atomic<size_t>& nFirstInvalid) :
+        pbegin(pbeginIn), pend(pendIn), nBegin(nBeginIn), params(&paramsIn), pnFirstInvalid(&nFirstInvalid) {}
+
+    bool operator()()
+    {
+        size_t nPos = nBegin;
+        for (const CBlockHeader* it = pbegin; it != pend; ++it, ++nPos) {
+            if (nPos > pnFirstInvalid->load(std::memory_order_relaxed)) {
+                return false;
+            }
+            if (!CheckProofOfWork(it->GetHash(), it->nBits, *params)) {
+                size_t nFirstInvalid = pnFirstInvalid->load(std::memory_order_relaxed);
+                while (nPos < nFirstInvalid && !pnFirstInvalid->compare_exchange_weak(nFirstInvalid, nPos, std::memory_order_relaxed)) {}
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void swap(CHeaderPoWCheck& check)
+    {
+        std::swap(pbegin, check.pbegin);
+        std::swap(pend, check.pend);
+        std::swap(nBegin, check.nBegin);
+        std::swap(params, check.params);
+        std::swap(pnFirstInvalid, check.pnFirstInvalid);
+    }
+};
+
+/** Number of headers hashed by a single CHeaderPoWCheck */
+static const size_t HEADER_CHECK_SLICE_SIZE = 64;
+
+static CCheckQueue<CHeaderPoWCheck> headercheckqueue(1, &checkqueueworkers);
+
+static CCheckQueue<CSpecialTxSigCheck> specialtxcheckqueue(1, &checkqueueworkers);
+
+/**
+ * Hash and check the PoW of all headers on the verification threads, up to the first
+ * invalid one. AcceptBlockHeader still performs the (now cheap) PoW checks in order, so
+ * that all headers before the first invalid one get accepted and the invalid one is
+ * reported properly.
+ */
+static void PreCheckBlockHeaders(const std::vector<CBlockHeader>& headers, const Consensus::Params& params)
+{
+    std::atomic<size_t> nFirstInvalid{headers.size()};
+    if (nScriptCheckThreads == 0 || headers.size() <= HEADER_CHECK_SLICE_SIZE) {
+        CHeaderPoWCheck(headers.data(), headers.data() + headers.size(), 0, params, nFirstInvalid)();
+        return;
+    }
+
+    std::vector<CHeaderPoWCheck> vChecks;
+    vChecks.reserve((headers.size() + HEADER_CHECK_SLICE_SIZE - 1) / HEADER_CHECK_SLICE_SIZE);
+    for (size_t i = 0; i < headers.size(); i += HEADER_CHECK_SLICE_SIZE) {
+        const CBlockHeader* pbegin = headers.data() + i;
+        vChecks.emplace_back(pbegin, pbegin + std::min(HEADER_CHECK_SLICE_SIZE, headers.size() - i), i, params, nFirstInvalid);
+    }
+
+    CCheckQueueControl<CHeaderPoWCheck> control(&headercheckqueue);
+    control.Add(vChecks);
+    control.Wait();
 }
 
 // Protected by cs_main
@@ -1945,6 +2114,16 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
 
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
 
+    // The BLS sigs of special txs only depend on the state at pindex->pprev, so they are verified on their
+    // own queue while the txs are connected and the scripts are checked. ProcessSpecialTxsInBlock skips them then.
+    std::vector<bool> vSpecialTxSigsChecked;
+    CCheckQueueControl<CSpecialTxSigCheck> specialTxControl(nScriptCheckThreads ? &specialtxcheckqueue : nullptr);
+    if (nScriptCheckThreads) {
+        std::vector<CSpecialTxSigCheck> vSpecialTxChecks;
+        GetSpecialTxSigChecks(block, pindex->pprev, vSpecialTxChecks, vSpecialTxSigsChecked);
+        specialTxControl.Add(vSpecialTxChecks);
+    }
+
     std::vector<int> prevheights;
     CAmount nFees = 0;
     int nInputs = 0;
@@ -2103,6 +2282,10 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
 
     if (!control.Wait())
         return state.DoS(100, error("%s: CheckQueue failed", __func__), REJECT_INVALID, "block-validation-failed");
+    if (!specialTxControl.Wait()) {
+        // let ProcessSpecialTxsInBlock verify all sigs again, it reports the proper reject reason
+        vSpecialTxSigsChecked.clear();
+    }
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
     LogPrint(BCLog::BENCHMARK, "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs]\n", nInputs - 1, 0.001 * (nTime4 - nTime2), nInputs <= 1 ? 0 : 0.001 * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * 0.000001);
 
@@ -2168,7 +2351,7 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     int64_t nTime5_4 = GetTimeMicros(); nTimePayeeValid += nTime5_4 - nTime5_3;
     LogPrint(BCLog::BENCHMARK, "      - IsBlockPayeeValid: %.2fms [%.2fs]\n", 0.001 * (nTime5_4 - nTime5_3), nTimePayeeValid * 0.000001);
 
-    if (!ProcessSpecialTxsInBlock(block, pindex, state, fJustCheck, fScriptChecks)) {
+    if (!ProcessSpecialTxsInBlock(block, pindex, state, fJustCheck, fScriptChecks, vSpecialTxSigsChecked.empty() ? nullptr : &vSpecialTxSigsChecked)) {
         return error("ConnectBlock(genix): ProcessSpecialTxsInBlock for block %s failed with %s",
                      pindex->GetBlockHash().ToString(), FormatStateMessage(state));
     }
@@ -3472,6 +3655,10 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid)
 {
     if (first_invalid != nullptr) first_invalid->SetNull();
+
+    // Hash all headers before taking cs_main, AcceptBlockHeader then only hits the cache
+    PreCheckBlockHeaders(headers, chainparams.GetConsensus());
+
     {
         LOCK(cs_main);
         for (const CBlockHeader& header : headers) {
@@ -4644,7 +4831,98 @@ int VersionBitsTipStateSinceHeight(const Consensus::Params& params, Consensus::D
     return VersionBitsStateSinceHeight(chainActive.Tip(), params, pos, versionbitscache);
 }
 
-static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+static const uint64_t MEMPOOL_DUMP_VERSION_NO_METADATA = 1;
+static const uint64_t MEMPOOL_DUMP_VERSION = 2;
+/** Number of transactions from mempool.dat which are pre-checked and accepted as one batch */
+static const size_t MEMPOOL_LOAD_BATCH_SIZE = 1000;
+
+namespace {
+
+/**
+ * A transaction in mempool.dat. Since version 2 the fee, size and sigop count it was accepted
+ * with are stored too. They are not trusted (the transaction goes through AcceptToMemoryPool
+ * again), but allow LoadMempool to skip pre-checking transactions that will be rejected on fee
+ * or sigops before their scripts are looked at.
+ */
+struct MempoolDumpEntry
+{
+    CTransactionRef tx;
+    int64_t nTime;
+    int64_t nFeeDelta;
+    CAmount nFee;
+    uint32_t nTxSize;
+    uint32_t nSigOps;
+
+    //! Not serialized, false for entries read from a version 1 file
+    bool fHaveMetadata;
+
+    MempoolDumpEntry() : nTime(0), nFeeDelta(0), nFee(0), nTxSize(0), nSigOps(0), fHaveMetadata(true) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(tx);
+        READWRITE(nTime);
+        READWRITE(nFeeDelta);
+        READWRITE(nFee);
+        READWRITE(nTxSize);
+        READWRITE(nSigOps);
+    }
+
+    bool IsRejectedByPolicy() const
+    {
+        if (!fHaveMetadata) {
+            return false;
+        }
+        return nSigOps > MAX_STANDARD_TX_SIGOPS || nFee + nFeeDelta < ::minRelayTxFee.GetFee(nTxSize);
+    }
+};
+
+} // namespace
+
+/**
+ * Verify the scripts of a batch of transactions from mempool.dat on the script check threads,
+ * with the signature cache enabled, so that accepting them afterwards finds every signature
+ * in the cache. Failures are ignored here, AcceptToMemoryPool reports them.
+ */
+static void PreCheckMempoolBatch(const std::vector<const MempoolDumpEntry*>& vBatch)
+{
+    if (nScriptCheckThreads == 0) {
+        return;
+    }
+
+    // txdata must not reallocate, the checks point into it
+    std::vector<PrecomputedTransactionData> txdata;
+    txdata.reserve(vBatch.size());
+    std::vector<CScriptCheck> vChecks;
+
+    {
+        LOCK2(cs_main, mempool.cs);
+        CCoinsViewMemPool viewMemPool(pcoinsTip, mempool);
+        CCoinsViewCache view(&viewMemPool);
+        for (const MempoolDumpEntry* pentry : vBatch) {
+            const CTransaction& tx = *pentry->tx;
+            if (pentry->IsRejectedByPolicy() || tx.IsCoinBase() || !view.HaveInputs(tx)) {
+                continue;
+            }
+            txdata.emplace_back(tx);
+            std::vector<CScriptCheck> vTxChecks;
+            CValidationState state;
+            if (CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true, false, txdata.back(), &vTxChecks)) {
+                for (auto& check : vTxChecks) {
+                    vChecks.emplace_back();
+                    check.swap(vChecks.back());
+                }
+            }
+        }
+    }
+
+    // ConnectBlock takes the queue while holding cs_main, so only take it once cs_main is released
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
 
 bool LoadMempool(void)
 {
@@ -4661,54 +4939,124 @@ bool LoadMempool(void)
     int64_t skipped = 0;
     int64_t failed = 0;
     int64_t nNow = GetTime();
+    int64_t nStart = GetTimeMicros();
+
+    std::vector<MempoolDumpEntry> vEntries;
+    std::map<uint256, CAmount> mapDeltas;
 
     try {
+        // Stream the payload through the hasher, the checksum of a current dump is only compared
+        // once everything has been read
+        uint64_t nFileSize = fs::file_size(GetDataDir() / "mempool.dat");
         uint64_t version;
         file >> version;
-        if (version != MEMPOOL_DUMP_VERSION) {
+        if (version != MEMPOOL_DUMP_VERSION && version != MEMPOOL_DUMP_VERSION_NO_METADATA) {
             return false;
         }
+        CHashVerifier<CAutoFile> verifier(&file);
+
         uint64_t num;
-        file >> num;
+        verifier >> num;
+        // don't trust the count for the allocation, no transaction is smaller than 60 bytes
+        vEntries.reserve(std::min<uint64_t>(num, nFileSize / 60));
         while (num--) {
-            CTransactionRef tx;
-            int64_t nTime;
-            int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
-            file >> nFeeDelta;
-
-            CAmount amountdelta = nFeeDelta;
+            vEntries.emplace_back();
+            MempoolDumpEntry& entry = vEntries.back();
+            if (version == MEMPOOL_DUMP_VERSION) {
+                verifier >> entry;
+            } else {
+                verifier >> entry.tx;
+                verifier >> entry.nTime;
+                verifier >> entry.nFeeDelta;
+                entry.fHaveMetadata = false;
+            }
+        }
+        verifier >> mapDeltas;
+
+        if (version == MEMPOOL_DUMP_VERSION) {
+            uint256 hashChecksum;
+            file >> hashChecksum;
+            if (hashChecksum != verifier.GetHash()) {
+                throw std::ios_base::failure("checksum mismatch");
+            }
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+
+    int64_t nReadDone = GetTimeMicros();
+
+    // The dump is sorted by ancestor count, so parents come before their children. Group the
+    // transactions by depth within the dump: all inputs of a batch are then either in the
+    // chain or in the mempool by the time it is pre-checked.
+    std::vector<std::pair<int, const MempoolDumpEntry*>> vSorted;
+    vSorted.reserve(vEntries.size());
+    {
+        std::unordered_map<uint256, int, SaltedTxidHasher> mapDepth;
+        mapDepth.reserve(vEntries.size());
+        for (const MempoolDumpEntry& entry : vEntries) {
+            if (entry.nTime + nExpiryTimeout <= nNow) {
+                ++skipped;
+                continue;
+            }
+            int nDepth = 0;
+            for (const CTxIn& txin : entry.tx->vin) {
+                auto it = mapDepth.find(txin.prevout.hash);
+                if (it != mapDepth.end()) {
+                    nDepth = std::max(nDepth, it->second + 1);
+                }
+            }
+            mapDepth.emplace(entry.tx->GetHash(), nDepth);
+            vSorted.emplace_back(nDepth, &entry);
+        }
+    }
+    std::stable_sort(vSorted.begin(), vSorted.end(), [](const std::pair<int, const MempoolDumpEntry*>& a, const std::pair<int, const MempoolDumpEntry*>& b) {
+        return a.first < b.first;
+    });
+
+    std::vector<const MempoolDumpEntry*> vBatch;
+    vBatch.reserve(MEMPOOL_LOAD_BATCH_SIZE);
+    for (size_t i = 0; i < vSorted.size(); ) {
+        vBatch.clear();
+        int nDepth = vSorted[i].first;
+        while (i < vSorted.size() && vSorted[i].first == nDepth && vBatch.size() < MEMPOOL_LOAD_BATCH_SIZE) {
+            vBatch.push_back(vSorted[i++].second);
+        }
+
+        for (const MempoolDumpEntry* pentry : vBatch) {
+            CAmount amountdelta = pentry->nFeeDelta;
             if (amountdelta) {
-                mempool.PrioritiseTransaction(tx->GetHash(), amountdelta);
+                mempool.PrioritiseTransaction(pentry->tx->GetHash(), amountdelta);
             }
-            CValidationState state;
-            if (nTime + nExpiryTimeout > nNow) {
-                LOCK(cs_main);
-                AcceptToMemoryPoolWithTime(chainparams, mempool, state, tx, true, nullptr, nTime, false, 0, false);
+        }
+
+        PreCheckMempoolBatch(vBatch);
+
+        {
+            LOCK(cs_main);
+            for (const MempoolDumpEntry* pentry : vBatch) {
+                CValidationState state;
+                AcceptToMemoryPoolWithTime(chainparams, mempool, state, pentry->tx, true, nullptr, pentry->nTime, false, 0, false);
                 if (state.IsValid()) {
                     ++count;
                 } else {
                     ++failed;
                 }
-            } else {
-                ++skipped;
             }
-            if (ShutdownRequested())
-                return false;
         }
-        std::map<uint256, CAmount> mapDeltas;
-        file >> mapDeltas;
 
-        for (const auto& i : mapDeltas) {
-            mempool.PrioritiseTransaction(i.first, i.second);
-        }
-    } catch (const std::exception& e) {
-        LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
-        return false;
+        if (ShutdownRequested())
+            return false;
     }
 
+    for (const auto& i : mapDeltas) {
+        mempool.PrioritiseTransaction(i.first, i.second);
+    }
+
+    int64_t nEnd = GetTimeMicros();
     LogPrintf("Imported mempool transactions from disk: %i successes, %i failed, %i expired\n", count, failed, skipped);
+    LogPrint(BCLog::MEMPOOL, "Loaded mempool: %gs to read, %gs to accept\n", (nReadDone - nStart) * 0.000001, (nEnd - nReadDone) * 0.000001);
     return true;
 }
 
@@ -4737,18 +5085,28 @@ void DumpMempool(void)
 
         CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
 
-        uint64_t version = MEMPOOL_DUMP_VERSION;
-        file << version;
-
-        file << (uint64_t)vinfo.size();
+        // Serialize everything in memory and write it with a single call, followed by a
+        // checksum of the payload
+        CDataStream stream(SER_DISK, CLIENT_VERSION);
+        stream << (uint64_t)vinfo.size();
         for (const auto& i : vinfo) {
-            file << *(i.tx);
-            file << (int64_t)i.nTime;
-            file << (int64_t)i.nFeeDelta;
+            MempoolDumpEntry entry;
+            entry.tx = i.tx;
+            entry.nTime = i.nTime;
+            entry.nFeeDelta = i.nFeeDelta;
+            entry.nFee = i.nFee;
+            entry.nTxSize = i.nTxSize;
+            entry.nSigOps = i.nSigOps;
+            stream << entry;
             mapDeltas.erase(i.tx->GetHash());
         }
+        stream << mapDeltas;
+
+        uint64_t version = MEMPOOL_DUMP_VERSION;
+        file << version;
+        file.write(stream.data(), stream.size());
+        file << Hash(stream.begin(), stream.end());
 
-        file << mapDeltas;
         FileCommit(file.Get());
         file.fclose();
         RenameOver(GetDataDir() / "mempool.dat.new", GetDataDir() / "mempool.dat");
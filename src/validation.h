@@ -280,7 +280,7 @@ bool LoadBlockIndex(const CChainParams& chainparams);
 bool LoadChainTip(const CChainParams& chainparams);
 /** Unload database information */
 void UnloadBlockIndex();
-/** Run an instance of the script checking thread */
+/** Run an instance of the verification thread shared by the script, header PoW and special tx signature checks */
 void ThreadScriptCheck();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
@@ -320,6 +320,15 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
                         bool* pfMissingInputs, bool fOverrideMempoolLimit=false,
                         const CAmount nAbsurdFee=0, bool fDryRun=false);
 
+/**
+ * Run the checks of AcceptToMemoryPool that don't need cs_main held throughout: the context
+ * free transaction checks, the standardness and sigop limits and the signature checks, which
+ * are stored in the signature cache. The spent outputs are looked up in the mempool and the
+ * coins db, cs_main is only taken for outputs which are in neither. Returns false if a check
+ * failed or an input is missing; the transaction still has to go through AcceptToMemoryPool.
+ */
+bool PreValidateTransaction(CTxMemPool& pool, const CTransaction& tx);
+
 bool GetUTXOCoin(const COutPoint& outpoint, Coin& coin);
 int GetUTXOHeight(const COutPoint& outpoint);
 int GetUTXOConfirmations(const COutPoint& outpoint);
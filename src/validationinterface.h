@@ -12,6 +12,7 @@
 
 class CBlock;
 class CBlockIndex;
+struct CBlockTemplate;
 struct CBlockLocator;
 class CConnman;
 class CReserveScript;
@@ -76,6 +77,8 @@ protected:
      * Notifies listeners that a block which builds directly on our current tip
      * has been received and connected to the headers tree, though not validated yet */
     virtual void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {};
+    /** Notifies listeners of a new block template (see CBlockTemplateNotifier), built on top of the current tip */
+    virtual void NewBlockTemplate(const std::shared_ptr<const CBlockTemplate>& pblocktemplate) {}
     friend void ::RegisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
@@ -115,6 +118,7 @@ public:
     void Broadcast(int64_t nBestBlockTime, CConnman* connman);
     void BlockChecked(const CBlock&, const CValidationState&);
     void NewPoWValidBlock(const CBlockIndex *, const std::shared_ptr<const CBlock>&);
+    void NewBlockTemplate(const std::shared_ptr<const CBlockTemplate>&);
 };
 
 CMainSignals& GetMainSignals();
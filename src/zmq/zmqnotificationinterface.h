@@ -34,6 +34,7 @@ protected:
     void NotifyGovernanceVote(const CGovernanceVote& vote) override;
     void NotifyGovernanceObject(const CGovernanceObject& object) override;
     void NotifyInstantSendDoubleSpendAttempt(const CTransaction &currentTx, const CTransaction &previousTx) override;
+    void NewBlockTemplate(const std::shared_ptr<const CBlockTemplate>& pblocktemplate) override;
 
 
 private:
@@ -27,6 +27,7 @@ static const char *MSG_RAWTXLOCKSIG  = "rawtxlocksig";
 static const char *MSG_RAWGVOTE      = "rawgovernancevote";
 static const char *MSG_RAWGOBJ       = "rawgovernanceobject";
 static const char *MSG_RAWISCON      = "rawinstantsenddoublespend";
+static const char *MSG_RAWBLOCKTMPL  = "rawblocktemplate";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -350,3 +351,11 @@ bool CZMQPublishRawInstantSendDoubleSpendNotifier::NotifyInstantSendDoubleSpendA
     return SendMessage(MSG_RAWISCON, &(*ssCurrent.begin()), ssCurrent.size())
         && SendMessage(MSG_RAWISCON, &(*ssPrevious.begin()), ssPrevious.size());
 }
+
+bool CZMQPublishRawBlockTemplateNotifier::NotifyBlockTemplate(const CBlock &block)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish rawblocktemplate on top of %s\n", block.hashPrevBlock.GetHex());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+    return SendMessage(MSG_RAWBLOCKTMPL, &(*ss.begin()), ss.size());
+}